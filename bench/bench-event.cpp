@@ -0,0 +1,89 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "util/util-event.hpp"
+
+#include "warning-disable.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "warning-enable.hpp"
+
+// Calling an event from a single thread, while nothing changes the listeners.
+// Arguments: number of listeners.
+static auto bench_call = streamfx::bench::benchmark(
+	"event/call",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		streamfx::util::event<int64_t> event;
+		std::atomic<int64_t>           sum{0};
+		for (int64_t idx = 0; idx < state.arg(0); idx++) {
+			event.add([&sum](int64_t value) { sum.fetch_add(value, std::memory_order_relaxed); });
+		}
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			event(1);
+		}
+
+		state.pause();
+		state.set_items_processed(state.iterations());
+	},
+	{{1}, {2}, {4}, {8}, {16}});
+
+// Calling an event from several threads, while another thread keeps adding and removing a listener.
+// Arguments: number of listeners, number of calling threads.
+static auto bench_call_contended = streamfx::bench::benchmark(
+	"event/call_contended",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		streamfx::util::event<int64_t> event;
+		std::atomic<int64_t>           sum{0};
+		for (int64_t idx = 0; idx < state.arg(0); idx++) {
+			event.add([&sum](int64_t value) { sum.fetch_add(value, std::memory_order_relaxed); });
+		}
+
+		std::atomic<bool>     done{false};
+		std::atomic<bool>     go{false};
+		std::atomic<uint64_t> changes{0};
+		std::thread           writer([&]() {
+			while (!go.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			while (!done.load(std::memory_order_acquire)) {
+				auto handle = event.add([](int64_t) {});
+				event.remove(handle);
+				changes.fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+
+		size_t                   threads = static_cast<size_t>(state.arg(1));
+		std::vector<std::thread> callers;
+		for (size_t idx = 0; idx < threads; idx++) {
+			uint64_t count = state.iterations() / threads + ((idx < (state.iterations() % threads)) ? 1 : 0);
+			callers.emplace_back([&, count]() {
+				while (!go.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+				for (uint64_t iteration = 0; iteration < count; iteration++) {
+					event(1);
+				}
+			});
+		}
+
+		state.resume();
+		go.store(true, std::memory_order_release);
+		for (auto& caller : callers) {
+			caller.join();
+		}
+		state.pause();
+
+		done.store(true, std::memory_order_release);
+		writer.join();
+
+		state.set_items_processed(state.iterations());
+		state.counter("changes") = static_cast<double>(changes.load());
+	},
+	{{1, 1}, {4, 1}, {16, 1}, {1, 4}, {4, 4}, {16, 4}, {1, 16}, {4, 16}, {16, 16}});
@@ -0,0 +1,69 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "util/util-pool.hpp"
+
+#include "warning-disable.hpp"
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace {
+	// About the size of the objects pooled by the graphics code.
+	class pooled {
+		std::array<uint8_t, 256> _data;
+
+		public:
+		pooled() : _data() {}
+
+		public:
+		class pool;
+		typedef streamfx::util::pool<pooled::pool, pooled, 1000> _pool_t;
+		class pool : public _pool_t {
+			friend _pool_t;
+			friend streamfx::util::singleton<pooled::pool>;
+
+			protected:
+			pool() : _pool_t() {}
+		};
+	};
+} // namespace
+
+// Threads acquiring and immediately releasing objects from the same pool.
+// Arguments: number of threads.
+static auto bench_acquire_release = streamfx::bench::benchmark(
+	"pool/acquire_release",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		size_t threads = static_cast<size_t>(state.arg(0));
+		auto   pool    = pooled::pool::instance();
+
+		std::atomic<bool>        go{false};
+		std::vector<std::thread> workers;
+		for (size_t idx = 0; idx < threads; idx++) {
+			uint64_t count = state.iterations() / threads + ((idx < (state.iterations() % threads)) ? 1 : 0);
+			workers.emplace_back([&, count]() {
+				while (!go.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+				for (uint64_t iteration = 0; iteration < count; iteration++) {
+					auto object = pool->acquire();
+					streamfx::bench::do_not_optimize(object);
+				}
+			});
+		}
+
+		state.resume();
+		go.store(true, std::memory_order_release);
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		state.pause();
+
+		state.set_items_processed(state.iterations());
+	},
+	{{1}, {2}, {4}, {8}, {16}});
@@ -0,0 +1,86 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "gfx/gfx-render-budget.hpp"
+
+#include "warning-disable.hpp"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "warning-enable.hpp"
+
+using namespace streamfx::gfx;
+
+static size_t levels(std::vector<std::shared_ptr<render_budget::client>> const& clients)
+{
+	size_t result = 0;
+	for (auto& client : clients) {
+		result += client->quality();
+	}
+	return result;
+}
+
+// Deciding quality levels once per frame, with synthetic timings that alternate between far over and far under the
+// budget. One client changes its number of levels between frames, like effects do when their settings change, and
+// every frame checks that no client was ever asked for a level it does not have.
+// Arguments: number of clients.
+static auto bench_frame = streamfx::bench::benchmark(
+	"render_budget/frame",
+	[](streamfx::bench::state& state) {
+		constexpr uint64_t phase_length = 64;
+
+		state.pause();
+		render_budget::options opts;
+		opts.budget   = std::chrono::milliseconds(4);
+		opts.cooldown = 1;
+		render_budget budget{opts};
+
+		std::vector<std::shared_ptr<render_budget::client>> clients;
+		for (int64_t idx = 0; idx < state.arg(0); idx++) {
+			clients.push_back(budget.add_client("client" + std::to_string(idx), render_budget::max_levels));
+		}
+
+		uint64_t lowered = 0;
+		uint64_t raised  = 0;
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			// Heavy frames cost twice the budget at full quality, light frames a tenth of it, and every level halves it.
+			bool    heavy = ((idx / phase_length) % 2) == 0;
+			int64_t cost  = (heavy ? (opts.budget.count() * 2) : (opts.budget.count() / 10)) / static_cast<int64_t>(clients.size());
+			for (auto& client : clients) {
+				client->report(std::chrono::nanoseconds(cost >> client->quality()));
+			}
+
+			// Drop to a single level and back in the middle of every phase, which pulls the client back to full quality.
+			if ((idx % phase_length) == (phase_length / 2)) {
+				clients[0]->set_levels(1);
+			} else if ((idx % phase_length) == (phase_length / 2 + 1)) {
+				clients[0]->set_levels(render_budget::max_levels);
+			}
+
+			size_t before = levels(clients);
+			budget.frame();
+			size_t after = levels(clients);
+			lowered += (after > before) ? 1 : 0;
+			raised += (after < before) ? 1 : 0;
+
+			for (auto& client : clients) {
+				if (client->quality() >= render_budget::max_levels) {
+					throw std::runtime_error("Client '" + std::string(client->name()) + "' was asked for quality level " + std::to_string(client->quality()) + ".");
+				}
+			}
+		}
+
+		state.pause();
+		state.set_items_processed(state.iterations());
+		state.counter("lowered") = static_cast<double>(lowered);
+		state.counter("raised")  = static_cast<double>(raised);
+		if ((state.iterations() >= (phase_length * 2)) && ((lowered == 0) || (raised == 0))) {
+			throw std::runtime_error("Quality was never lowered or never raised.");
+		}
+	},
+	{{1}, {4}, {16}});
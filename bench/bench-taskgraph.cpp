@@ -0,0 +1,57 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "util/util-taskgraph.hpp"
+#include "util/util-threadpool.hpp"
+
+#include "warning-disable.hpp"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "warning-enable.hpp"
+
+using namespace streamfx::util;
+
+// Building and running a chain of nodes. Closing the chain into a ring must be rejected every time.
+// Arguments: length of the chain.
+static auto bench_chain = streamfx::bench::benchmark(
+	"taskgraph/chain",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		auto                  pool   = std::make_shared<threadpool::threadpool>(2, 2);
+		size_t                length = static_cast<size_t>(state.arg(0));
+		std::atomic<uint64_t> executed{0};
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			taskgraph::graph                              g{pool};
+			std::vector<std::shared_ptr<taskgraph::node>> nodes;
+			nodes.push_back(g.add([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }));
+			for (size_t node = 1; node < length; node++) {
+				nodes.push_back(g.then(nodes.back(), [&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }));
+			}
+
+			bool rejected = false;
+			try {
+				g.precede(nodes.back(), nodes.front());
+			} catch (const std::invalid_argument&) {
+				rejected = true;
+			}
+			if (!rejected) {
+				throw std::runtime_error("precede() accepted an edge that closes a cycle.");
+			}
+
+			g.start();
+			g.wait();
+		}
+
+		state.pause();
+		state.set_items_processed(state.iterations() * length);
+		if (executed.load() != (state.iterations() * length)) {
+			throw std::runtime_error("Not every node of the graph was executed.");
+		}
+	},
+	{{2}, {16}, {256}});
@@ -0,0 +1,310 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "util/util-parallel.hpp"
+#include "util/util-threadpool.hpp"
+#include "util/util-topology.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+#include "warning-enable.hpp"
+
+using namespace streamfx::util::threadpool;
+
+// Heap allocations made by the current thread, counted by the replacements of operator new below. These replace the
+// global operators for the whole benchmark executable, which only costs an increment everywhere else.
+static thread_local uint64_t allocations = 0;
+
+void* operator new(std::size_t size)
+{
+	allocations++;
+	if (void* ptr = std::malloc(size ? size : 1); ptr) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+	allocations++;
+	size_t alignment = static_cast<size_t>(align);
+#if defined(_MSC_VER)
+	void* ptr = _aligned_malloc(size ? size : 1, alignment);
+#else
+	void* ptr = std::aligned_alloc(alignment, ((size ? size : 1) + alignment - 1) / alignment * alignment);
+#endif
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#if defined(_MSC_VER)
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept
+{
+	operator delete(ptr, align);
+}
+
+static const std::vector<std::vector<int64_t>> thread_counts = {{1}, {2}, {4}, {8}, {16}};
+
+static queue_mode to_mode(int64_t value)
+{
+	return value ? queue_mode::work_stealing : queue_mode::global;
+}
+
+static void wait_for(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	while (counter.load(std::memory_order_acquire) < value) {
+		std::this_thread::yield();
+	}
+}
+
+// Many threads pushing tiny tasks at once, to compare contention on the global queue against per-worker queues.
+// Arguments: queue mode (0 = global, 1 = work stealing), number of producers.
+static auto bench_push = streamfx::bench::benchmark(
+	"threadpool/push",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		size_t producers = static_cast<size_t>(state.arg(1));
+		auto   pool      = std::make_shared<threadpool>(4, 4, to_mode(state.arg(0)));
+
+		std::atomic<uint64_t>    completed{0};
+		std::atomic<bool>        go{false};
+		std::vector<std::thread> threads;
+		for (size_t idx = 0; idx < producers; idx++) {
+			uint64_t count = state.iterations() / producers + ((idx < (state.iterations() % producers)) ? 1 : 0);
+			threads.emplace_back([&, count]() {
+				while (!go.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+				for (uint64_t task = 0; task < count; task++) {
+					pool->dispatch([&completed]() { completed.fetch_add(1, std::memory_order_release); });
+				}
+			});
+		}
+
+		state.resume();
+		go.store(true, std::memory_order_release);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		wait_for(completed, state.iterations());
+		state.pause();
+
+		state.set_items_processed(state.iterations());
+	},
+	{{0, 1}, {0, 2}, {0, 4}, {0, 8}, {0, 16}, {1, 1}, {1, 2}, {1, 4}, {1, 8}, {1, 16}});
+
+// dispatch() must not allocate once the pool has warmed up, which this checks on every run. It fails if there was any
+// allocation on the dispatching thread, and reports the number of allocations per run as "allocations".
+// Arguments: queue mode (0 = global, 1 = work stealing).
+static auto bench_dispatch_allocations = streamfx::bench::benchmark(
+	"threadpool/dispatch_allocations",
+	[](streamfx::bench::state& state) {
+		// Never more jobs in flight than were warmed up, so that the job pool has no reason to grow.
+		constexpr uint64_t batch = 256;
+
+		state.pause();
+		auto                  pool = std::make_shared<threadpool>(2, 2, to_mode(state.arg(0)));
+		std::atomic<uint64_t> completed{0};
+		for (uint64_t idx = 0; idx < batch * 4; idx++) {
+			pool->dispatch([&completed]() { completed.fetch_add(1, std::memory_order_release); });
+		}
+		wait_for(completed, batch * 4);
+		completed.store(0, std::memory_order_release);
+		state.resume();
+
+		uint64_t counted = 0;
+		for (uint64_t idx = 0; idx < state.iterations();) {
+			uint64_t count  = std::min(batch, state.iterations() - idx);
+			uint64_t before = allocations;
+			for (uint64_t task = 0; task < count; task++) {
+				pool->dispatch([&completed]() { completed.fetch_add(1, std::memory_order_release); });
+			}
+			counted += allocations - before;
+			idx += count;
+			wait_for(completed, idx);
+		}
+
+		state.pause();
+		state.set_items_processed(state.iterations());
+		state.counter("allocations") = static_cast<double>(counted);
+		if (counted > 0) {
+			throw std::runtime_error("dispatch() allocated " + std::to_string(counted) + " times.");
+		}
+	},
+	{{0}, {1}});
+
+// Time from pushing a single task until it completed, with nothing else going on.
+// Arguments: queue mode (0 = global, 1 = work stealing).
+static auto bench_round_trip = streamfx::bench::benchmark(
+	"threadpool/round_trip",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		auto pool = std::make_shared<threadpool>(2, 2, to_mode(state.arg(0)));
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			pool->push([](task_data_t) {}, nullptr, priority::interactive)->await_completion();
+		}
+
+		state.pause();
+	},
+	{{0}, {1}});
+
+// Scaling of parallel_for over a range of floats, which is about what effects do to buffers on the CPU.
+// Arguments: number of threads, including the caller.
+static auto bench_parallel_for = streamfx::bench::benchmark(
+	"threadpool/parallel_for",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		size_t             threads = static_cast<size_t>(state.arg(0));
+		auto               pool    = std::make_shared<threadpool>(threads, threads);
+		std::vector<float> data(1 << 20, 1.f);
+		state.resume();
+
+		parallel_options opts;
+		opts.pool         = pool;
+		opts.threads      = threads;
+		opts.grain        = 4096;
+		opts.element_size = sizeof(float);
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			parallel_for(
+				0, data.size(),
+				[&data](size_t begin, size_t end) {
+					for (size_t pos = begin; pos < end; pos++) {
+						data[pos] = std::sqrt(data[pos] * 1.0001f + 0.5f);
+					}
+				},
+				opts);
+		}
+		streamfx::bench::do_not_optimize(data[0]);
+
+		state.pause();
+		state.set_items_processed(state.iterations() * data.size());
+		state.set_bytes_processed(state.iterations() * data.size() * sizeof(float));
+	},
+	thread_counts);
+
+// Scaling of parallel_reduce summing up a range of floats.
+// Arguments: number of threads, including the caller.
+static auto bench_parallel_reduce = streamfx::bench::benchmark(
+	"threadpool/parallel_reduce",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		size_t             threads = static_cast<size_t>(state.arg(0));
+		auto               pool    = std::make_shared<threadpool>(threads, threads);
+		std::vector<float> data(1 << 20, 1.f);
+		state.resume();
+
+		parallel_options opts;
+		opts.pool    = pool;
+		opts.threads = threads;
+		opts.grain   = 4096;
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			double sum = parallel_reduce(
+				0, data.size(), 0.,
+				[&data](size_t begin, size_t end) {
+					double value = 0;
+					for (size_t pos = begin; pos < end; pos++) {
+						value += data[pos];
+					}
+					return value;
+				},
+				[](double a, double b) { return a + b; }, opts);
+			streamfx::bench::do_not_optimize(sum);
+		}
+
+		state.pause();
+		state.set_items_processed(state.iterations() * data.size());
+		state.set_bytes_processed(state.iterations() * data.size() * sizeof(float));
+	},
+	thread_counts);
+
+// How often workers move between processors with and without topology aware placement. Only meaningful on machines
+// with more than one NUMA node, everywhere else "cross_node" stays at zero.
+// Arguments: placement (0 = off, 1 = workers pinned to the processors of a node, 2 = workers pinned to one processor).
+static auto bench_placement = streamfx::bench::benchmark(
+	"threadpool/placement",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		std::vector<size_t> nodes;
+		for (auto const& cpu : streamfx::util::platform::cpu_topology()) {
+			if (cpu.id >= nodes.size()) {
+				nodes.resize(cpu.id + 1, 0);
+			}
+			nodes[cpu.id] = cpu.node;
+		}
+
+		placement_options placement;
+		placement.enabled   = (state.arg(0) > 0);
+		placement.exclusive = (state.arg(0) > 1);
+		size_t threads      = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+		auto   pool         = std::make_shared<threadpool>(threads, threads, queue_mode::work_stealing, placement);
+
+		std::atomic<uint64_t> completed{0};
+		std::atomic<uint64_t> migrations{0};
+		std::atomic<uint64_t> cross_node{0};
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			pool->dispatch([&]() {
+				thread_local size_t last = SIZE_MAX;
+
+				// Enough work that the scheduler has a reason to move the thread.
+				volatile double value = 1.;
+				for (size_t step = 0; step < 2000; step++) {
+					value = value * 1.000001 + 0.000001;
+				}
+
+				size_t cpu = streamfx::util::platform::current_cpu();
+				if ((last != SIZE_MAX) && (cpu != last)) {
+					migrations.fetch_add(1, std::memory_order_relaxed);
+					if ((cpu < nodes.size()) && (last < nodes.size()) && (nodes[cpu] != nodes[last])) {
+						cross_node.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+				last = cpu;
+				completed.fetch_add(1, std::memory_order_release);
+			});
+		}
+		wait_for(completed, state.iterations());
+
+		state.pause();
+		state.set_items_processed(state.iterations());
+		state.counter("migrations") = static_cast<double>(migrations.load());
+		state.counter("cross_node") = static_cast<double>(cross_node.load());
+	},
+	{{0}, {1}, {2}});
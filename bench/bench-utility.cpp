@@ -0,0 +1,36 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "util/utility.hpp"
+
+#include "warning-disable.hpp"
+#include <random>
+#include <vector>
+#include "warning-enable.hpp"
+
+// Filtering a noisy signal, as done for tracking data every frame.
+template<typename T>
+static void kalman1D(streamfx::bench::state& state)
+{
+	state.pause();
+	std::mt19937_64             generator{0};
+	std::normal_distribution<T> noise{T(0), T(1)};
+	std::vector<T>              samples(4096);
+	for (auto& sample : samples) {
+		sample = T(100) + noise(generator);
+	}
+	streamfx::util::math::kalman1D<T> filter{T(0.001), T(1), T(1), samples[0]};
+	state.resume();
+
+	for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+		streamfx::bench::do_not_optimize(filter.filter(samples[idx % samples.size()]));
+	}
+
+	state.pause();
+	state.set_items_processed(state.iterations());
+}
+
+static auto bench_kalman1D_float  = streamfx::bench::benchmark("utility/kalman1D/float", kalman1D<float>);
+static auto bench_kalman1D_double = streamfx::bench::benchmark("utility/kalman1D/double", kalman1D<double>);
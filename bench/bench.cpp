@@ -0,0 +1,335 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "util/util-topology.hpp"
+#include "version.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <regex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "warning-enable.hpp"
+
+const void* volatile streamfx::bench::detail::sink = nullptr;
+
+streamfx::bench::state::state(uint64_t iterations, std::vector<int64_t> args) : _iterations(iterations), _args(std::move(args)), _running(false), _start(), _elapsed(0), _items(0), _bytes(0), _counters() {}
+
+uint64_t streamfx::bench::state::iterations() const
+{
+	return _iterations;
+}
+
+int64_t streamfx::bench::state::arg(size_t index) const
+{
+	return (index < _args.size()) ? _args[index] : 0;
+}
+
+void streamfx::bench::state::pause()
+{
+	if (_running) {
+		_elapsed += std::chrono::steady_clock::now() - _start;
+		_running = false;
+	}
+}
+
+void streamfx::bench::state::resume()
+{
+	if (!_running) {
+		_start   = std::chrono::steady_clock::now();
+		_running = true;
+	}
+}
+
+void streamfx::bench::state::set_items_processed(uint64_t items)
+{
+	_items = items;
+}
+
+void streamfx::bench::state::set_bytes_processed(uint64_t bytes)
+{
+	_bytes = bytes;
+}
+
+double& streamfx::bench::state::counter(std::string_view name)
+{
+	return _counters[std::string{name}];
+}
+
+void streamfx::bench::state::start()
+{
+	_elapsed = std::chrono::nanoseconds(0);
+	resume();
+}
+
+void streamfx::bench::state::stop()
+{
+	pause();
+}
+
+std::chrono::nanoseconds streamfx::bench::state::elapsed() const
+{
+	return _elapsed;
+}
+
+uint64_t streamfx::bench::state::items_processed() const
+{
+	return _items;
+}
+
+uint64_t streamfx::bench::state::bytes_processed() const
+{
+	return _bytes;
+}
+
+std::map<std::string, double> const& streamfx::bench::state::counters() const
+{
+	return _counters;
+}
+
+struct entry {
+	std::string                 group;
+	std::string                 name;
+	streamfx::bench::function_t function;
+	std::vector<int64_t>        args;
+};
+
+static std::vector<entry>& registry()
+{
+	static std::vector<entry> list;
+	return list;
+}
+
+streamfx::bench::benchmark::benchmark(std::string_view name, function_t function, std::vector<std::vector<int64_t>> args)
+{
+	if (args.empty()) {
+		registry().push_back({std::string{name}, std::string{name}, function, {}});
+		return;
+	}
+
+	for (auto& set : args) {
+		std::string full{name};
+		for (auto arg : set) {
+			full += "/" + std::to_string(arg);
+		}
+		registry().push_back({std::string{name}, full, function, set});
+	}
+}
+
+struct options {
+	std::regex                filter{".*"};
+	std::string               output;
+	std::chrono::milliseconds min_time{250};
+	size_t                    repetitions = 5;
+	bool                      list        = false;
+};
+
+static streamfx::bench::state run_once(entry const& bench, uint64_t iterations)
+{
+	streamfx::bench::state state{iterations, bench.args};
+	state.start();
+	bench.function(state);
+	state.stop();
+	return state;
+}
+
+static nlohmann::json run(entry const& bench, options const& opts)
+{
+	nlohmann::json result;
+	result["name"] = bench.name;
+	result["args"] = bench.args;
+
+	// Grow the number of iterations until a single run takes long enough, which also warms up caches and thread pools.
+	uint64_t iterations = 1;
+	while (true) {
+		auto state   = run_once(bench, iterations);
+		auto elapsed = state.elapsed();
+		if ((elapsed >= opts.min_time) || (iterations >= 1000000000ull)) {
+			break;
+		}
+
+		double scale = (elapsed.count() > 0) ? (std::chrono::duration<double>(opts.min_time) / elapsed) * 1.4 : 100.;
+		iterations   = static_cast<uint64_t>(static_cast<double>(iterations) * std::clamp(scale, 2., 100.));
+	}
+
+	std::vector<double>           times;
+	double                        items_per_second = 0;
+	double                        bytes_per_second = 0;
+	std::map<std::string, double> counters;
+	for (size_t rep = 0; rep < opts.repetitions; rep++) {
+		auto   state   = run_once(bench, iterations);
+		double seconds = std::chrono::duration<double>(state.elapsed()).count();
+
+		times.push_back(static_cast<double>(state.elapsed().count()) / static_cast<double>(iterations));
+		if (seconds > 0) {
+			items_per_second += static_cast<double>(state.items_processed()) / seconds;
+			bytes_per_second += static_cast<double>(state.bytes_processed()) / seconds;
+		}
+		for (auto const& kv : state.counters()) {
+			counters[kv.first] += kv.second;
+		}
+	}
+
+	double reps = static_cast<double>(opts.repetitions);
+	std::sort(times.begin(), times.end());
+	double median = (times.size() % 2) ? times[times.size() / 2] : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2.;
+
+	result["iterations"]       = iterations;
+	result["repetitions"]      = opts.repetitions;
+	result["ns_per_iteration"] = {
+		{"median", median},
+		{"min", times.front()},
+		{"max", times.back()},
+		{"mean", std::accumulate(times.begin(), times.end(), 0.) / reps},
+	};
+	if (items_per_second > 0) {
+		result["items_per_second"] = items_per_second / reps;
+	}
+	if (bytes_per_second > 0) {
+		result["bytes_per_second"] = bytes_per_second / reps;
+	}
+	if (!counters.empty()) {
+		for (auto& kv : counters) {
+			kv.second /= reps;
+		}
+		result["counters"] = counters;
+	}
+	return result;
+}
+
+static nlohmann::json context()
+{
+	nlohmann::json ctx;
+	ctx["version"] = STREAMFX_VERSION_STRING;
+
+	char        date[32] = {0};
+	std::time_t now      = std::time(nullptr);
+	if (std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now)) > 0) {
+		ctx["date"] = date;
+	}
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	ctx["compiler"] = "MSVC " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+	ctx["compiler"] = "Clang " __clang_version__;
+#elif defined(__GNUC__)
+	ctx["compiler"] = "GCC " __VERSION__;
+#endif
+#ifdef NDEBUG
+	ctx["build_type"] = "release";
+#else
+	ctx["build_type"] = "debug";
+#endif
+
+	// Results are only comparable between runs on the same kind of machine.
+	auto             topology = streamfx::util::platform::cpu_topology();
+	std::set<size_t> cores, packages, nodes;
+	for (auto const& cpu : topology) {
+		cores.insert(cpu.core);
+		packages.insert(cpu.package);
+		nodes.insert(cpu.node);
+	}
+	ctx["hardware_concurrency"] = std::thread::hardware_concurrency();
+	ctx["logical_processors"]   = topology.size();
+	ctx["cores"]                = cores.size();
+	ctx["packages"]             = packages.size();
+	ctx["nodes"]                = nodes.size();
+	return ctx;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  --filter=REGEX     Only run benchmarks whose name matches REGEX.\n"
+			"  --out=FILE         Write the results to FILE instead of standard output.\n"
+			"  --min-time=MS      Minimum duration of a single run in milliseconds (default: 250).\n"
+			"  --repetitions=N    Number of measured runs per benchmark (default: 5).\n"
+			"  --list             List all benchmarks and exit.\n",
+			name);
+}
+
+static options parse(int argc, const char* argv[])
+{
+	options opts;
+	for (int idx = 1; idx < argc; idx++) {
+		std::string_view arg{argv[idx]};
+		auto             value = [&arg](std::string_view key) { return std::string{arg.substr(key.size())}; };
+
+		if (arg.starts_with("--filter=")) {
+			opts.filter = std::regex(value("--filter="));
+		} else if (arg.starts_with("--out=")) {
+			opts.output = value("--out=");
+		} else if (arg.starts_with("--min-time=")) {
+			opts.min_time = std::chrono::milliseconds(std::stoll(value("--min-time=")));
+		} else if (arg.starts_with("--repetitions=")) {
+			opts.repetitions = std::max<size_t>(std::stoull(value("--repetitions=")), 1);
+		} else if (arg == "--list") {
+			opts.list = true;
+		} else {
+			throw std::invalid_argument(std::string{"Unknown argument: "} + argv[idx]);
+		}
+	}
+	return opts;
+}
+
+int main(int argc, const char* argv[])
+{
+	options opts;
+	try {
+		opts = parse(argc, argv);
+	} catch (const std::exception& ex) {
+		fprintf(stderr, "%s\n", ex.what());
+		usage(argv[0]);
+		return 1;
+	}
+
+	auto benchmarks = registry();
+	// Files register in no particular order, but argument sets should stay in the order they were given in.
+	std::stable_sort(benchmarks.begin(), benchmarks.end(), [](entry const& a, entry const& b) { return a.group < b.group; });
+	benchmarks.erase(std::remove_if(benchmarks.begin(), benchmarks.end(), [&opts](entry const& bench) { return !std::regex_search(bench.name, opts.filter); }), benchmarks.end());
+
+	if (opts.list) {
+		for (auto const& bench : benchmarks) {
+			printf("%s\n", bench.name.c_str());
+		}
+		return 0;
+	}
+
+	nlohmann::json results;
+	results["context"]    = context();
+	results["benchmarks"] = nlohmann::json::array();
+	for (auto const& bench : benchmarks) {
+		fprintf(stderr, "%s...\n", bench.name.c_str());
+		try {
+			results["benchmarks"].push_back(run(bench, opts));
+		} catch (const std::exception& ex) {
+			// Keep going, a benchmark that can't run here should not hide the results of all others.
+			fprintf(stderr, "%s failed: %s\n", bench.name.c_str(), ex.what());
+			results["benchmarks"].push_back({{"name", bench.name}, {"args", bench.args}, {"error", ex.what()}});
+		}
+	}
+
+	if (opts.output.empty()) {
+		std::cout << results.dump(4) << std::endl;
+	} else {
+		std::ofstream stream{opts.output, std::ios::out | std::ios::trunc};
+		if (!stream) {
+			fprintf(stderr, "Failed to open '%s' for writing.\n", opts.output.c_str());
+			return 1;
+		}
+		stream << results.dump(4) << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,110 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "warning-disable.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "warning-enable.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/** Micro benchmarks for StreamFX.
+ *
+ * Benchmarks register themselves through static objects, just like components do:
+ *
+ *     static auto bench = streamfx::bench::benchmark(
+ *         "example/thing",
+ *         [](streamfx::bench::state& state) {
+ *             for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+ *                 streamfx::bench::do_not_optimize(thing(state.arg(0)));
+ *             }
+ *         },
+ *         {{16}, {256}});
+ *
+ * Each argument set is run as its own benchmark named "example/thing/16" and "example/thing/256". The runner picks the
+ * number of iterations so that a single run takes long enough to measure, then repeats the run and reports the time
+ * per iteration as JSON.
+ */
+namespace streamfx::bench {
+	class state {
+		uint64_t             _iterations;
+		std::vector<int64_t> _args;
+
+		bool                                  _running;
+		std::chrono::steady_clock::time_point _start;
+		std::chrono::nanoseconds              _elapsed;
+
+		uint64_t                      _items;
+		uint64_t                      _bytes;
+		std::map<std::string, double> _counters;
+
+		public:
+		state(uint64_t iterations, std::vector<int64_t> args);
+
+		/// Number of times the measured work should be done.
+		uint64_t iterations() const;
+
+		/// Argument of the current argument set, or 0 if there is none.
+		int64_t arg(size_t index) const;
+
+		/** Exclude setup work from the measured time.
+		 *
+		 * Time is measured from the start of the benchmark function, unless pause() is called. Everything between pause()
+		 * and resume() is not counted.
+		 */
+		void pause();
+		void resume();
+
+		/// Number of items processed in total, reported as items per second.
+		void set_items_processed(uint64_t items);
+
+		/// Number of bytes processed in total, reported as bytes per second.
+		void set_bytes_processed(uint64_t bytes);
+
+		/// Additional values to report, averaged over all repetitions.
+		double& counter(std::string_view name);
+
+		public:
+		/// Used by the runner.
+		void                                 start();
+		void                                 stop();
+		std::chrono::nanoseconds             elapsed() const;
+		uint64_t                             items_processed() const;
+		uint64_t                             bytes_processed() const;
+		std::map<std::string, double> const& counters() const;
+	};
+
+	typedef std::function<void(state&)> function_t;
+
+	class benchmark {
+		public:
+		benchmark(std::string_view name, function_t function, std::vector<std::vector<int64_t>> args = {});
+	};
+
+	namespace detail {
+		extern const void* volatile sink;
+	}
+
+	/** Prevent the compiler from optimizing away a value, or the work that produced it.
+	 */
+	template<typename T>
+	inline void do_not_optimize(T const& value)
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		detail::sink = static_cast<const void*>(&value);
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r"(&value) : "memory");
+#endif
+	}
+} // namespace streamfx::bench
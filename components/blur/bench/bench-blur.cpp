@@ -0,0 +1,20 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "gfx/blur/gfx-blur-gaussian.hpp"
+
+// Generating the weights of a Gaussian kernel, which is done for every size whenever the blur is first used.
+// Arguments: size of the blur.
+static auto bench_gaussian_kernel = streamfx::bench::benchmark(
+	"blur/gaussian/generate_kernel",
+	[](streamfx::bench::state& state) {
+		size_t size = static_cast<size_t>(state.arg(0));
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			auto kernel = streamfx::gfx::blur::gaussian_data::generate_kernel(size);
+			streamfx::bench::do_not_optimize(kernel.data());
+		}
+		state.set_items_processed(state.iterations());
+	},
+	{{1}, {16}, {64}});
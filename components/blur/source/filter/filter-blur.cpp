@@ -121,7 +121,7 @@ static std::map<std::string, local_blur_subtype_t> list_of_subtypes = {
 	{"zoom", {::streamfx::gfx::blur::type::Zoom, S_BLUR_SUBTYPE_ZOOM}},
 };
 
-blur_instance::blur_instance(obs_data_t* settings, obs_source_t* self) : obs::source_instance(settings, self), _gfx_util(::streamfx::gfx::util::get()), _source_rendered(false), _output_rendered(false)
+blur_instance::blur_instance(obs_data_t* settings, obs_source_t* self) : obs::source_instance(settings, self), _gfx_util(::streamfx::gfx::util::get()), _source_rendered(false), _output_rendered(false), _budget(streamfx::gfx::render_budget::instance()->add_client(obs_source_get_name(self)))
 {
 	{
 		auto gctx = streamfx::obs::gs::context();
@@ -267,6 +267,9 @@ void blur_instance::update(obs_data_t* settings)
 				if ((strcmp(last_blur_type, blur_type) != 0) || (_blur->get_type() != subtype_found->second.type)) {
 					if (type_found->second.fn().is_type_supported(subtype_found->second.type)) {
 						_blur = type_found->second.fn().create(subtype_found->second.type);
+
+						// Dual Filtering has no taps to drop, its size is the number of passes.
+						_budget->set_levels(std::dynamic_pointer_cast<::streamfx::gfx::blur::dual_filtering>(_blur) ? 1 : streamfx::gfx::render_budget::max_levels);
 					}
 				}
 			}
@@ -322,11 +325,14 @@ void blur_instance::video_tick(float)
 {
 	// Blur
 	if (_blur) {
-		_blur->set_size(_blur_size);
+		// Over budget, take fewer samples that are further apart, which keeps the radius the same.
+		double_t spread = 1.0 + _budget->quality();
+
+		_blur->set_size(_blur_size / spread);
 		if (_blur_step_scaling) {
-			_blur->set_step_scale(_blur_step_scale.first, _blur_step_scale.second);
+			_blur->set_step_scale(_blur_step_scale.first * spread, _blur_step_scale.second * spread);
 		} else {
-			_blur->set_step_scale(1.0, 1.0);
+			_blur->set_step_scale(spread, spread);
 		}
 		if ((_blur->get_type() == ::streamfx::gfx::blur::type::Directional) || (_blur->get_type() == ::streamfx::gfx::blur::type::Rotational)) {
 			auto obj = std::dynamic_pointer_cast<::streamfx::gfx::blur::base_angle>(_blur);
@@ -381,6 +387,7 @@ void blur_instance::video_render(gs_effect_t* effect)
 #if defined(ENABLE_PROFILING) && !defined(D_PLATFORM_MAC) && _DEBUG
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "Blur '%s'", obs_source_get_name(_self)};
 #endif
+	auto budget = _budget->measure();
 
 	if (!_source_rendered) {
 		// Source To Texture
@@ -807,17 +814,17 @@ obs_properties_t* blur_factory::get_properties2(blur_instance* data)
 		p = obs_properties_add_list(pr, ST_KEY_MASK_SOURCE, D_TRANSLATE(ST_I18N_MASK_SOURCE), OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 		obs_property_list_add_string(p, "", "");
 		obs::source_tracker::instance()->enumerate(
-			[&p](std::string name, ::streamfx::obs::source) {
-				obs_property_list_add_string(p, std::string(name + " (Source)").c_str(), name.c_str());
+			obs::source_tracker::category::VIDEO_SOURCE,
+			[&p](obs::source_tracker::entry const& entry) {
+				obs_property_list_add_string(p, std::string(entry.name + " (Source)").c_str(), entry.name.c_str());
 				return false;
-			},
-			obs::source_tracker::filter_video_sources);
+			});
 		obs::source_tracker::instance()->enumerate(
-			[&p](std::string name, ::streamfx::obs::source) {
-				obs_property_list_add_string(p, std::string(name + " (Scene)").c_str(), name.c_str());
+			obs::source_tracker::category::SCENE,
+			[&p](obs::source_tracker::entry const& entry) {
+				obs_property_list_add_string(p, std::string(entry.name + " (Scene)").c_str(), entry.name.c_str());
 				return false;
-			},
-			obs::source_tracker::filter_scenes);
+			});
 
 		/// Shared
 		p = obs_properties_add_color(pr, ST_KEY_MASK_COLOR, D_TRANSLATE(ST_I18N_MASK_COLOR));
@@ -5,6 +5,7 @@
 #pragma once
 #include "common.hpp"
 #include "gfx/blur/gfx-blur-base.hpp"
+#include "gfx/gfx-render-budget.hpp"
 #include "gfx/gfx-source-texture.hpp"
 #include "gfx/gfx-util.hpp"
 #include "obs/gs/gs-effect.hpp"
@@ -50,6 +51,9 @@ namespace streamfx::filter::blur {
 		bool                                         _blur_step_scaling;
 		std::pair<double_t, double_t>                _blur_step_scale;
 
+		// Render Budget
+		std::shared_ptr<streamfx::gfx::render_budget::client> _budget;
+
 		// Masking
 		struct {
 			bool      enabled;
@@ -22,11 +22,6 @@
 
 streamfx::gfx::blur::gaussian_data::gaussian_data() : _gfx_util(::streamfx::gfx::util::get())
 {
-	using namespace streamfx::util;
-
-	std::array<double, ST_KERNEL_SIZE> kernel_dbl;
-	std::vector<float>                 kernel(ST_KERNEL_SIZE);
-
 	{
 		auto gctx = streamfx::obs::gs::context();
 
@@ -40,56 +35,63 @@ streamfx::gfx::blur::gaussian_data::gaussian_data() : _gfx_util(::streamfx::gfx:
 		}
 	}
 
-	//#define ST_USE_PASCAL_TRIANGLE
-
 	// Pre-calculate Kernel Information for all Kernel sizes
 	for (size_t size = 1; size <= ST_MAX_BLUR_SIZE; size++) {
+		_kernels.insert_or_assign(size, generate_kernel(size));
+	}
+}
+
+std::vector<float> streamfx::gfx::blur::gaussian_data::generate_kernel(std::size_t size)
+{
+	using namespace streamfx::util;
+
+	std::array<double, ST_KERNEL_SIZE> kernel_dbl;
+	std::vector<float>                 kernel(ST_KERNEL_SIZE);
+
+	//#define ST_USE_PASCAL_TRIANGLE
 #ifdef ST_USE_PASCAL_TRIANGLE
-		// The Pascal Triangle can be used to generate Gaussian Kernels, which is
-		// significantly faster than doing the same task with searching. It is also
-		// much more accurate at the same time, so it is a 2-in-1 solution.
-
-		// Generate the required row and sum.
-		size_t offset   = size;
-		size_t row      = size * 2;
-		auto   triangle = math::pascal_triangle<double>(row);
-		double sum      = pow(2, row);
-
-		// Convert all integers to floats.
-		double accum = 0.;
-		for (size_t idx = offset; idx < std::min<size_t>(triangle.size(), ST_KERNEL_SIZE); idx++) {
-			double v                 = static_cast<double>(triangle[idx]) / sum;
-			kernel_dbl[idx - offset] = v;
-			// Accumulator needed as we end up with float inaccuracies above a certain threshold.
-			accum += v * (idx > offset ? 2 : 1);
-		}
+	// The Pascal Triangle can be used to generate Gaussian Kernels, which is
+	// significantly faster than doing the same task with searching. It is also
+	// much more accurate at the same time, so it is a 2-in-1 solution.
+
+	// Generate the required row and sum.
+	size_t offset   = size;
+	size_t row      = size * 2;
+	auto   triangle = math::pascal_triangle<double>(row);
+	double sum      = pow(2, row);
+
+	// Convert all integers to floats.
+	double accum = 0.;
+	for (size_t idx = offset; idx < std::min<size_t>(triangle.size(), ST_KERNEL_SIZE); idx++) {
+		double v                 = static_cast<double>(triangle[idx]) / sum;
+		kernel_dbl[idx - offset] = v;
+		// Accumulator needed as we end up with float inaccuracies above a certain threshold.
+		accum += v * (idx > offset ? 2 : 1);
+	}
 
-		// Rescale all values back into useful ranges.
-		accum = 1. / accum;
-		for (size_t idx = offset; idx < ST_KERNEL_SIZE; idx++) {
-			kernel[idx - offset] = kernel_dbl[idx - offset] * accum;
-		}
+	// Rescale all values back into useful ranges.
+	accum = 1. / accum;
+	for (size_t idx = offset; idx < ST_KERNEL_SIZE; idx++) {
+		kernel[idx - offset] = kernel_dbl[idx - offset] * accum;
+	}
 #else
-		size_t oversample = size * ST_OVERSAMPLE_MULTIPLIER;
+	size_t oversample = size * ST_OVERSAMPLE_MULTIPLIER;
 
-		// Generate initial weights and calculate a total from them.
-		double total = 0.;
-		for (size_t idx = 0; (idx < oversample) && (idx < ST_KERNEL_SIZE); idx++) {
-			kernel_dbl[idx] = math::gaussian<double>(static_cast<double>(idx), static_cast<double>(size));
-			total += kernel_dbl[idx] * (idx > 0 ? 2 : 1);
-		}
-
-		// Scale the weights according to the total gathered, and convert to float.
-		for (size_t idx = 0; (idx < oversample) && (idx < ST_KERNEL_SIZE); idx++) {
-			kernel_dbl[idx] /= total;
-			kernel[idx] = static_cast<float>(kernel_dbl[idx]);
-		}
+	// Generate initial weights and calculate a total from them.
+	double total = 0.;
+	for (size_t idx = 0; (idx < oversample) && (idx < ST_KERNEL_SIZE); idx++) {
+		kernel_dbl[idx] = math::gaussian<double>(static_cast<double>(idx), static_cast<double>(size));
+		total += kernel_dbl[idx] * (idx > 0 ? 2 : 1);
+	}
 
+	// Scale the weights according to the total gathered, and convert to float.
+	for (size_t idx = 0; (idx < oversample) && (idx < ST_KERNEL_SIZE); idx++) {
+		kernel_dbl[idx] /= total;
+		kernel[idx] = static_cast<float>(kernel_dbl[idx]);
+	}
 #endif
 
-		// Store Kernel
-		_kernels.insert_or_assign(size, kernel);
-	}
+	return kernel;
 }
 
 streamfx::gfx::blur::gaussian_data::~gaussian_data()
@@ -31,6 +31,10 @@ namespace streamfx::gfx {
 			std::shared_ptr<streamfx::gfx::util> get_gfx_util();
 
 			std::vector<float> const& get_kernel(std::size_t width);
+
+			/** Generate the weights for a blur of the given size, without needing a graphics context.
+			 */
+			static std::vector<float> generate_kernel(std::size_t size);
 		};
 
 		class gaussian_factory : public ::streamfx::gfx::blur::ifactory {
@@ -113,7 +113,7 @@ static constexpr std::string_view HELP_URL = "https://github.com/Xaymar/obs-Stre
 
 color_grade_instance::~color_grade_instance() {}
 
-color_grade_instance::color_grade_instance(obs_data_t* data, obs_source_t* self) : obs::source_instance(data, self), _effect(), _gfx_util(::streamfx::gfx::util::get()), _lift(), _gamma(), _gain(), _offset(), _tint_detection(), _tint_luma(), _tint_exponent(), _tint_low(), _tint_mid(), _tint_hig(), _correction(), _lut_enabled(true), _lut_depth(), _ccache_rt(), _ccache_texture(), _ccache_fresh(false), _lut_initialized(false), _lut_dirty(true), _lut_producer(), _lut_consumer(), _lut_rt(), _lut_texture(), _cache_rt(), _cache_texture(), _cache_fresh(false)
+color_grade_instance::color_grade_instance(obs_data_t* data, obs_source_t* self) : obs::source_instance(data, self), _effect(), _gfx_util(::streamfx::gfx::util::get()), _lift(), _gamma(), _gain(), _offset(), _tint_detection(), _tint_luma(), _tint_exponent(), _tint_low(), _tint_mid(), _tint_hig(), _correction(), _lut_enabled(true), _lut_depth(), _ccache_rt(), _ccache_texture(), _ccache_fresh(false), _lut_initialized(false), _lut_dirty(true), _lut_producer(), _lut_consumer(), _lut_rt(), _lut_texture(), _cache_rt(), _cache_texture(), _cache_fresh(false), _budget(streamfx::gfx::render_budget::instance()->add_client(obs_source_get_name(self)))
 {
 	{
 		auto gctx = streamfx::obs::gs::context();
@@ -213,15 +213,17 @@ void color_grade_instance::update(obs_data_t* data)
 		// LUT status depends on selected option.
 		_lut_enabled = v != 0; // 0 (Direct)
 
-		if (v == -1) {
+		// Direct rendering falls back to an 8-bit LUT when over the render budget.
+		if (v <= 0) {
 			_lut_depth = streamfx::gfx::lut::color_depth::_8;
-		} else if (v > 0) {
+		} else {
 			_lut_depth = static_cast<streamfx::gfx::lut::color_depth>(v);
 		}
 	}
 
-	if (_lut_enabled && _lut_initialized)
+	if (_lut_initialized)
 		_lut_dirty = true;
+	_budget->set_levels((_lut_initialized && !_lut_enabled) ? 2 : 1);
 }
 
 void color_grade_instance::prepare_effect()
@@ -354,6 +356,8 @@ void color_grade_instance::video_render(gs_effect_t* shader)
 #if defined(ENABLE_PROFILING) && !defined(D_PLATFORM_MAC) && _DEBUG
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "Color Grading '%s'", obs_source_get_name(_self)};
 #endif
+	auto budget  = _budget->measure();
+	bool use_lut = _lut_initialized && (_lut_enabled || (_budget->quality() > 0));
 
 	// TODO: Optimize this once (https://github.com/obsproject/obs-studio/pull/4199) is merged.
 	// - We can skip the original capture and reduce the overall impact of this.
@@ -413,7 +417,7 @@ void color_grade_instance::video_render(gs_effect_t* shader)
 	}
 
 	// 2. Apply one of the two rendering methods (LUT or Direct).
-	if (_lut_initialized && _lut_enabled) { // Try to apply with the LUT based method.
+	if (use_lut) { // Try to apply with the LUT based method.
 		try {
 #if defined(ENABLE_PROFILING) && !defined(D_PLATFORM_MAC) && _DEBUG
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "LUT Rendering"};
@@ -477,10 +481,12 @@ void color_grade_instance::video_render(gs_effect_t* shader)
 			_lut_rt.reset();
 			_lut_texture.reset();
 			_lut_enabled = false;
+			use_lut      = false;
+			_budget->set_levels(1);
 			D_LOG_WARNING("Reverting to direct rendering due to error: %s", ex.what());
 		}
 	}
-	if ((!_lut_initialized || !_lut_enabled) && !_cache_fresh) {
+	if (!use_lut && !_cache_fresh) {
 #if defined(ENABLE_PROFILING) && !defined(D_PLATFORM_MAC) && _DEBUG
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Direct Rendering"};
 #endif
@@ -4,6 +4,7 @@
 
 #pragma once
 #include "gfx/gfx-mipmapper.hpp"
+#include "gfx/gfx-render-budget.hpp"
 #include "gfx/lut/gfx-lut-consumer.hpp"
 #include "gfx/lut/gfx-lut-producer.hpp"
 #include "gfx/lut/gfx-lut.hpp"
@@ -69,6 +70,9 @@ namespace streamfx::filter::color_grade {
 		std::shared_ptr<streamfx::obs::gs::texture>      _cache_texture;
 		bool                                             _cache_fresh;
 
+		// Render Budget
+		std::shared_ptr<streamfx::gfx::render_budget::client> _budget;
+
 		public:
 		color_grade_instance(obs_data_t* data, obs_source_t* self);
 		virtual ~color_grade_instance();
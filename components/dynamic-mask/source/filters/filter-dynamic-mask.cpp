@@ -729,21 +729,21 @@ obs_properties_t* dynamic_mask_factory::get_properties2(dynamic_mask_instance* d
 		p = obs_properties_add_list(props, ST_KEY_INPUT, D_TRANSLATE(ST_I18N_INPUT), OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 		obs_property_list_add_string(p, "", "");
 		obs::source_tracker::instance()->enumerate(
-			[&p](std::string name, ::streamfx::obs::source) {
+			obs::source_tracker::category::VIDEO_SOURCE,
+			[&p](obs::source_tracker::entry const& entry) {
 				std::stringstream sstr;
-				sstr << name << " (" << D_TRANSLATE(S_SOURCETYPE_SOURCE) << ")";
-				obs_property_list_add_string(p, sstr.str().c_str(), name.c_str());
+				sstr << entry.name << " (" << D_TRANSLATE(S_SOURCETYPE_SOURCE) << ")";
+				obs_property_list_add_string(p, sstr.str().c_str(), entry.name.c_str());
 				return false;
-			},
-			obs::source_tracker::filter_video_sources);
+			});
 		obs::source_tracker::instance()->enumerate(
-			[&p](std::string name, ::streamfx::obs::source) {
+			obs::source_tracker::category::SCENE,
+			[&p](obs::source_tracker::entry const& entry) {
 				std::stringstream sstr;
-				sstr << name << " (" << D_TRANSLATE(S_SOURCETYPE_SCENE) << ")";
-				obs_property_list_add_string(p, sstr.str().c_str(), name.c_str());
+				sstr << entry.name << " (" << D_TRANSLATE(S_SOURCETYPE_SCENE) << ")";
+				obs_property_list_add_string(p, sstr.str().c_str(), entry.name.c_str());
 				return false;
-			},
-			obs::source_tracker::filter_scenes);
+			});
 	}
 
 	const char* pri_chs[] = {S_CHANNEL_RED, S_CHANNEL_GREEN, S_CHANNEL_BLUE, S_CHANNEL_ALPHA};
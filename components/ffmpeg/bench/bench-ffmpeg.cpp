@@ -0,0 +1,436 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "bench.hpp"
+#include "encoders/codecs/hevc.hpp"
+#include "ffmpeg/avframe-queue.hpp"
+#include "ffmpeg/frame-pool.hpp"
+#include "ffmpeg/plane-copy.hpp"
+#include "ffmpeg/swscale.hpp"
+#include "ffmpeg/tools.hpp"
+
+#include "warning-disable.hpp"
+#include <memory>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "warning-enable.hpp"
+
+extern "C" {
+#include "warning-disable.hpp"
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#include "warning-enable.hpp"
+}
+
+static std::shared_ptr<AVFrame> allocate_frame(AVPixelFormat format, int width, int height)
+{
+	auto frame = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* v) { av_frame_free(&v); });
+	if (!frame) {
+		throw std::bad_alloc();
+	}
+	frame->format = format;
+	frame->width  = width;
+	frame->height = height;
+	if (int res = av_frame_get_buffer(frame.get(), 32); res < 0) {
+		throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+	}
+
+	// Anything but zeros, so that conversions can't take shortcuts.
+	std::mt19937 generator{0};
+	for (size_t plane = 0; (plane < AV_NUM_DATA_POINTERS) && frame->buf[plane]; plane++) {
+		for (size_t idx = 0; idx < frame->buf[plane]->size; idx++) {
+			frame->buf[plane]->data[idx] = static_cast<uint8_t>(generator());
+		}
+	}
+	return frame;
+}
+
+// Splitting an encoded packet into the parameter sets and SEI, as done for every keyframe.
+// Arguments: size of the slice data in KiB.
+static auto bench_hevc_extract_header_sei = streamfx::bench::benchmark(
+	"ffmpeg/hevc/extract_header_sei",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		std::vector<uint8_t> packet;
+		std::mt19937         generator{0};
+		auto                 append = [&](uint8_t type, size_t size) {
+			packet.insert(packet.end(), {0x00, 0x00, 0x00, 0x01, static_cast<uint8_t>(type << 1), 0x01});
+			for (size_t idx = 0; idx < size; idx++) {
+				// Never zero, so that no start codes or emulation prevention bytes show up in the payload.
+				packet.push_back(static_cast<uint8_t>(1 + generator() % 255));
+			}
+		};
+		append(32, 24); // VPS
+		append(33, 48); // SPS
+		append(34, 8); // PPS
+		append(39, 640); // Prefix SEI
+		append(19, static_cast<size_t>(state.arg(0)) * 1024); // IDR
+
+		std::vector<uint8_t> header;
+		std::vector<uint8_t> sei;
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			header.clear();
+			sei.clear();
+			streamfx::encoder::codec::hevc::extract_header_sei(packet.data(), packet.size(), header, sei);
+			streamfx::bench::do_not_optimize(header.data());
+			streamfx::bench::do_not_optimize(sei.data());
+		}
+
+		state.pause();
+		state.set_bytes_processed(state.iterations() * packet.size());
+	},
+	{{4}, {64}, {512}});
+
+static const std::pair<AVPixelFormat, AVPixelFormat> conversions[] = {
+	{AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P},
+	{AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV420P},
+	{AV_PIX_FMT_BGRA, AV_PIX_FMT_NV12},
+	{AV_PIX_FMT_YUV444P, AV_PIX_FMT_P010LE},
+};
+
+// Converting a frame from OBS into the format of the encoder, with the same flags the encoder uses.
+static void convert_frames(streamfx::bench::state& state, size_t threads)
+{
+	state.pause();
+	auto     conversion = conversions[state.arg(0)];
+	uint32_t height     = static_cast<uint32_t>(state.arg(1));
+	uint32_t width      = height * 16 / 9;
+
+	streamfx::ffmpeg::swscale scaler;
+	scaler.set_threads(threads);
+	scaler.set_source_size(width, height);
+	scaler.set_source_color(false, AVCOL_SPC_BT709);
+	scaler.set_source_format(conversion.first);
+	scaler.set_target_size(width, height);
+	scaler.set_target_color(false, AVCOL_SPC_BT709);
+	scaler.set_target_format(conversion.second);
+	if (!scaler.initialize(SWS_SINC | SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND | SWS_BITEXACT)) {
+		throw std::runtime_error("Failed to initialize the scaler.");
+	}
+
+	auto source = allocate_frame(conversion.first, static_cast<int>(width), static_cast<int>(height));
+	auto target = allocate_frame(conversion.second, static_cast<int>(width), static_cast<int>(height));
+	state.resume();
+
+	for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+		scaler.convert(source->data, source->linesize, 0, static_cast<int32_t>(height), target->data, target->linesize);
+	}
+
+	state.pause();
+	state.set_items_processed(state.iterations());
+	state.set_bytes_processed(state.iterations() * av_image_get_buffer_size(conversion.first, static_cast<int>(width), static_cast<int>(height), 1));
+}
+
+// On a single thread.
+// Arguments: conversion (0 = NV12 to YUV420P, 1 = I444 to YUV420P, 2 = BGRA to NV12, 3 = I444 to P010), height.
+static auto bench_swscale_convert = streamfx::bench::benchmark(
+	"ffmpeg/swscale/convert", [](streamfx::bench::state& state) { convert_frames(state, 1); }, {{0, 720}, {0, 1080}, {0, 2160}, {1, 1080}, {2, 1080}, {3, 2160}});
+
+// Split into bands that are converted in parallel on the threadpool.
+// Arguments: conversion (see above), height, number of bands (0 = automatic).
+static auto bench_swscale_convert_bands = streamfx::bench::benchmark(
+	"ffmpeg/swscale/convert_bands", [](streamfx::bench::state& state) { convert_frames(state, static_cast<size_t>(state.arg(2))); }, {{0, 1080, 0}, {0, 2160, 0}, {1, 2160, 0}, {3, 2160, 2}, {3, 2160, 4}, {3, 2160, 8}, {3, 2160, 0}});
+
+static const AVPixelFormat copy_formats[] = {
+	AV_PIX_FMT_NV12,
+	AV_PIX_FMT_P010LE,
+	AV_PIX_FMT_YUV420P10LE,
+};
+
+// Copying a frame from OBS into a frame of the encoder.
+// Arguments: format (0 = NV12, 1 = P010, 2 = I010), height, whether the source stride differs from the target stride (0 = same, 1 = padded).
+static auto bench_copy_frame_data = streamfx::bench::benchmark(
+	"ffmpeg/copy_frame_data",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		auto format = copy_formats[state.arg(0)];
+		int  height = static_cast<int>(state.arg(1));
+		int  width  = height * 16 / 9;
+		auto target = allocate_frame(format, width, height);
+
+		// OBS aligns planes differently than FFmpeg does, which forces a copy row by row.
+		auto          source = allocate_frame(format, width + (state.arg(2) ? 64 : 0), height);
+		encoder_frame frame  = {};
+		for (size_t plane = 0; (plane < MAX_AV_PLANES) && source->data[plane]; plane++) {
+			frame.data[plane]     = source->data[plane];
+			frame.linesize[plane] = static_cast<uint32_t>(source->linesize[plane]);
+		}
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			::streamfx::ffmpeg::tools::copy_frame_data(&frame, target.get());
+		}
+		streamfx::bench::do_not_optimize(target->data[0]);
+
+		state.pause();
+		state.set_bytes_processed(state.iterations() * av_image_get_buffer_size(format, width, height, 1));
+	},
+	{{0, 720, 0}, {0, 720, 1}, {0, 1080, 0}, {0, 1080, 1}, {0, 2160, 0}, {0, 2160, 1}, {1, 2160, 1}, {2, 2160, 1}});
+
+// The kernels and band splitting behind copy_frame_data, from a padded source.
+// Arguments: format (see above), height, kernel (0 = automatic, 1 = scalar, 2 = best the CPU supports), threads (0 = automatic).
+static auto bench_plane_copy = streamfx::bench::benchmark(
+	"ffmpeg/plane_copy",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		auto format = copy_formats[state.arg(0)];
+		int  height = static_cast<int>(state.arg(1));
+		int  width  = height * 16 / 9;
+		auto target = allocate_frame(format, width, height);
+		auto source = allocate_frame(format, width + 64, height);
+
+		streamfx::ffmpeg::plane_copy::options options;
+		switch (state.arg(2)) {
+		case 1:
+			options.implementation = streamfx::ffmpeg::plane_copy::kernel::scalar;
+			break;
+		case 2:
+			options.implementation = streamfx::ffmpeg::plane_copy::get_best_kernel();
+			break;
+		}
+		options.threads = static_cast<size_t>(state.arg(3));
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			streamfx::ffmpeg::plane_copy::copy(target.get(), source->data, source->linesize, options);
+		}
+		streamfx::bench::do_not_optimize(target->data[0]);
+
+		state.pause();
+		state.set_bytes_processed(state.iterations() * av_image_get_buffer_size(format, width, height, 1));
+	},
+	{{0, 2160, 1, 1}, {0, 2160, 2, 1}, {1, 2160, 1, 1}, {1, 2160, 2, 1}, {2, 2160, 2, 1}, {1, 2160, 2, 2}, {1, 2160, 2, 4}, {1, 2160, 0, 0}, {0, 1080, 0, 0}});
+
+// Getting an empty frame for the encoder, and writing to every page of it like a copy or conversion would.
+// Arguments: height, source (0 = av_frame_get_buffer, 1 = frame_pool).
+static auto bench_frame_pool_allocate = streamfx::bench::benchmark(
+	"ffmpeg/frame_pool/allocate",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		int                                           height = static_cast<int>(state.arg(0));
+		int                                           width  = height * 16 / 9;
+		std::shared_ptr<streamfx::ffmpeg::frame_pool> pool;
+		if (state.arg(1)) {
+			pool = streamfx::ffmpeg::frame_pool::instance(AV_PIX_FMT_NV12, width, height);
+			pool->reserve(1);
+		}
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			std::shared_ptr<AVFrame> frame;
+			if (pool) {
+				frame = pool->allocate();
+			} else {
+				frame         = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* ptr) { av_frame_free(&ptr); });
+				frame->format = AV_PIX_FMT_NV12;
+				frame->width  = width;
+				frame->height = height;
+				if (int res = av_frame_get_buffer(frame.get(), 32); res < 0) {
+					throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+				}
+			}
+
+			for (size_t offset = 0; offset < frame->buf[0]->size; offset += 4096) {
+				frame->buf[0]->data[offset] = static_cast<uint8_t>(idx);
+			}
+			streamfx::bench::do_not_optimize(frame->buf[0]->data);
+		}
+
+		state.pause();
+		state.set_items_processed(state.iterations());
+	},
+	{{1080, 0}, {1080, 1}, {2160, 0}, {2160, 1}});
+
+// Frames going back and forth between threads, like between the encode thread of OBS and an encoder worker.
+// Arguments: number of producers, number of consumers.
+static auto bench_avframe_queue_handoff = streamfx::bench::benchmark(
+	"ffmpeg/avframe_queue/handoff",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		streamfx::ffmpeg::avframe_queue free_frames(64);
+		streamfx::ffmpeg::avframe_queue used_frames(64);
+		free_frames.set_resolution(64, 64);
+		free_frames.set_pixel_format(AV_PIX_FMT_NV12);
+		free_frames.precache(32);
+
+		size_t                   producers = static_cast<size_t>(state.arg(0));
+		size_t                   consumers = static_cast<size_t>(state.arg(1));
+		std::atomic<uint64_t>    consumed{0};
+		std::atomic<bool>        go{false};
+		std::vector<std::thread> threads;
+		for (size_t idx = 0; idx < producers; idx++) {
+			uint64_t count = state.iterations() / producers + ((idx < (state.iterations() % producers)) ? 1 : 0);
+			threads.emplace_back([&, count]() {
+				while (!go.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+				for (uint64_t iteration = 0; iteration < count;) {
+					if (AVFrame* frame = free_frames.pop_only(); frame) {
+						used_frames.push(frame);
+						iteration++;
+					} else {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (size_t idx = 0; idx < consumers; idx++) {
+			threads.emplace_back([&]() {
+				while (consumed.load(std::memory_order_relaxed) < state.iterations()) {
+					if (AVFrame* frame = used_frames.pop_wait(std::chrono::milliseconds(1)); frame) {
+						free_frames.push(frame);
+						consumed.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			});
+		}
+
+		state.resume();
+		go.store(true, std::memory_order_release);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		state.pause();
+
+		state.set_items_processed(state.iterations());
+	},
+	{{1, 1}, {2, 2}, {4, 4}});
+
+static const std::pair<const char*, AVPixelFormat> intra_encoders[] = {
+	{"prores_aw", AV_PIX_FMT_YUV422P10},
+	{"dnxhd", AV_PIX_FMT_YUV422P},
+	{"cfhd", AV_PIX_FMT_YUV422P10},
+};
+
+static std::shared_ptr<AVCodecContext> open_encoder(const char* name, AVPixelFormat format, int width, int height)
+{
+	const AVCodec* codec = avcodec_find_encoder_by_name(name);
+	if (!codec) {
+		throw std::runtime_error("Encoder is not available.");
+	}
+
+	auto context = std::shared_ptr<AVCodecContext>(avcodec_alloc_context3(codec), [](AVCodecContext* v) { avcodec_free_context(&v); });
+	if (!context) {
+		throw std::bad_alloc();
+	}
+	context->width       = width;
+	context->height      = height;
+	context->pix_fmt     = format;
+	context->time_base   = {1, 60};
+	context->framerate   = {60, 1};
+	context->thread_type = FF_THREAD_SLICE; // Frame threading keeps frames around, which rules out wrapping them.
+	if (strcmp(name, "dnxhd") == 0) {
+		av_opt_set(context->priv_data, "profile", "dnxhr_sq", 0);
+	}
+
+	if (int res = avcodec_open2(context.get(), codec, nullptr); res < 0) {
+		throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+	}
+	return context;
+}
+
+static void encode_frame(AVCodecContext* context, AVFrame* frame, AVPacket* packet)
+{
+	if (int res = avcodec_send_frame(context, frame); res < 0) {
+		throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+	}
+	av_packet_unref(packet);
+	if (int res = avcodec_receive_packet(context, packet); res < 0) {
+		throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+	}
+}
+
+static void release_plane(void* opaque, uint8_t*)
+{
+	reinterpret_cast<std::atomic<size_t>*>(opaque)->fetch_sub(1);
+}
+
+// Handing a frame from OBS to an intra-only encoder, by copying it or by wrapping its planes. Before measuring, both
+// ways are checked to produce the same packet, and to not leave any references to the planes of OBS behind.
+// Arguments: encoder (0 = prores_aw, 1 = dnxhd, 2 = cfhd), whether to wrap the planes instead of copying them.
+static auto bench_encode_frame = streamfx::bench::benchmark(
+	"ffmpeg/encode_frame",
+	[](streamfx::bench::state& state) {
+		state.pause();
+		auto encoder = intra_encoders[state.arg(0)];
+		bool wrap    = state.arg(1) != 0;
+		int  height  = 1080;
+		int  width   = 1920;
+		int  planes  = av_pix_fmt_count_planes(encoder.second);
+
+		// Planes as OBS would hand them to the encoder.
+		auto          source = allocate_frame(encoder.second, width, height);
+		encoder_frame frame  = {};
+		for (int idx = 0; idx < planes; idx++) {
+			frame.data[idx]     = source->data[idx];
+			frame.linesize[idx] = static_cast<uint32_t>(source->linesize[idx]);
+		}
+
+		auto packet = std::shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket* v) { av_packet_free(&v); });
+		auto target = allocate_frame(encoder.second, width, height);
+
+		std::atomic<size_t> references{0};
+		auto                wrap_frame = [&]() {
+			references.store(static_cast<size_t>(planes));
+			AVFrame* wrapped = ::streamfx::ffmpeg::tools::wrap_frame_data(&frame, encoder.second, width, height, &release_plane, &references);
+			if (!wrapped) {
+				throw std::runtime_error("Failed to wrap frame.");
+			}
+			return wrapped;
+		};
+
+		{ // Check that both ways produce the same result.
+			auto copy_context = open_encoder(encoder.first, encoder.second, width, height);
+			auto wrap_context = open_encoder(encoder.first, encoder.second, width, height);
+			if (::streamfx::ffmpeg::tools::encoder_keeps_frames(wrap_context.get())) {
+				throw std::runtime_error("Encoder keeps frames, so they can't be wrapped.");
+			}
+
+			::streamfx::ffmpeg::tools::copy_frame_data(&frame, target.get());
+			target->pts = 0;
+			encode_frame(copy_context.get(), target.get(), packet.get());
+			std::vector<uint8_t> expected(packet->data, packet->data + packet->size);
+
+			AVFrame* wrapped = wrap_frame();
+			wrapped->pts     = 0;
+			encode_frame(wrap_context.get(), wrapped, packet.get());
+			av_frame_free(&wrapped);
+			if (references.load() != 0) {
+				throw std::runtime_error("Encoder still references the planes after returning the packet.");
+			}
+			if ((static_cast<size_t>(packet->size) != expected.size()) || (memcmp(packet->data, expected.data(), expected.size()) != 0)) {
+				throw std::runtime_error("Wrapped frame was encoded differently than the copied frame.");
+			}
+		}
+
+		auto context = open_encoder(encoder.first, encoder.second, width, height);
+		state.resume();
+
+		for (uint64_t idx = 0; idx < state.iterations(); idx++) {
+			if (wrap) {
+				AVFrame* wrapped = wrap_frame();
+				wrapped->pts     = static_cast<int64_t>(idx);
+				encode_frame(context.get(), wrapped, packet.get());
+				av_frame_free(&wrapped);
+			} else {
+				::streamfx::ffmpeg::tools::copy_frame_data(&frame, target.get());
+				target->pts = static_cast<int64_t>(idx);
+				encode_frame(context.get(), target.get(), packet.get());
+			}
+		}
+
+		state.pause();
+		state.set_items_processed(state.iterations());
+		state.set_bytes_processed(state.iterations() * av_image_get_buffer_size(encoder.second, width, height, 1));
+	},
+	{{0, 0}, {0, 1}, {1, 0}, {1, 1}, {2, 0}, {2, 1}});
@@ -12,8 +12,11 @@
 #include "ffmpeg/tools.hpp"
 #include "obs/gs/gs-helper.hpp"
 #include "plugin.hpp"
+#include "util/util-trace.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <deque>
 #include <sstream>
 #include "warning-enable.hpp"
 
@@ -61,6 +64,22 @@ using namespace streamfx::encoder::codec;
 
 enum class keyframe_type { SECONDS, FRAMES };
 
+// A worker that has not finished the packet that is due for this long is stalled, and frames are skipped instead.
+static constexpr auto stall_timeout = std::chrono::seconds(1);
+
+// Frames carry the time they were queued at to the worker in AVFrame::opaque, which libavcodec leaves alone.
+static_assert(sizeof(intptr_t) >= sizeof(std::chrono::steady_clock::rep), "Queue time does not fit into AVFrame::opaque.");
+
+static void* queued_to_opaque(std::chrono::steady_clock::time_point queued)
+{
+	return reinterpret_cast<void*>(static_cast<intptr_t>(queued.time_since_epoch().count()));
+}
+
+static std::chrono::steady_clock::time_point queued_from_opaque(void* opaque)
+{
+	return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(static_cast<std::chrono::steady_clock::rep>(reinterpret_cast<intptr_t>(opaque))));
+}
+
 ffmpeg_instance::ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool is_hw)
 	: encoder_instance(settings, self, is_hw),
 
@@ -74,7 +93,13 @@ ffmpeg_instance::ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool
 
 	  _lag_in_frames(0), _sent_frames(0), _have_first_frame(false), _extra_data(), _sei_data(),
 
-	  _free_frames(), _used_frames(), _free_frames_last_used()
+	  _frame_pool(), _frame_pool_reserved(0),
+
+	  _frames(16), _free_frames(16), _packets(16), _worker_stop(false), _worker_failed(false), _worker(), _frames_submitted(0), _frames_pending(0), _frames_skipped(0), _worker_stalled(false), _worker_starved(0), _context_lock(),
+
+	  _zero_copy(false), _borrowed_planes(0), _borrowed_lock(), _borrowed_cv(),
+
+	  _latency_encode(streamfx::util::profiler::create()), _latency_total(streamfx::util::profiler::create())
 {
 	// Initialize GPU Stuff
 	if (is_hw) {
@@ -103,9 +128,8 @@ ffmpeg_instance::ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool
 		throw std::runtime_error("Failed to create encoder context.");
 	}
 
-	// Allocate a small packet for later use.
+	// Holds the packet that was last handed to OBS, which must stay valid until the next call.
 	_packet = {av_packet_alloc(), [](AVPacket* ptr) { av_packet_free(&ptr); }};
-	av_new_packet(_packet.get(), 8 * 1024 * 1024); // 8 MiB is usually enough for compressed data.
 
 	// Initialize
 	if (is_hw) {
@@ -132,26 +156,60 @@ ffmpeg_instance::ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool
 		throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
 	}
 
+	// Frames from OBS can be handed to the encoder as they are, if nothing needs to be converted and the encoder is done
+	// with each frame by the time it returned the packet for it.
+	if (!_hwinst && (_scaler.is_source_full_range() == _scaler.is_target_full_range()) && (_scaler.get_source_colorspace() == _scaler.get_target_colorspace()) && (_scaler.get_source_format() == _scaler.get_target_format())) {
+		_zero_copy = !::streamfx::ffmpeg::tools::encoder_keeps_frames(_context);
+	}
+
+	// How many frames the encoder holds on to before it returns a packet, as far as it tells us.
+	_lag_in_frames = static_cast<size_t>(std::max({_context->delay, _context->has_b_frames, 0}));
+
+	// Allocate the frames the encoder holds on to for reordering, the one it is encoding and the one being filled up front.
+	// The delay is left out as it mostly counts frame threads, which would reserve dozens of frames on large machines.
+	// Anything beyond that is allocated by the pool when a burst of frames actually needs it.
+	if (!_hwinst) {
+		_frame_pool = ::streamfx::ffmpeg::frame_pool::instance(_context->pix_fmt, _context->width, _context->height);
+		if (!_zero_copy) {
+			_frame_pool_reserved = std::min(static_cast<size_t>(std::max(_context->has_b_frames, 0)) + 2, _frames.capacity());
+			_frame_pool->reserve(_frame_pool_reserved);
+		}
+	}
+
 	log();
+
+	// From here on, only the worker talks to libavcodec.
+	_worker = std::thread(&ffmpeg_instance::worker, this);
 }
 
 ffmpeg_instance::~ffmpeg_instance()
 {
+	// The worker flushes the encoder on its way out.
+	if (_worker.joinable()) {
+		_worker_stop.store(true, std::memory_order_release);
+		wake_worker();
+		_worker.join();
+	}
+	for (queued_packet item; _packets.try_pop(item);) {
+		av_packet_free(&item.packet);
+	}
+
+	if (auto encode = _latency_encode->snapshot(), total = _latency_total->snapshot(); encode.count() > 0) {
+		auto to_ms = [](std::chrono::nanoseconds value) { return static_cast<double_t>(value.count()) / 1000000.0; };
+		DLOG_INFO("[%s] Latency over %" PRIu64 " frames, encoding: %.3f / %.3f / %.3f / %.3f ms, delivery: %.3f / %.3f / %.3f / %.3f ms (50th / 95th / 99th percentile / maximum).", _codec->name, encode.count(), to_ms(encode.percentile(0.50)), to_ms(encode.percentile(0.95)), to_ms(encode.percentile(0.99)), to_ms(encode.maximum()), to_ms(total.percentile(0.50)), to_ms(total.percentile(0.95)), to_ms(total.percentile(0.99)), to_ms(total.maximum()));
+	}
+
 	auto gctx = streamfx::obs::gs::context();
 	if (_context) {
-		// Flush encoders that require it.
-		if ((_codec->capabilities & AV_CODEC_CAP_DELAY) != 0) {
-			avcodec_send_frame(_context, nullptr);
-			while (avcodec_receive_packet(_context, _packet.get()) >= 0) {
-				avcodec_send_frame(_context, nullptr);
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
-			}
-		}
-
 		// Close and free context.
 		avcodec_free_context(&_context);
 	}
 
+	// Other encoders may keep using the pool, which should not keep our frames around for them.
+	if (_frame_pool) {
+		_frame_pool->unreserve(_frame_pool_reserved);
+	}
+
 	av_packet_unref(_packet.get());
 
 	_scaler.finalize();
@@ -178,6 +236,9 @@ void ffmpeg_instance::migrate(obs_data_t* settings, uint64_t version)
 
 bool ffmpeg_instance::update(obs_data_t* settings)
 {
+	// OBS calls this on a thread of its own, while the worker may be in the middle of encoding.
+	std::lock_guard<std::mutex> lg(_context_lock);
+
 	bool support_reconfig           = false;
 	bool support_reconfig_threads   = false;
 	bool support_reconfig_gpu       = false;
@@ -274,36 +335,6 @@ bool ffmpeg_instance::update(obs_data_t* settings)
 	return true;
 }
 
-static inline void copy_data(encoder_frame* frame, AVFrame* vframe)
-{
-	int h_chroma_shift, v_chroma_shift;
-	av_pix_fmt_get_chroma_sub_sample(static_cast<AVPixelFormat>(vframe->format), &h_chroma_shift, &v_chroma_shift);
-
-	for (std::size_t idx = 0; idx < MAX_AV_PLANES; idx++) {
-		if (!frame->data[idx] || !vframe->data[idx])
-			continue;
-
-		std::size_t plane_height = static_cast<size_t>(vframe->height) >> (idx ? v_chroma_shift : 0);
-
-		if (static_cast<uint32_t>(vframe->linesize[idx]) == frame->linesize[idx]) {
-			std::memcpy(vframe->data[idx], frame->data[idx], frame->linesize[idx] * plane_height);
-		} else {
-			std::size_t ls_in  = static_cast<size_t>(frame->linesize[idx]);
-			std::size_t ls_out = static_cast<size_t>(vframe->linesize[idx]);
-			std::size_t bytes  = ls_in < ls_out ? ls_in : ls_out;
-
-			uint8_t* to   = vframe->data[idx];
-			uint8_t* from = frame->data[idx];
-
-			for (std::size_t y = 0; y < plane_height; y++) {
-				std::memcpy(to, from, bytes);
-				to += ls_out;
-				from += ls_in;
-			}
-		}
-	}
-}
-
 bool ffmpeg_instance::encode_audio(struct encoder_frame* frame, struct encoder_packet* packet, bool* received_packet)
 {
 	throw std::logic_error("The method or operation is not implemented.");
@@ -315,7 +346,23 @@ bool ffmpeg_instance::encode_video(struct encoder_frame* frame, struct encoder_p
 		return true;
 	}
 
-	std::shared_ptr<AVFrame> vframe = pop_free_frame(); // Retrieve an empty frame.
+	bool same_format = (_scaler.is_source_full_range() == _scaler.is_target_full_range()) && (_scaler.get_source_colorspace() == _scaler.get_target_colorspace()) && (_scaler.get_source_format() == _scaler.get_target_format());
+
+	AVFrame* vframe   = nullptr;
+	bool     borrowed = false;
+	if (same_format && _zero_copy) {
+		// Every plane is released once libavcodec is done with it, which these encoders are by the time they return the packet.
+		_borrowed_planes.store(static_cast<size_t>(av_pix_fmt_count_planes(_context->pix_fmt)), std::memory_order_relaxed);
+		vframe = ::streamfx::ffmpeg::tools::wrap_frame_data(frame, _context->pix_fmt, _context->width, _context->height, &ffmpeg_instance::release_borrowed, this);
+		if (vframe) {
+			borrowed = true;
+		} else {
+			_borrowed_planes.store(0, std::memory_order_relaxed);
+		}
+	}
+	if (!vframe) {
+		vframe = allocate_frame(); // Retrieve an empty frame.
+	}
 
 	// Convert frame.
 	{
@@ -327,18 +374,21 @@ bool ffmpeg_instance::encode_video(struct encoder_frame* frame, struct encoder_p
 		vframe->color_trc       = _context->color_trc;
 		vframe->pts             = frame->pts;
 
-		if ((_scaler.is_source_full_range() == _scaler.is_target_full_range()) && (_scaler.get_source_colorspace() == _scaler.get_target_colorspace()) && (_scaler.get_source_format() == _scaler.get_target_format())) {
-			copy_data(frame, vframe.get());
+		if (borrowed) {
+			// Nothing to do, the frame already points at the planes of OBS.
+		} else if (same_format) {
+			::streamfx::ffmpeg::tools::copy_frame_data(frame, vframe);
 		} else {
 			int res = _scaler.convert(reinterpret_cast<uint8_t**>(frame->data), reinterpret_cast<int*>(frame->linesize), 0, _context->height, vframe->data, vframe->linesize);
 			if (res <= 0) {
 				DLOG_ERROR("Failed to convert frame: %s (%" PRId32 ").", ::streamfx::ffmpeg::tools::get_error_description(res), res);
+				recycle_frame(vframe);
 				return false;
 			}
 		}
 	}
 
-	if (!encode_avframe(vframe, packet, received_packet))
+	if (!encode_avframe(vframe, packet, received_packet, borrowed))
 		return false;
 
 	return true;
@@ -358,8 +408,14 @@ bool ffmpeg_instance::encode_video(uint32_t handle, int64_t pts, uint64_t lock_k
 		return false;
 	}
 
-	std::shared_ptr<AVFrame> vframe = pop_free_frame();
-	_hwinst->copy_from_obs(_context->hw_frames_ctx, handle, lock_key, next_key, vframe);
+	// The copy only borrows the frame, which stays ours until it is queued for the worker.
+	AVFrame* vframe = allocate_frame();
+	try {
+		_hwinst->copy_from_obs(_context->hw_frames_ctx, handle, lock_key, next_key, std::shared_ptr<AVFrame>(vframe, [](AVFrame*) {}));
+	} catch (...) {
+		recycle_frame(vframe);
+		throw;
+	}
 
 	vframe->color_range     = _context->color_range;
 	vframe->colorspace      = _context->colorspace;
@@ -413,7 +469,8 @@ void ffmpeg_instance::initialize_sw(obs_data_t* settings)
 	_scaler.set_target_color(_context->color_range == AVCOL_RANGE_JPEG, _context->colorspace);
 	_scaler.set_target_format(pix_fmt_target);
 
-	// Create Scaler
+	// Create Scaler, which splits large frames into bands that are converted in parallel.
+	_scaler.set_threads(0);
 	if (!_scaler.initialize(SWS_SINC | SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND | SWS_BITEXACT)) {
 		std::stringstream sstr;
 		sstr << "Initializing scaler failed for conversion from '" << ::streamfx::ffmpeg::tools::get_pixel_format_name(_scaler.get_source_format()) << "' to '" << ::streamfx::ffmpeg::tools::get_pixel_format_name(_scaler.get_target_format()) << "' with color space '" << ::streamfx::ffmpeg::tools::get_color_space_name(_scaler.get_source_colorspace()) << "' and " << (_scaler.is_source_full_range() ? "full" : "partial") << " range.";
@@ -456,59 +513,34 @@ void ffmpeg_instance::initialize_hw(obs_data_t*)
 #endif
 }
 
-void ffmpeg_instance::push_free_frame(std::shared_ptr<AVFrame> frame)
+AVFrame* ffmpeg_instance::allocate_frame()
 {
-	auto now = std::chrono::high_resolution_clock::now();
-	if (_free_frames.size() > 0) {
-		if ((now - _free_frames_last_used) < std::chrono::seconds(1)) {
-			_free_frames.push(frame);
-		}
-	} else {
-		_free_frames.push(frame);
-		_free_frames_last_used = std::chrono::high_resolution_clock::now();
+	AVFrame* frame = _free_frames.pop_only();
+	if (!frame && !(frame = av_frame_alloc())) {
+		throw std::bad_alloc();
 	}
-}
 
-std::shared_ptr<AVFrame> ffmpeg_instance::pop_free_frame()
-{
-	std::shared_ptr<AVFrame> frame;
-	if (_free_frames.size() > 0) {
-		// Re-use existing frames first.
-		frame = _free_frames.top();
-		_free_frames.pop();
-	} else {
+	try {
 		if (_hwinst) {
-			frame = _hwinst->allocate_frame(_context->hw_frames_ctx);
+			// Hardware frames come from a pool of their own.
+			auto hwframe = _hwinst->allocate_frame(_context->hw_frames_ctx);
+			av_frame_move_ref(frame, hwframe.get());
 		} else {
-			frame = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
-				av_frame_unref(frame);
-				av_frame_free(&frame);
-			});
-
-			frame->width  = _context->width;
-			frame->height = _context->height;
-			frame->format = _context->pix_fmt;
-
-			int res = av_frame_get_buffer(frame.get(), 32);
-			if (res < 0) {
-				throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
-			}
+			_frame_pool->allocate(frame);
 		}
+	} catch (...) {
+		av_frame_free(&frame);
+		throw;
 	}
-
 	return frame;
 }
 
-void ffmpeg_instance::push_used_frame(std::shared_ptr<AVFrame> frame)
+void ffmpeg_instance::recycle_frame(AVFrame* frame)
 {
-	_used_frames.push(frame);
-}
-
-std::shared_ptr<AVFrame> ffmpeg_instance::pop_used_frame()
-{
-	auto frame = _used_frames.front();
-	_used_frames.pop();
-	return frame;
+	av_frame_unref(frame);
+	if (!_free_frames.push(frame)) {
+		av_frame_free(&frame);
+	}
 }
 
 bool ffmpeg_instance::get_extra_data(uint8_t** data, size_t* size)
@@ -539,20 +571,20 @@ void ffmpeg_instance::get_video_info(struct video_scale_info* info)
 	}
 }
 
-int ffmpeg_instance::receive_packet(bool* received_packet, struct encoder_packet* packet)
+int ffmpeg_instance::receive_packet(AVPacket* packet)
 {
 	int res = 0;
-
-	av_packet_unref(_packet.get());
-
 	{
-		auto gctx = streamfx::obs::gs::context();
-		res       = avcodec_receive_packet(_context, _packet.get());
-	}
-	if (res != 0) {
-		return res;
+		streamfx::util::trace::scope trace{"encoder", "avcodec_receive_packet"};
+		std::lock_guard<std::mutex>  lg(_context_lock);
+		auto                         gctx = streamfx::obs::gs::context();
+		res                               = avcodec_receive_packet(_context, packet);
 	}
+	return res;
+}
 
+void ffmpeg_instance::process_packet(struct encoder_packet* packet, bool* received_packet)
+{
 	if (!_have_first_frame) {
 		if (_codec->id == AV_CODEC_ID_H264) {
 			uint8_t*    tmp_packet;
@@ -650,99 +682,275 @@ int ffmpeg_instance::receive_packet(bool* received_packet, struct encoder_packet
 			}
 		}
 	}
-
-	// Push free frame back into pool.
-	push_free_frame(pop_used_frame());
-
-	return res;
 }
 
-int ffmpeg_instance::send_frame(std::shared_ptr<AVFrame> const frame)
+int ffmpeg_instance::send_frame(AVFrame* const frame)
 {
 	int res = 0;
 	{
-		auto gctx = streamfx::obs::gs::context();
-		res       = avcodec_send_frame(_context, frame.get());
+		streamfx::util::trace::scope trace{"encoder", "avcodec_send_frame"};
+		std::lock_guard<std::mutex>  lg(_context_lock);
+		auto                         gctx = streamfx::obs::gs::context();
+		res                               = avcodec_send_frame(_context, frame);
 	}
-	if (res == 0) {
-		push_used_frame(frame);
+	return res;
+}
+
+bool ffmpeg_instance::encode_avframe(AVFrame* frame, encoder_packet* packet, bool* received_packet, bool borrowed)
+{
+	if (_worker_failed.load(std::memory_order_acquire)) {
+		recycle_frame(frame);
+		return false;
 	}
 
-	return res;
+	frame->opaque = queued_to_opaque(std::chrono::steady_clock::now());
+	if (_frames.push(frame)) {
+		_frames_submitted++;
+		_frames_pending++;
+	} else {
+		// Only happens once the worker stalled, see below.
+		_frames_skipped++;
+		DLOG_WARNING("Skipped %" PRIu64 " frames so far as the encoder is stalled.", _frames_skipped);
+		recycle_frame(frame);
+	}
+
+	if (borrowed) {
+		// A worker that failed in the meantime may not look at the queue again, so let go of what it left behind.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_worker_failed.load(std::memory_order_relaxed)) {
+			_frames.clear();
+		}
+
+		// OBS reuses the planes once we return, so wait until neither the worker nor libavcodec reference them. A failed
+		// worker has let go of all it could, and what libavcodec may still hold is only ever read.
+		std::unique_lock<std::mutex> ul(_borrowed_lock);
+		_borrowed_cv.wait(ul, [this]() { return (_borrowed_planes.load(std::memory_order_acquire) == 0) || _worker_failed.load(std::memory_order_acquire); });
+		if (_borrowed_planes.load(std::memory_order_relaxed) != 0) {
+			DLOG_ERROR("Encoder failed while it was holding on to a frame of OBS.");
+			return false;
+		}
+	}
+
+	// Hand out the oldest finished packet, which also makes room for the worker if it was blocked on a full queue. Once
+	// more frames are pending than the encoder holds on to, that packet is due, and waited for.
+	auto deadline = std::chrono::steady_clock::now() + stall_timeout;
+	while (true) {
+		// Read before looking for a packet, as the worker pushes all packets it has before it reports to be starved.
+		uint64_t generation = _frames.generation();
+		bool     starved    = _worker_starved.load(std::memory_order_acquire) == _frames_submitted;
+		if (queued_packet item; _packets.try_pop(item)) {
+			_latency_total->track(std::chrono::steady_clock::now() - item.queued);
+
+			av_packet_unref(_packet.get());
+			av_packet_move_ref(_packet.get(), item.packet);
+			av_packet_free(&item.packet);
+			process_packet(packet, received_packet);
+			_frames_pending -= (_frames_pending > 0) ? 1 : 0;
+			_worker_stalled = false;
+			wake_worker();
+			break;
+		}
+
+		// A stalled worker is not waited on again until it finished a packet, so that the queue fills up and frames are
+		// skipped instead of holding up OBS on every one of them.
+		if ((_frames_pending <= (_lag_in_frames + 1)) || _worker_stalled || _worker_failed.load(std::memory_order_acquire)) {
+			break;
+		}
+
+		if (starved) {
+			// libavcodec has every frame and still wants more, so it holds on to more than it told us. Let it.
+			_lag_in_frames = _frames_pending - 1;
+			break;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (now >= deadline) {
+			DLOG_WARNING("Encoder did not finish a packet within %" PRId64 " ms.", static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(stall_timeout).count()));
+			_worker_stalled = true;
+			break;
+		}
+		_frames.wait(deadline - now, generation);
+	}
+
+	return true;
 }
 
-bool ffmpeg_instance::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_packet* packet, bool* received_packet)
+void ffmpeg_instance::release_borrowed(void* opaque, uint8_t*)
 {
-	bool sent_frame  = false;
-	bool recv_packet = false;
-	bool should_lag  = (_sent_frames >= _lag_in_frames);
+	auto self = reinterpret_cast<ffmpeg_instance*>(opaque);
+	if (self->_borrowed_planes.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		std::lock_guard<std::mutex> lg(self->_borrowed_lock);
+		self->_borrowed_cv.notify_all();
+	}
+}
 
-	auto loop_begin = std::chrono::high_resolution_clock::now();
-	auto loop_end   = loop_begin + std::chrono::milliseconds(50);
+void ffmpeg_instance::wake_worker()
+{
+	_frames.notify_all();
+}
 
-	while ((!sent_frame || (should_lag && !recv_packet)) && !(std::chrono::high_resolution_clock::now() > loop_end)) {
-		bool eagain_is_stupid = false;
+void ffmpeg_instance::worker()
+{
+	// Frame that libavcodec did not accept yet.
+	AVFrame* frame = nullptr;
 
-		if (!sent_frame) {
-			int res = send_frame(frame);
-			switch (res) {
+	// Packet that did not fit into the queue yet, and an empty packet to receive the next one into.
+	AVPacket*                             packet = nullptr;
+	std::chrono::steady_clock::time_point packet_queued;
+	AVPacket*                             spare  = nullptr;
+
+	// When each frame that is inside libavcodec was queued, to match packets with by their timestamp.
+	std::deque<std::pair<int64_t, std::chrono::steady_clock::time_point>> in_flight;
+
+	// Frames taken from the queue so far.
+	uint64_t taken = 0;
+
+	while (!_worker_stop.load(std::memory_order_acquire)) {
+		// Anything that happens after this wakes us up from the wait below, so nothing can be missed.
+		uint64_t generation = _frames.generation();
+		bool     progress   = false;
+
+		if (packet && _packets.try_push({packet, packet_queued})) {
+			packet   = nullptr;
+			progress = true;
+			_frames.notify_all();
+		}
+
+		if (!frame && (frame = _frames.pop_only())) {
+			taken++;
+		}
+
+		int send_res = AVERROR(EAGAIN);
+		if (frame) {
+			send_res = send_frame(frame);
+			switch (send_res) {
 			case 0:
-				sent_frame = true;
-				frame      = nullptr;
+				// libavcodec holds a reference of its own now.
+				in_flight.emplace_back(frame->pts, queued_from_opaque(frame->opaque));
+				if (in_flight.size() > 256) { // Frames the encoder dropped never get a packet.
+					in_flight.pop_front();
+				}
+				recycle_frame(std::exchange(frame, nullptr));
+				progress = true;
 				break;
 			case AVERROR(EAGAIN):
-				// This means we should call receive_packet again, but what do we do with that data?
-				// Why can't we queue on both? Do I really have to implement threading for this stuff?
-				if (*received_packet == true) {
-					DLOG_WARNING("Skipped frame due to EAGAIN when a packet was already returned.");
-					sent_frame = true;
-				}
-				eagain_is_stupid = true;
+				// The encoder wants us to receive packets first.
 				break;
-			case AVERROR(EOF):
+			case AVERROR_EOF:
 				DLOG_ERROR("Skipped frame due to end of stream.");
-				sent_frame = true;
+				recycle_frame(std::exchange(frame, nullptr));
 				break;
 			default:
-				DLOG_ERROR("Failed to encode frame: %s (%" PRId32 ").", ::streamfx::ffmpeg::tools::get_error_description(res), res);
-				return false;
+				DLOG_ERROR("Failed to encode frame: %s (%" PRId32 ").", ::streamfx::ffmpeg::tools::get_error_description(send_res), send_res);
+				_worker_failed.store(true, std::memory_order_release);
+				break;
 			}
 		}
 
-		if (!recv_packet) {
-			int res = receive_packet(received_packet, packet);
+		if (!spare && !(spare = av_packet_alloc())) {
+			DLOG_ERROR("Failed to allocate packet.");
+			_worker_failed.store(true, std::memory_order_release);
+		}
+
+		if (!packet && !_worker_failed.load(std::memory_order_relaxed)) {
+			int res = receive_packet(spare);
 			switch (res) {
-			case 0:
-				recv_packet = true;
-				break;
-			case AVERROR(EOF):
-				DLOG_ERROR("Received end of file.");
-				recv_packet = true;
+			case 0: {
+				auto now      = std::chrono::steady_clock::now();
+				packet        = std::exchange(spare, nullptr);
+				packet_queued = now;
+				for (auto itr = in_flight.begin(); itr != in_flight.end(); itr++) {
+					if (itr->first == packet->pts) {
+						packet_queued = itr->second;
+						in_flight.erase(itr);
+						break;
+					}
+				}
+				_latency_encode->track(now - packet_queued);
+
+				if (_packets.try_push({packet, packet_queued})) {
+					packet = nullptr;
+					_frames.notify_all();
+				}
+				progress = true;
 				break;
+			}
 			case AVERROR(EAGAIN):
-				if (sent_frame) {
-					recv_packet = true;
-				}
-				if (eagain_is_stupid) {
-					DLOG_ERROR("Both send and recieve returned EAGAIN, encoder is broken.");
-					return false;
+				if (frame && (send_res == AVERROR(EAGAIN))) {
+					DLOG_ERROR("Both send and receive returned EAGAIN, encoder is broken.");
+					_worker_failed.store(true, std::memory_order_release);
 				}
 				break;
+			case AVERROR_EOF:
+				DLOG_ERROR("Received end of file.");
+				break;
 			default:
 				DLOG_ERROR("Failed to receive packet: %s (%" PRId32 ").", ::streamfx::ffmpeg::tools::get_error_description(res), res);
-				return false;
+				_worker_failed.store(true, std::memory_order_release);
+				break;
 			}
 		}
 
-		if (!sent_frame || !recv_packet) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if (_worker_failed.load(std::memory_order_relaxed)) {
+			break;
+		}
+
+		if (!progress) {
+			// Nothing left to do until OBS queues another frame, takes a packet, or we are told to stop. The timeout only
+			// keeps the deadline in range, every one of those wakes us up.
+			if (frame) {
+				_frames.wait(std::chrono::seconds(1), generation);
+			} else {
+				if (!packet) {
+					// libavcodec has every frame we got, and wants more before it returns the next packet.
+					_worker_starved.store(taken, std::memory_order_release);
+					_frames.notify_all();
+					generation = _frames.generation();
+				}
+				if ((frame = _frames.pop_wait(std::chrono::seconds(1), generation))) {
+					taken++;
+				}
+			}
 		}
 	}
 
-	if (!sent_frame)
-		push_free_frame(frame);
+	// Flush encoders that require it, so that they release what they still hold on to.
+	if (!spare) {
+		spare = av_packet_alloc();
+	}
+	if (spare && !_worker_failed.load(std::memory_order_relaxed) && ((_codec->capabilities & AV_CODEC_CAP_DELAY) != 0)) {
+		if (send_frame(nullptr) == 0) {
+			while (receive_packet(spare) == 0) {
+				av_packet_unref(spare);
+			}
+		}
+	}
 
-	return true;
+	// Frames borrowed from OBS are waited on, so let go of every frame that will not be encoded anymore.
+	if (frame) {
+		recycle_frame(frame);
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	_frames.clear();
+
+	if (_worker_failed.load(std::memory_order_relaxed)) {
+		// Frames that libavcodec accepted are otherwise only released with the context, which is long after OBS gave up.
+#ifdef AV_CODEC_CAP_ENCODER_FLUSH
+		if ((_codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH) != 0) {
+			std::lock_guard<std::mutex> lg(_context_lock);
+			auto                        gctx = streamfx::obs::gs::context();
+			avcodec_flush_buffers(_context);
+		}
+#endif
+
+		// Nothing releases frames borrowed from OBS anymore, so stop waiting for them and for packets.
+		_frames.notify_all();
+		std::lock_guard<std::mutex> lg(_borrowed_lock);
+		_borrowed_cv.notify_all();
+	}
+
+	av_packet_free(&packet);
+	av_packet_free(&spare);
 }
 
 bool ffmpeg_instance::is_hardware_encode()
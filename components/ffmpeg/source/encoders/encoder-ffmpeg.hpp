@@ -7,16 +7,19 @@
 #include "common.hpp"
 #include "encoders/ffmpeg/handler.hpp"
 #include "ffmpeg/avframe-queue.hpp"
+#include "ffmpeg/frame-pool.hpp"
 #include "ffmpeg/hwapi/base.hpp"
 #include "ffmpeg/swscale.hpp"
 #include "obs/obs-encoder-factory.hpp"
+#include "util/util-bounded-queue.hpp"
+#include "util/util-profiler.hpp"
 
 #include "warning-disable.hpp"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <map>
 #include <mutex>
-#include <queue>
-#include <stack>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -55,10 +58,43 @@ namespace streamfx::encoder::ffmpeg {
 		std::vector<uint8_t> _extra_data;
 		std::vector<uint8_t> _sei_data;
 
-		// Frame Stack and Queue
-		std::stack<std::shared_ptr<AVFrame>>           _free_frames;
-		std::queue<std::shared_ptr<AVFrame>>           _used_frames;
-		std::chrono::high_resolution_clock::time_point _free_frames_last_used;
+		// Frames to copy or convert into, shared with other encoders of the same format and size, and how many of them we
+		// reserved for ourselves.
+		std::shared_ptr<::streamfx::ffmpeg::frame_pool> _frame_pool;
+		std::size_t                                     _frame_pool_reserved;
+
+		// Worker, which gets frames that carry the time they were queued at, and gives back the empty frames it is done with.
+		struct queued_packet {
+			AVPacket*                             packet = nullptr;
+			std::chrono::steady_clock::time_point queued;
+		};
+		::streamfx::ffmpeg::avframe_queue            _frames;
+		::streamfx::ffmpeg::avframe_queue            _free_frames;
+		streamfx::util::bounded_queue<queued_packet> _packets;
+		std::atomic<bool>                            _worker_stop;
+		std::atomic<bool>                            _worker_failed;
+		std::thread                                  _worker;
+
+		// Frames queued and packets handed out, which keep the pipeline at a fixed depth, see encode_avframe(). The worker
+		// reports how many frames it had taken when it last ran out of work while libavcodec wanted more.
+		uint64_t              _frames_submitted;
+		size_t                _frames_pending;
+		uint64_t              _frames_skipped;
+		bool                  _worker_stalled;
+		std::atomic<uint64_t> _worker_starved;
+
+		// Held by the worker while it calls into libavcodec, and by update() while it reconfigures the context.
+		std::mutex _context_lock;
+
+		// Frames that wrap the planes of OBS instead of copying them, see encode_video().
+		bool                    _zero_copy;
+		std::atomic<size_t>     _borrowed_planes;
+		std::mutex              _borrowed_lock;
+		std::condition_variable _borrowed_cv;
+
+		// Time from a frame being queued until its packet is ready, and until it is handed to OBS.
+		std::shared_ptr<streamfx::util::profiler> _latency_encode;
+		std::shared_ptr<streamfx::util::profiler> _latency_total;
 
 		public:
 		ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool is_hw);
@@ -87,17 +123,35 @@ namespace streamfx::encoder::ffmpeg {
 		void initialize_sw(obs_data_t* settings);
 		void initialize_hw(obs_data_t* settings);
 
-		void                     push_free_frame(std::shared_ptr<AVFrame> frame);
-		std::shared_ptr<AVFrame> pop_free_frame();
+		/** Allocate an empty frame for the encoder, whose buffers return to where they came from once nothing references them.
+		 */
+		AVFrame* allocate_frame();
 
-		void                     push_used_frame(std::shared_ptr<AVFrame> frame);
-		std::shared_ptr<AVFrame> pop_used_frame();
+		/** Let go of everything the frame references, and keep the frame itself around for allocate_frame().
+		 */
+		void recycle_frame(AVFrame* frame);
 
-		int receive_packet(bool* received_packet, struct encoder_packet* packet);
+		int receive_packet(AVPacket* packet);
 
-		int send_frame(std::shared_ptr<AVFrame> frame);
+		int send_frame(AVFrame* frame);
 
-		bool encode_avframe(std::shared_ptr<AVFrame> frame, struct encoder_packet* packet, bool* received_packet);
+		void process_packet(struct encoder_packet* packet, bool* received_packet);
+
+		/** Queue a frame for the worker, and hand out the oldest packet the worker has finished, if any.
+		 *
+		 * Once more frames are queued than the encoder holds on to, this waits for the packet of the oldest one, so that
+		 * latency does not grow with every packet that was not quite ready yet. A frame that is `borrowed` from OBS is also
+		 * waited on until nothing references it anymore, or the worker failed. If the worker is stalled, the frame is
+		 * skipped instead. Either way, the frame belongs to us afterwards.
+		 */
+		bool encode_avframe(AVFrame* frame, struct encoder_packet* packet, bool* received_packet, bool borrowed = false);
+
+		static void release_borrowed(void* opaque, uint8_t* data);
+
+		void wake_worker();
+
+		/// Drives libavcodec on its own thread, so that neither side ever has to wait for the other.
+		void worker();
 
 		public: // Handler API
 		bool is_hardware_encode();
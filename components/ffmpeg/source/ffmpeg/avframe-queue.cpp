@@ -6,27 +6,32 @@
 #include "avframe-queue.hpp"
 #include "tools.hpp"
 
+#include "warning-disable.hpp"
+#include <stdexcept>
+#include "warning-enable.hpp"
+
 using namespace streamfx::ffmpeg;
 
-std::shared_ptr<AVFrame> avframe_queue::create_frame()
+AVFrame* avframe_queue::create_frame()
 {
-	std::shared_ptr<AVFrame> frame = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
-		av_frame_unref(frame);
-		av_frame_free(&frame);
-	});
-	frame->width                   = this->_resolution.first;
-	frame->height                  = this->_resolution.second;
-	frame->format                  = this->_format;
+	AVFrame* frame = av_frame_alloc();
+	if (!frame) {
+		throw std::bad_alloc();
+	}
+	frame->width  = this->_resolution.first;
+	frame->height = this->_resolution.second;
+	frame->format = this->_format;
 
-	int res = av_frame_get_buffer(frame.get(), 32);
+	int res = av_frame_get_buffer(frame, 32);
 	if (res < 0) {
+		av_frame_free(&frame);
 		throw std::runtime_error(tools::get_error_description(res));
 	}
 
 	return frame;
 }
 
-avframe_queue::avframe_queue() = default;
+avframe_queue::avframe_queue(std::size_t capacity) : _frames(capacity), _waiters(0), _wait_lock(), _wait_cv(), _wakeups(0), _resolution(), _format(AV_PIX_FMT_NONE) {}
 
 avframe_queue::~avframe_queue()
 {
@@ -68,56 +73,102 @@ AVPixelFormat avframe_queue::get_pixel_format()
 void avframe_queue::precache(std::size_t count)
 {
 	for (std::size_t n = 0; n < count; n++) {
-		push(create_frame());
+		AVFrame* frame = create_frame();
+		if (!push(frame)) {
+			av_frame_free(&frame);
+			break;
+		}
 	}
 }
 
 void avframe_queue::clear()
 {
-	std::unique_lock<std::mutex> ulock(this->_lock);
-	_frames.clear();
+	for (AVFrame* frame = pop_only(); frame; frame = pop_only()) {
+		av_frame_free(&frame);
+	}
 }
 
-void avframe_queue::push(std::shared_ptr<AVFrame> const frame)
+bool avframe_queue::push(AVFrame* frame)
 {
-	std::unique_lock<std::mutex> ulock(this->_lock);
-	_frames.push_back(frame);
+	if (!_frames.try_push(frame)) {
+		return false;
+	}
+
+	// Pairs with the increment in pop_wait(): either the waiter sees the frame before it sleeps, or we see the waiter.
+	// Threads in wait() share the condition variable, so all of them have to be woken up to be sure to reach the right one.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_waiters.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lg(_wait_lock);
+		_wait_cv.notify_all();
+	}
+	return true;
 }
 
-std::shared_ptr<AVFrame> avframe_queue::pop()
+AVFrame* avframe_queue::pop()
 {
-	std::unique_lock<std::mutex> ulock(this->_lock);
-	std::shared_ptr<AVFrame>     ret;
-	while (ret == nullptr) {
-		if (_frames.size() == 0) {
-			ret = create_frame();
-		} else {
-			ret = _frames.front();
-			if (ret == nullptr) {
-				ret = create_frame();
-			} else {
-				_frames.pop_front();
-				if ((static_cast<int32_t>(ret->width) != this->_resolution.first) || (static_cast<int32_t>(ret->height) != this->_resolution.second) || (ret->format != this->_format)) {
-					ret = nullptr;
-				}
-			}
+	while (AVFrame* frame = pop_only()) {
+		if ((frame->width == this->_resolution.first) && (frame->height == this->_resolution.second) && (frame->format == this->_format)) {
+			return frame;
 		}
+		av_frame_free(&frame);
 	}
-	return ret;
+	return create_frame();
+}
+
+AVFrame* avframe_queue::pop_only()
+{
+	AVFrame* frame = nullptr;
+	_frames.try_pop(frame);
+	return frame;
+}
+
+AVFrame* avframe_queue::pop_wait(std::chrono::nanoseconds timeout)
+{
+	return pop_wait(timeout, generation());
 }
 
-std::shared_ptr<AVFrame> avframe_queue::pop_only()
+AVFrame* avframe_queue::pop_wait(std::chrono::nanoseconds timeout, uint64_t generation)
 {
-	std::unique_lock<std::mutex> ulock(this->_lock);
-	if (_frames.size() == 0) {
-		return nullptr;
+	if (AVFrame* frame = pop_only(); frame) {
+		return frame;
 	}
-	std::shared_ptr<AVFrame> ret = _frames.front();
-	if (ret == nullptr) {
-		return nullptr;
+
+	auto                         deadline = std::chrono::steady_clock::now() + timeout;
+	std::unique_lock<std::mutex> ul(_wait_lock);
+	_waiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	AVFrame* frame = nullptr;
+	while (!(frame = pop_only())) {
+		if (_wakeups.load(std::memory_order_relaxed) != generation) {
+			break;
+		}
+		if (_wait_cv.wait_until(ul, deadline) == std::cv_status::timeout) {
+			frame = pop_only();
+			break;
+		}
 	}
-	_frames.pop_front();
-	return ret;
+
+	_waiters.fetch_sub(1, std::memory_order_relaxed);
+	return frame;
+}
+
+void avframe_queue::wait(std::chrono::nanoseconds timeout, uint64_t generation)
+{
+	std::unique_lock<std::mutex> ul(_wait_lock);
+	_wait_cv.wait_for(ul, timeout, [this, generation]() { return _wakeups.load(std::memory_order_relaxed) != generation; });
+}
+
+void avframe_queue::notify_all()
+{
+	std::lock_guard<std::mutex> lg(_wait_lock);
+	_wakeups.fetch_add(1, std::memory_order_release);
+	_wait_cv.notify_all();
+}
+
+uint64_t avframe_queue::generation()
+{
+	return _wakeups.load(std::memory_order_acquire);
 }
 
 bool avframe_queue::empty()
@@ -129,3 +180,8 @@ std::size_t avframe_queue::size()
 {
 	return _frames.size();
 }
+
+std::size_t avframe_queue::capacity()
+{
+	return _frames.capacity();
+}
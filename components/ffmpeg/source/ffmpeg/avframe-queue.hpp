@@ -4,9 +4,13 @@
 
 #pragma once
 #include "common.hpp"
+#include "util/util-bounded-queue.hpp"
 
 #include "warning-disable.hpp"
-#include <deque>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include "warning-enable.hpp"
 
@@ -17,17 +21,30 @@ extern "C" {
 }
 
 namespace streamfx::ffmpeg {
+	/** Bounded queue of frames for any number of producers and consumers.
+	 *
+	 * Frames are handed over as plain pointers, and the queue owns every frame that is in it. Pushing and popping never
+	 * take a lock, only pop_wait() does so while there is nothing to pop. Frames left in the queue are freed with it.
+	 *
+	 * The resolution and pixel format are only used to create frames, and should not be changed while other threads use
+	 * the queue.
+	 */
 	class avframe_queue {
-		std::deque<std::shared_ptr<AVFrame>> _frames;
-		std::mutex                           _lock;
+		streamfx::util::bounded_queue<AVFrame*> _frames;
+
+		// Only used by pop_wait() and wait() while there is nothing to do.
+		std::atomic<size_t>     _waiters;
+		std::mutex              _wait_lock;
+		std::condition_variable _wait_cv;
+		std::atomic<uint64_t>   _wakeups;
 
 		std::pair<int32_t, int32_t> _resolution;
 		AVPixelFormat               _format = AV_PIX_FMT_NONE;
 
-		std::shared_ptr<AVFrame> create_frame();
-
 		public:
-		avframe_queue();
+		/** Create a queue for at least `capacity` frames, rounded up to the next power of two.
+		 */
+		avframe_queue(std::size_t capacity = 64);
 		~avframe_queue();
 
 		void    set_resolution(int32_t width, int32_t height);
@@ -38,18 +55,67 @@ namespace streamfx::ffmpeg {
 		void          set_pixel_format(AVPixelFormat format);
 		AVPixelFormat get_pixel_format();
 
+		/** Allocate a frame with the current resolution and pixel format, which the caller owns.
+		 */
+		AVFrame* create_frame();
+
+		/** Fill the queue with up to `count` newly allocated frames, so that pop() does not have to allocate later on.
+		 */
 		void precache(std::size_t count);
 
+		/** Free all frames in the queue.
+		 */
 		void clear();
 
-		void push(std::shared_ptr<AVFrame> frame);
-
-		std::shared_ptr<AVFrame> pop();
-
-		std::shared_ptr<AVFrame> pop_only();
+		/** Hand a frame over to the queue.
+		 *
+		 * @return false if the queue is full, in which case the caller keeps the frame.
+		 */
+		bool push(AVFrame* frame);
+
+		/** Take a frame that matches the current resolution and pixel format, or create one if there is none.
+		 *
+		 * Frames that no longer match are freed.
+		 */
+		AVFrame* pop();
+
+		/** Take the oldest frame, as is.
+		 *
+		 * @return nullptr if the queue is empty.
+		 */
+		AVFrame* pop_only();
+
+		/** Take the oldest frame, waiting for up to `timeout` for one to be pushed.
+		 *
+		 * @return nullptr if nothing was pushed in time.
+		 */
+		AVFrame* pop_wait(std::chrono::nanoseconds timeout);
+
+		/** Take the oldest frame, waiting for up to `timeout` for one to be pushed or for notify_all() to be called.
+		 *
+		 * Returns right away if notify_all() was called since `generation` was read, so that a consumer which also waits
+		 * for other things can't miss the notification for them.
+		 *
+		 * @return nullptr if nothing was pushed in time.
+		 */
+		AVFrame* pop_wait(std::chrono::nanoseconds timeout, uint64_t generation);
+
+		/** Wait for up to `timeout` for notify_all() to be called since `generation` was read, ignoring pushed frames.
+		 */
+		void wait(std::chrono::nanoseconds timeout, uint64_t generation);
+
+		/** Wake up all threads waiting in pop_wait() or wait(), which then return nullptr unless a frame was pushed.
+		 */
+		void notify_all();
+
+		/** Number of times notify_all() was called, to hand to pop_wait() or wait() later on.
+		 */
+		uint64_t generation();
 
 		bool empty();
 
 		std::size_t size();
+
+		std::size_t capacity();
 	};
 } // namespace streamfx::ffmpeg
@@ -0,0 +1,253 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "frame-pool.hpp"
+#include "tools.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#if defined(D_PLATFORM_WINDOWS)
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+#include "warning-enable.hpp"
+
+extern "C" {
+#include "warning-disable.hpp"
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include "warning-enable.hpp"
+}
+
+using namespace streamfx::ffmpeg;
+
+// Alignment of every plane and row, which is more than any SIMD code in encoders asks for.
+static constexpr size_t plane_alignment = 64;
+
+// Some SIMD code reads a little past the end of the last plane.
+static constexpr size_t buffer_padding = 64;
+
+// Size of a huge page on x86 and most ARM systems. Buffers at least this large are aligned to it, so that the kernel can
+// back them with huge pages.
+static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+static void* allocate_memory(size_t size)
+{
+	size_t alignment = (size >= huge_page_size) ? huge_page_size : plane_alignment;
+
+#if defined(D_PLATFORM_WINDOWS)
+	// Large pages on Windows need a privilege that OBS does not have, so this only gets us the alignment.
+	return _aligned_malloc(size, alignment);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, size) != 0) {
+		return nullptr;
+	}
+#ifdef MADV_HUGEPAGE
+	// Only a hint, which the kernel ignores if transparent huge pages are disabled. It has to come before the memory is
+	// touched for the first time, or the buffer has to wait for the kernel to collapse its pages later on.
+	if (alignment == huge_page_size) {
+		madvise(ptr, size, MADV_HUGEPAGE);
+	}
+#endif
+	return ptr;
+#endif
+}
+
+static void free_memory(void*, uint8_t* data)
+{
+#if defined(D_PLATFORM_WINDOWS)
+	_aligned_free(data);
+#else
+	free(data);
+#endif
+}
+
+frame_pool::frame_pool(AVPixelFormat format, int32_t width, int32_t height) : _format(format), _width(width), _height(height), _linesize(), _offset(), _size(0), _pool(nullptr), _pool_lock(), _allocated(0), _reserve_lock(), _reserved(0)
+{
+	AVPixFmtDescriptor const* desc = av_pix_fmt_desc_get(format);
+	if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) || (width <= 0) || (height <= 0)) {
+		throw std::invalid_argument("format");
+	}
+
+	// Same layout as av_frame_get_buffer() uses, all planes in one buffer, but with wider alignment.
+	if (int res = av_image_fill_linesizes(_linesize.data(), format, width); res < 0) {
+		throw std::runtime_error(tools::get_error_description(res));
+	}
+	std::array<ptrdiff_t, 4> linesizes;
+	for (size_t idx = 0; idx < _linesize.size(); idx++) {
+		_linesize[idx] = FFALIGN(_linesize[idx], static_cast<int>(plane_alignment));
+		linesizes[idx] = _linesize[idx];
+	}
+
+	std::array<size_t, 4> sizes;
+	if (int res = av_image_fill_plane_sizes(sizes.data(), format, height, linesizes.data()); res < 0) {
+		throw std::runtime_error(tools::get_error_description(res));
+	}
+	for (size_t idx = 0; idx < sizes.size(); idx++) {
+		_offset[idx] = _size;
+		_size += FFALIGN(sizes[idx], plane_alignment);
+	}
+	_size += buffer_padding;
+
+	_pool = create_pool();
+}
+
+frame_pool::~frame_pool()
+{
+	// Buffers still referenced elsewhere keep what is left of the pool alive until they are returned.
+	av_buffer_pool_uninit(&_pool);
+}
+
+AVPixelFormat frame_pool::get_pixel_format() const
+{
+	return _format;
+}
+
+int32_t frame_pool::get_width() const
+{
+	return _width;
+}
+
+int32_t frame_pool::get_height() const
+{
+	return _height;
+}
+
+size_t frame_pool::get_buffer_size() const
+{
+	return _size;
+}
+
+AVBufferPool* frame_pool::create_pool()
+{
+	// The type of the size changed between versions of FFmpeg, which the generic lambda adapts to.
+	AVBufferPool* pool = av_buffer_pool_init2(_size, this, [](void* opaque, auto size) -> AVBufferRef* {
+		auto  self = reinterpret_cast<frame_pool*>(opaque);
+		void* ptr  = allocate_memory(static_cast<size_t>(size));
+		if (!ptr) {
+			return nullptr;
+		}
+
+		AVBufferRef* buffer = av_buffer_create(reinterpret_cast<uint8_t*>(ptr), size, &free_memory, nullptr, 0);
+		if (!buffer) {
+			free_memory(nullptr, reinterpret_cast<uint8_t*>(ptr));
+			return nullptr;
+		}
+		self->_allocated.fetch_add(1, std::memory_order_relaxed);
+		return buffer;
+	}, nullptr);
+	if (!pool) {
+		throw std::bad_alloc();
+	}
+	return pool;
+}
+
+void frame_pool::fill()
+{
+	// Buffers that are free are handed out first, so holding on to them until enough were allocated does the trick.
+	std::vector<AVBufferRef*> buffers;
+	while (_allocated.load(std::memory_order_relaxed) < _reserved) {
+		AVBufferRef* buffer = av_buffer_pool_get(_pool);
+		if (!buffer) {
+			break;
+		}
+		buffers.push_back(buffer);
+	}
+	for (AVBufferRef* buffer : buffers) {
+		av_buffer_unref(&buffer);
+	}
+}
+
+size_t frame_pool::get_allocated() const
+{
+	return _allocated.load(std::memory_order_relaxed);
+}
+
+void frame_pool::reserve(size_t count)
+{
+	std::lock_guard<std::mutex> lg(_reserve_lock);
+	_reserved += count;
+	fill();
+}
+
+void frame_pool::unreserve(size_t count)
+{
+	std::lock_guard<std::mutex> lg(_reserve_lock);
+	_reserved -= std::min(count, _reserved);
+	if (_allocated.load(std::memory_order_relaxed) <= _reserved) {
+		return;
+	}
+
+	// AVBufferPool can't free single buffers, so start over with a new pool. The old one frees its buffers as they return.
+	AVBufferPool* pool = create_pool();
+	{
+		std::unique_lock<std::shared_mutex> ul(_pool_lock);
+		std::swap(_pool, pool);
+		_allocated.store(0, std::memory_order_relaxed);
+	}
+	av_buffer_pool_uninit(&pool);
+	fill();
+}
+
+std::shared_ptr<AVFrame> frame_pool::allocate()
+{
+	auto frame = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* ptr) { av_frame_free(&ptr); });
+	if (!frame) {
+		throw std::bad_alloc();
+	}
+
+	allocate(frame.get());
+	return frame;
+}
+
+void frame_pool::allocate(AVFrame* frame)
+{
+	{
+		std::shared_lock<std::shared_mutex> sl(_pool_lock);
+		frame->buf[0] = av_buffer_pool_get(_pool);
+	}
+	if (!frame->buf[0]) {
+		throw std::bad_alloc();
+	}
+
+	frame->format = _format;
+	frame->width  = _width;
+	frame->height = _height;
+	for (size_t idx = 0; idx < _linesize.size(); idx++) {
+		frame->linesize[idx] = _linesize[idx];
+		frame->data[idx]     = _linesize[idx] ? frame->buf[0]->data + _offset[idx] : nullptr;
+	}
+}
+
+std::shared_ptr<frame_pool> frame_pool::instance(AVPixelFormat format, int32_t width, int32_t height)
+{
+	static std::map<std::tuple<AVPixelFormat, int32_t, int32_t>, std::weak_ptr<frame_pool>> pools;
+	static std::mutex                                                                        mtx;
+
+	std::unique_lock<decltype(mtx)> lock(mtx);
+	auto                            key      = std::make_tuple(format, width, height);
+	auto                            instance = pools[key].lock();
+	if (!instance) {
+		instance   = std::make_shared<frame_pool>(format, width, height);
+		pools[key] = instance;
+	}
+
+	// Forget about pools that nobody uses anymore.
+	for (auto itr = pools.begin(); itr != pools.end();) {
+		if (itr->second.expired()) {
+			itr = pools.erase(itr);
+		} else {
+			itr++;
+		}
+	}
+
+	return instance;
+}
@@ -0,0 +1,99 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "common.hpp"
+
+#include "warning-disable.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include "warning-enable.hpp"
+
+extern "C" {
+#include "warning-disable.hpp"
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include "warning-enable.hpp"
+}
+
+namespace streamfx::ffmpeg {
+	/** Frames of a single pixel format and size, whose buffers are recycled instead of freed.
+	 *
+	 * A buffer returns to the pool once the last reference to it is gone, whether that was held by us or by libavcodec,
+	 * so frames can be handed to an encoder and forgotten about. Buffers of 2 MiB and more are aligned to 2 MiB and, where
+	 * the platform supports it, backed by huge pages to cut down on TLB misses while encoders walk through them.
+	 *
+	 * Pools are shared between everyone asking for the same format and size, see instance().
+	 */
+	class frame_pool {
+		AVPixelFormat _format;
+		int32_t       _width;
+		int32_t       _height;
+
+		// Layout of the planes within each buffer.
+		std::array<int, 4>    _linesize;
+		std::array<size_t, 4> _offset;
+		size_t                _size;
+
+		// Only replaced while trimming, see unreserve().
+		AVBufferPool*       _pool;
+		std::shared_mutex   _pool_lock;
+		std::atomic<size_t> _allocated;
+
+		std::mutex _reserve_lock;
+		size_t     _reserved;
+
+		AVBufferPool* create_pool();
+
+		void fill();
+
+		public:
+		frame_pool(AVPixelFormat format, int32_t width, int32_t height);
+		~frame_pool();
+
+		AVPixelFormat get_pixel_format() const;
+		int32_t       get_width() const;
+		int32_t       get_height() const;
+
+		/** Size of a single buffer in bytes, which holds all planes of a frame.
+		 */
+		size_t get_buffer_size() const;
+
+		/** Number of buffers allocated since the pool was last trimmed, which are only freed by trimming it again or with
+		 * the pool itself.
+		 */
+		size_t get_allocated() const;
+
+		/** Make sure that `count` more buffers than reserved so far are allocated, so that the next bursts of frames do not
+		 * have to wait for allocations. Every user of a shared pool reserves what it needs for itself.
+		 */
+		void reserve(size_t count);
+
+		/** Give back `count` buffers reserved earlier, once they are no longer in use.
+		 *
+		 * If more buffers were allocated than are still reserved, the pool is trimmed: free buffers are released right
+		 * away, and buffers still in use as they are returned. The remaining reservation is allocated again.
+		 */
+		void unreserve(size_t count);
+
+		/** Take a frame with a buffer from the pool, which is writable and not referenced by anything else.
+		 */
+		std::shared_ptr<AVFrame> allocate();
+
+		/** Attach a buffer from the pool to `frame`, which must not hold any buffers yet.
+		 */
+		void allocate(AVFrame* frame);
+
+		public:
+		/** Get the pool for frames of the given format and size, which is created if nobody holds one yet.
+		 */
+		static std::shared_ptr<frame_pool> instance(AVPixelFormat format, int32_t width, int32_t height);
+	};
+} // namespace streamfx::ffmpeg
@@ -0,0 +1,295 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "plane-copy.hpp"
+#include "util/util-parallel.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cstring>
+#if defined(D_PLATFORM_INSTR_X86)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(D_PLATFORM_INSTR_ARM) && defined(D_PLATFORM_64BIT)
+#include <arm_neon.h>
+#endif
+#include "warning-enable.hpp"
+
+extern "C" {
+#include "warning-disable.hpp"
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include "warning-enable.hpp"
+}
+
+// GCC and Clang only emit AVX2 instructions in functions that ask for them, while MSVC emits them anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+using namespace streamfx::ffmpeg;
+
+// Frames smaller than this stay in the cache for the encoder, which reads them right after, so they are copied with
+// regular stores. Larger frames would only push everything else out of the cache, and skip it with non-temporal stores.
+static constexpr size_t non_temporal_threshold = 4 * 1024 * 1024;
+
+// Smallest part of a frame that is worth handing to another thread. A single thread can not saturate the memory bus,
+// but a handful of them can, so anything beyond that only adds overhead.
+static constexpr size_t minimum_band_bytes = 2 * 1024 * 1024;
+
+typedef void (*kernel_t)(uint8_t* target, size_t target_stride, uint8_t const* source, size_t source_stride, size_t width, size_t rows);
+
+static void copy_scalar(uint8_t* target, size_t target_stride, uint8_t const* source, size_t source_stride, size_t width, size_t rows)
+{
+	for (size_t row = 0; row < rows; row++, target += target_stride, source += source_stride) {
+		std::memcpy(target, source, width);
+	}
+}
+
+#if defined(D_PLATFORM_INSTR_X86)
+TARGET_AVX2 static void copy_avx2(uint8_t* target, size_t target_stride, uint8_t const* source, size_t source_stride, size_t width, size_t rows)
+{
+	for (size_t row = 0; row < rows; row++, target += target_stride, source += source_stride) {
+		// Non-temporal stores need an aligned target, the source can be anywhere.
+		size_t x = std::min(width, (32 - (reinterpret_cast<uintptr_t>(target) & 31)) & 31);
+		std::memcpy(target, source, x);
+
+		for (; (x + 128) <= width; x += 128) {
+			__m256i v0 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + x));
+			__m256i v1 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + x + 32));
+			__m256i v2 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + x + 64));
+			__m256i v3 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + x + 96));
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(target + x), v0);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(target + x + 32), v1);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(target + x + 64), v2);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(target + x + 96), v3);
+		}
+		for (; (x + 32) <= width; x += 32) {
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(target + x), _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + x)));
+		}
+
+		std::memcpy(target + x, source + x, width - x);
+	}
+
+	// Non-temporal stores are not ordered with other stores, so make them visible before the frame is handed on.
+	_mm_sfence();
+}
+#endif
+
+#if defined(D_PLATFORM_INSTR_ARM) && defined(D_PLATFORM_64BIT)
+static inline void store_pair(uint8_t* target, uint8x16_t v0, uint8x16_t v1)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__asm__ volatile("stnp %q[v0], %q[v1], [%[target]]" : : [target] "r"(target), [v0] "w"(v0), [v1] "w"(v1) : "memory");
+#else
+	// MSVC has neither inline assembly nor an intrinsic for STNP.
+	vst1q_u8(target, v0);
+	vst1q_u8(target + 16, v1);
+#endif
+}
+
+static void copy_neon(uint8_t* target, size_t target_stride, uint8_t const* source, size_t source_stride, size_t width, size_t rows)
+{
+	for (size_t row = 0; row < rows; row++, target += target_stride, source += source_stride) {
+		size_t x = 0;
+		for (; (x + 64) <= width; x += 64) {
+			uint8x16_t v0 = vld1q_u8(source + x);
+			uint8x16_t v1 = vld1q_u8(source + x + 16);
+			uint8x16_t v2 = vld1q_u8(source + x + 32);
+			uint8x16_t v3 = vld1q_u8(source + x + 48);
+			store_pair(target + x, v0, v1);
+			store_pair(target + x + 32, v2, v3);
+		}
+		for (; (x + 32) <= width; x += 32) {
+			store_pair(target + x, vld1q_u8(source + x), vld1q_u8(source + x + 16));
+		}
+
+		std::memcpy(target + x, source + x, width - x);
+	}
+}
+#endif
+
+static plane_copy::kernel detect_kernel()
+{
+#if defined(D_PLATFORM_INSTR_X86)
+#ifdef _MSC_VER
+	// AVX2 also needs the operating system to save the upper halves of the registers, which XGETBV tells us about.
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7) {
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx     = (info[2] & (1 << 28)) != 0;
+		if (osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6)) {
+			__cpuidex(info, 7, 0);
+			if ((info[1] & (1 << 5)) != 0) {
+				return plane_copy::kernel::avx2;
+			}
+		}
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return plane_copy::kernel::avx2;
+	}
+#endif
+#elif defined(D_PLATFORM_INSTR_ARM) && defined(D_PLATFORM_64BIT)
+	// Every 64-bit ARM CPU has NEON.
+	return plane_copy::kernel::neon;
+#endif
+	return plane_copy::kernel::scalar;
+}
+
+static kernel_t get_kernel_function(plane_copy::kernel value)
+{
+	// Only the best kernel and the scalar one are known to work on this CPU.
+	if (value != plane_copy::get_best_kernel()) {
+		return copy_scalar;
+	}
+
+	switch (value) {
+#if defined(D_PLATFORM_INSTR_X86)
+	case plane_copy::kernel::avx2:
+		return copy_avx2;
+#endif
+#if defined(D_PLATFORM_INSTR_ARM) && defined(D_PLATFORM_64BIT)
+	case plane_copy::kernel::neon:
+		return copy_neon;
+#endif
+	default:
+		return copy_scalar;
+	}
+}
+
+static plane_copy::kernel select_kernel(plane_copy::kernel value, size_t bytes)
+{
+	if (value != plane_copy::kernel::automatic) {
+		return value;
+	}
+	return (bytes >= non_temporal_threshold) ? plane_copy::get_best_kernel() : plane_copy::kernel::scalar;
+}
+
+static void copy_rows(kernel_t fn, uint8_t* target, size_t target_stride, uint8_t const* source, size_t source_stride, size_t width, size_t rows)
+{
+	if ((target_stride == width) && (source_stride == width)) {
+		// Without any padding on either side, the whole plane is a single row.
+		fn(target, target_stride, source, source_stride, width * rows, 1);
+	} else {
+		fn(target, target_stride, source, source_stride, width, rows);
+	}
+}
+
+const char* plane_copy::get_kernel_name(kernel value)
+{
+	switch (value) {
+	case kernel::automatic:
+		return "Automatic";
+	case kernel::scalar:
+		return "Scalar";
+	case kernel::avx2:
+		return "AVX2";
+	case kernel::neon:
+		return "NEON";
+	}
+	return "Unknown";
+}
+
+plane_copy::kernel plane_copy::get_best_kernel()
+{
+	static kernel best = detect_kernel();
+	return best;
+}
+
+void plane_copy::copy_plane(uint8_t* target, size_t target_stride, uint8_t const* source, size_t source_stride, size_t width, size_t rows, kernel implementation)
+{
+	copy_rows(get_kernel_function(select_kernel(implementation, width * rows)), target, target_stride, source, source_stride, width, rows);
+}
+
+void plane_copy::copy(uint8_t* const target[], int const target_stride[], uint8_t const* const source[], int const source_stride[], AVPixelFormat format, int32_t width, int32_t height, options const& opts)
+{
+	struct plane {
+		size_t width;
+		size_t rows;
+		int    shift;
+	};
+
+	AVPixFmtDescriptor const* desc = av_pix_fmt_desc_get(format);
+	if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) || (width <= 0) || (height <= 0)) {
+		throw std::invalid_argument("format");
+	}
+
+	// Only the chroma planes are subsampled, alpha always has the full height.
+	std::array<plane, 4> planes = {};
+	size_t               count  = static_cast<size_t>(std::max(av_pix_fmt_count_planes(format), 0));
+	size_t               bytes  = 0;
+	for (size_t idx = 0; idx < count; idx++) {
+		int linesize = av_image_get_linesize(format, width, static_cast<int>(idx));
+		if (linesize < 0) {
+			throw std::invalid_argument("format");
+		}
+		planes[idx].shift = ((idx == 1) || (idx == 2)) ? desc->log2_chroma_h : 0;
+		planes[idx].width = static_cast<size_t>(linesize);
+		planes[idx].rows  = static_cast<size_t>(AV_CEIL_RSHIFT(height, planes[idx].shift));
+		bytes += planes[idx].width * planes[idx].rows;
+	}
+
+	kernel_t fn = get_kernel_function(select_kernel(opts.implementation, bytes));
+
+	// Split the frame into bands of whole chroma rows.
+	size_t bands = opts.threads;
+	auto   pool  = opts.pool;
+	if (bands == 0) {
+		bands = bytes / minimum_band_bytes;
+		if (bands > 1) {
+			if (!pool) {
+				pool = streamfx::util::threadpool::threadpool::instance();
+			}
+			bands = std::min(bands, pool->concurrency(streamfx::util::threadpool::priority::interactive) + 1);
+		}
+	}
+	size_t alignment = size_t(1) << desc->log2_chroma_h;
+	bands            = std::clamp<size_t>(bands, 1, static_cast<size_t>(height) / alignment);
+
+	if (bands <= 1) {
+		for (size_t idx = 0; idx < count; idx++) {
+			copy_rows(fn, target[idx], static_cast<size_t>(target_stride[idx]), source[idx], static_cast<size_t>(source_stride[idx]), planes[idx].width, planes[idx].rows);
+		}
+		return;
+	}
+
+	size_t band_rows = ((static_cast<size_t>(height) / bands + alignment - 1) / alignment) * alignment;
+
+	streamfx::util::threadpool::parallel_options parallel;
+	parallel.pool    = pool;
+	parallel.threads = bands;
+
+	streamfx::util::threadpool::parallel_for(
+		0, bands,
+		[&](size_t band_begin, size_t band_end) {
+			for (size_t band = band_begin; band < band_end; band++) {
+				size_t row = band * band_rows;
+				for (size_t idx = 0; idx < count; idx++) {
+					size_t begin = std::min(row >> planes[idx].shift, planes[idx].rows);
+					size_t end   = (band == (bands - 1)) ? planes[idx].rows : std::min((row + band_rows) >> planes[idx].shift, planes[idx].rows);
+					if (begin >= end) {
+						continue;
+					}
+
+					size_t tstride = static_cast<size_t>(target_stride[idx]);
+					size_t sstride = static_cast<size_t>(source_stride[idx]);
+					copy_rows(fn, target[idx] + begin * tstride, tstride, source[idx] + begin * sstride, sstride, planes[idx].width, end - begin);
+				}
+			}
+		},
+		parallel);
+}
+
+void plane_copy::copy(AVFrame* target, uint8_t const* const source[], int const source_stride[], options const& opts)
+{
+	copy(target->data, target->linesize, source, source_stride, static_cast<AVPixelFormat>(target->format), target->width, target->height, opts);
+}
@@ -0,0 +1,68 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "common.hpp"
+
+#include "warning-disable.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "warning-enable.hpp"
+
+extern "C" {
+#include "warning-disable.hpp"
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include "warning-enable.hpp"
+}
+
+namespace streamfx::ffmpeg::plane_copy {
+	enum class kernel {
+		/// Pick the fastest kernel the CPU supports.
+		automatic,
+		/// Plain memcpy for every row, available everywhere.
+		scalar,
+		/// 32 bytes at a time with non-temporal stores, on x86 CPUs that support AVX2.
+		avx2,
+		/// 32 bytes at a time with non-temporal stores where possible, on 64-bit ARM CPUs.
+		neon,
+	};
+
+	const char* get_kernel_name(kernel value);
+
+	/** The fastest kernel that the CPU supports, detected once at runtime.
+	 */
+	kernel get_best_kernel();
+
+	struct options {
+		/// Kernel to copy rows with. Kernels the CPU does not support fall back to the scalar one.
+		kernel implementation = kernel::automatic;
+
+		/// Maximum number of threads to copy a frame with, including the caller. 0 picks a number based on the size of the
+		/// frame, small frames are always copied on the calling thread.
+		size_t threads = 0;
+
+		/// Pool to run on, defaults to the global instance.
+		std::shared_ptr<streamfx::util::threadpool::threadpool> pool = nullptr;
+	};
+
+	/** Copy `rows` rows of `width` bytes from one plane to another, with any stride on either side.
+	 *
+	 * Bytes between the end of a row and the start of the next one are left untouched in the target.
+	 */
+	void copy_plane(uint8_t* target, size_t target_stride, uint8_t const* source, size_t source_stride, size_t width, size_t rows, kernel implementation = kernel::automatic);
+
+	/** Copy all planes of an image of the given format, size and strides.
+	 *
+	 * The width and number of rows of each plane are taken from the pixel format, which covers packed, semi-planar
+	 * and planar formats of any bit depth, such as NV12, P010 and YUV420P10. Frames larger than a few megabytes are
+	 * split into horizontal bands that are copied in parallel on the threadpool.
+	 */
+	void copy(uint8_t* const target[], int const target_stride[], uint8_t const* const source[], int const source_stride[], AVPixelFormat format, int32_t width, int32_t height, options const& opts = {});
+
+	/** Copy all planes of an image into a frame, which already has the size and format of the image.
+	 */
+	void copy(AVFrame* target, uint8_t const* const source[], int const source_stride[], options const& opts = {});
+} // namespace streamfx::ffmpeg::plane_copy
@@ -4,13 +4,47 @@
 // AUTOGENERATED COPYRIGHT HEADER END
 
 #include "swscale.hpp"
+#include "util/util-parallel.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
 #include <stdexcept>
 #include "warning-enable.hpp"
 
+extern "C" {
+#include "warning-disable.hpp"
+#include <libavutil/pixdesc.h>
+#include "warning-enable.hpp"
+}
+
 using namespace streamfx::ffmpeg;
 
+// Rows per band below which splitting up costs more than it gains.
+constexpr int32_t minimum_band_rows = 128;
+
+static bool can_split(AVPixelFormat format)
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+	return desc && ((desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL)) == 0);
+}
+
+template<typename _type>
+static void offset_planes(AVPixelFormat format, _type* const data[], const int stride[], int32_t row, _type* output[4])
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+	for (size_t plane = 0; plane < 4; plane++) {
+		if (!data[plane]) {
+			output[plane] = nullptr;
+			continue;
+		}
+
+		// Only the chroma planes are subsampled, luma and alpha are not.
+		int32_t plane_row = ((plane == 1) || (plane == 2)) ? (row >> desc->log2_chroma_h) : row;
+		output[plane]     = data[plane] + static_cast<ptrdiff_t>(plane_row) * stride[plane];
+	}
+}
+
 swscale::swscale() = default;
 
 swscale::~swscale()
@@ -144,6 +178,16 @@ bool swscale::is_target_full_range()
 	return this->target_full_range;
 }
 
+void swscale::set_threads(size_t threads)
+{
+	this->threads = threads;
+}
+
+size_t swscale::get_threads()
+{
+	return this->threads;
+}
+
 bool swscale::initialize(int flags)
 {
 	if (this->context) {
@@ -163,11 +207,52 @@ bool swscale::initialize(int flags)
 
 	sws_setColorspaceDetails(this->context, sws_getCoefficients(source_colorspace), source_full_range ? 1 : 0, sws_getCoefficients(target_colorspace), target_full_range ? 1 : 0, 1L << 16 | 0L, 1L << 16 | 0L, 1L << 16 | 0L);
 
+	// Split the frame into bands, if it is large enough to be worth it.
+	if ((source_size == target_size) && can_split(source_format) && can_split(target_format)) {
+		int32_t width  = static_cast<int32_t>(source_size.first);
+		int32_t height = static_cast<int32_t>(source_size.second);
+
+		// Keep the pool alive for as long as we are, instead of looking it up for every frame.
+		this->pool = streamfx::util::threadpool::threadpool::instance();
+
+		size_t count = this->threads;
+		if (count == 0) {
+			count = std::min<size_t>(this->pool->concurrency(streamfx::util::threadpool::priority::interactive) + 1, static_cast<size_t>(height / minimum_band_rows));
+		}
+
+		// Bands must start on a row that exists in every plane, so they have to be aligned to the chroma subsampling.
+		int32_t alignment = 1 << std::max(av_pix_fmt_desc_get(source_format)->log2_chroma_h, av_pix_fmt_desc_get(target_format)->log2_chroma_h);
+		count             = std::min<size_t>(count, static_cast<size_t>(height / alignment));
+
+		if (count > 1) {
+			int32_t rows = static_cast<int32_t>((static_cast<size_t>(height) + count - 1) / count);
+			rows         = ((rows + alignment - 1) / alignment) * alignment;
+			for (int32_t row = 0; row < height; row += rows) {
+				band entry = {nullptr, row, std::min(rows, height - row)};
+				entry.context = sws_getContext(width, entry.rows, source_format, width, entry.rows, target_format, flags, nullptr, nullptr, nullptr);
+				if (!entry.context) {
+					finalize();
+					return false;
+				}
+				sws_setColorspaceDetails(entry.context, sws_getCoefficients(source_colorspace), source_full_range ? 1 : 0, sws_getCoefficients(target_colorspace), target_full_range ? 1 : 0, 1L << 16 | 0L, 1L << 16 | 0L, 1L << 16 | 0L);
+				this->bands.push_back(entry);
+			}
+		} else {
+			this->pool.reset();
+		}
+	}
+
 	return true;
 }
 
 bool swscale::finalize()
 {
+	for (auto& entry : this->bands) {
+		sws_freeContext(entry.context);
+	}
+	this->bands.clear();
+	this->pool.reset();
+
 	if (this->context) {
 		sws_freeContext(this->context);
 		this->context = nullptr;
@@ -181,6 +266,40 @@ int32_t swscale::convert(const uint8_t* const source_data[], const int source_st
 	if (!this->context) {
 		return 0;
 	}
-	int height = sws_scale(this->context, source_data, source_stride, source_row, source_rows, target_data, target_stride);
-	return height;
+
+	if (this->bands.empty() || (source_row != 0) || (source_rows != static_cast<int32_t>(source_size.second))) {
+		int height = sws_scale(this->context, source_data, source_stride, source_row, source_rows, target_data, target_stride);
+		return height;
+	}
+
+	streamfx::util::threadpool::parallel_options options;
+	options.pool    = this->pool;
+	options.threads = this->bands.size();
+
+	std::atomic<int32_t> height{0};
+	std::atomic<int32_t> error{0};
+	streamfx::util::threadpool::parallel_for(
+		0, this->bands.size(),
+		[&](size_t begin, size_t end) {
+			for (size_t idx = begin; idx < end; idx++) {
+				auto&          entry = this->bands[idx];
+				const uint8_t* source[4];
+				uint8_t*       target[4];
+				offset_planes(source_format, source_data, source_stride, entry.row, source);
+				offset_planes(target_format, target_data, target_stride, entry.row, target);
+
+				int res = sws_scale(entry.context, source, source_stride, 0, entry.rows, target, target_stride);
+				if (res < 0) {
+					error.store(res, std::memory_order_relaxed);
+				} else {
+					height.fetch_add(res, std::memory_order_relaxed);
+				}
+			}
+		},
+		options);
+
+	if (int32_t res = error.load(std::memory_order_relaxed); res < 0) {
+		return res;
+	}
+	return height.load(std::memory_order_relaxed);
 }
@@ -6,7 +6,9 @@
 #include "common.hpp"
 
 #include "warning-disable.hpp"
+#include <memory>
 #include <utility>
+#include <vector>
 #include "warning-enable.hpp"
 
 extern "C" {
@@ -30,6 +32,16 @@ namespace streamfx::ffmpeg {
 
 		SwsContext* context = nullptr;
 
+		// Horizontal bands of the frame that are converted in parallel, each with a context of its own.
+		struct band {
+			SwsContext* context;
+			int32_t     row;
+			int32_t     rows;
+		};
+		size_t                                                  threads = 1;
+		std::vector<band>                                       bands;
+		std::shared_ptr<streamfx::util::threadpool::threadpool> pool;
+
 		public:
 		swscale();
 		~swscale();
@@ -60,9 +72,24 @@ namespace streamfx::ffmpeg {
 		void                          set_target_full_range(bool full_range);
 		bool                          is_target_full_range();
 
+		/** Set the number of bands to split a frame into, which are converted in parallel on the threadpool.
+		 *
+		 * 0 picks a number based on the size of the frame and the threadpool. Only takes effect on the next initialize(),
+		 * and only if source and target have the same size, as bands are converted independently of each other. Chroma
+		 * that is resampled vertically may differ slightly from a single pass within a few rows of each band edge.
+		 */
+		void   set_threads(size_t threads);
+		size_t get_threads();
+
 		bool initialize(int flags);
 		bool finalize();
 
+		/** Convert rows of the source into the target.
+		 *
+		 * Converting a whole frame at once uses the bands set up by initialize(), anything else runs on the calling thread.
+		 *
+		 * @return Number of rows written to the target, or a negative error code.
+		 */
 		int32_t convert(const uint8_t* const source_data[], const int source_stride[], int32_t source_row, int32_t source_rows, uint8_t* const target_data[], const int target_stride[]);
 	};
 } // namespace streamfx::ffmpeg
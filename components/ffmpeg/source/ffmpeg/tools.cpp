@@ -4,9 +4,11 @@
 // AUTOGENERATED COPYRIGHT HEADER END
 
 #include "tools.hpp"
+#include "plane-copy.hpp"
 #include "plugin.hpp"
 
 #include "warning-disable.hpp"
+#include <cstring>
 #include <list>
 #include <sstream>
 #include "warning-enable.hpp"
@@ -14,7 +16,10 @@
 extern "C" {
 #include "warning-disable.hpp"
 #include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/common.h>
 #include <libavutil/error.h>
+#include <libavutil/frame.h>
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
 #include "warning-enable.hpp"
@@ -461,3 +466,58 @@ void tools::print_av_option_string2(AVCodecContext* ctx_codec, void* ctx_option,
 		}
 	}
 }
+
+void tools::copy_frame_data(encoder_frame* frame, AVFrame* vframe)
+{
+	plane_copy::copy(vframe, frame->data, reinterpret_cast<int const*>(frame->linesize));
+}
+
+AVFrame* tools::wrap_frame_data(encoder_frame* frame, AVPixelFormat format, int32_t width, int32_t height, void (*release)(void* opaque, uint8_t* data), void* opaque)
+{
+	// Same alignment that frames allocated for the encoder have, which SIMD code in encoders may rely on.
+	constexpr size_t alignment = 32;
+
+	int planes = av_pix_fmt_count_planes(format);
+	if ((planes <= 0) || (planes > MAX_AV_PLANES)) {
+		return nullptr;
+	}
+	for (int idx = 0; idx < planes; idx++) {
+		if (!frame->data[idx] || ((reinterpret_cast<uintptr_t>(frame->data[idx]) % alignment) != 0) || ((frame->linesize[idx] % alignment) != 0)) {
+			return nullptr;
+		}
+	}
+
+	int h_chroma_shift, v_chroma_shift;
+	av_pix_fmt_get_chroma_sub_sample(format, &h_chroma_shift, &v_chroma_shift);
+
+	AVFrame* vframe = av_frame_alloc();
+	if (!vframe) {
+		return nullptr;
+	}
+	vframe->format = format;
+	vframe->width  = width;
+	vframe->height = height;
+
+	for (int idx = 0; idx < planes; idx++) {
+		// Chroma planes of odd heights have a row for the last luma row too.
+		size_t plane_height = static_cast<size_t>(AV_CEIL_RSHIFT(height, ((idx == 1) || (idx == 2)) ? v_chroma_shift : 0));
+		size_t size         = static_cast<size_t>(frame->linesize[idx]) * plane_height;
+
+		// Read-only, so that anything wanting to write to the frame makes a copy instead of touching memory owned by OBS.
+		vframe->buf[idx] = av_buffer_create(frame->data[idx], size, release, opaque, AV_BUFFER_FLAG_READONLY);
+		if (!vframe->buf[idx]) {
+			// Planes that were already wrapped are released right here.
+			av_frame_free(&vframe);
+			return nullptr;
+		}
+		vframe->data[idx]     = frame->data[idx];
+		vframe->linesize[idx] = static_cast<int>(frame->linesize[idx]);
+	}
+
+	return vframe;
+}
+
+bool tools::encoder_keeps_frames(const AVCodecContext* context)
+{
+	return ((context->codec->capabilities & AV_CODEC_CAP_DELAY) != 0) || ((context->active_thread_type & FF_THREAD_FRAME) != 0);
+}
@@ -63,4 +63,27 @@ namespace streamfx::ffmpeg::tools {
 
 	void avoption_list_add_entries(const void* obj, std::string_view unit, std::function<void(const AVOption*)> inserter = nullptr);
 
+	/** Copy the planes of a frame from OBS into a frame allocated for the encoder, which may use a different stride.
+	 *
+	 * Only the bytes of each row that hold pixels are copied, see plane_copy::copy() for how.
+	 */
+	void copy_frame_data(encoder_frame* frame, AVFrame* vframe);
+
+	/** Wrap the planes of a frame from OBS in a frame for the encoder, without copying them.
+	 *
+	 * The planes are still owned by OBS and are only valid during the encode call, so `release(opaque, data)` is called
+	 * for every plane once nothing references it anymore, and the caller has to wait for that before returning to OBS.
+	 *
+	 * @return A frame owned by the caller, or nullptr if the planes can't be wrapped, for example because they are not
+	 *         aligned well enough for the encoder. They have to be copied instead then.
+	 */
+	AVFrame* wrap_frame_data(encoder_frame* frame, AVPixelFormat format, int32_t width, int32_t height, void (*release)(void* opaque, uint8_t* data), void* opaque);
+
+	/** Check if an opened encoder may still reference a frame after it returned the packet for it.
+	 *
+	 * This is the case for encoders that delay output, like those with lookahead or B-frames, and for encoders that
+	 * use frame threading.
+	 */
+	bool encoder_keeps_frames(const AVCodecContext* context);
+
 } // namespace streamfx::ffmpeg::tools
@@ -85,7 +85,7 @@ mirror_audio_data::mirror_audio_data(const audio_data* audio, speaker_layout lay
 	}
 }
 
-mirror_instance::mirror_instance(obs_data_t* settings, obs_source_t* self) : obs::source_instance(settings, self), _source(), _source_child(), _signal_rename(), _audio_enabled(false), _audio_layout(SPEAKERS_UNKNOWN)
+mirror_instance::mirror_instance(obs_data_t* settings, obs_source_t* self) : obs::source_instance(settings, self), _source(), _source_child(), _signal_rename(), _audio_enabled(false), _audio_layout(SPEAKERS_UNKNOWN), _audio_queue_lock(), _audio_queue(), _audio_pool(streamfx::util::threadpool::threadpool::instance()), _audio_tag(_audio_pool->tag("mirror::audio"))
 {
 	update(settings);
 }
@@ -259,7 +259,7 @@ void mirror_instance::on_audio(::streamfx::obs::source, const audio_data* audio,
 	}
 
 	// Create a clone of the audio data and push it to the thread pool.
-	streamfx::util::threadpool::threadpool::instance()->push(std::bind(&mirror_instance::audio_output, this, std::placeholders::_1), nullptr);
+	_audio_pool->dispatch([this]() { audio_output(nullptr); }, streamfx::util::threadpool::priority::realtime, _audio_tag);
 }
 
 void mirror_instance::audio_output(std::shared_ptr<void> data)
@@ -326,21 +326,21 @@ obs_properties_t* mirror_factory::get_properties2(mirror_instance* data)
 
 		obs_property_list_add_string(p, "", "");
 		obs::source_tracker::instance()->enumerate(
-			[&p](std::string name, ::streamfx::obs::source) {
+			obs::source_tracker::category::SOURCE,
+			[&p](obs::source_tracker::entry const& entry) {
 				std::stringstream sstr;
-				sstr << name << " (" << D_TRANSLATE(S_SOURCETYPE_SOURCE) << ")";
-				obs_property_list_add_string(p, sstr.str().c_str(), name.c_str());
+				sstr << entry.name << " (" << D_TRANSLATE(S_SOURCETYPE_SOURCE) << ")";
+				obs_property_list_add_string(p, sstr.str().c_str(), entry.name.c_str());
 				return false;
-			},
-			obs::source_tracker::filter_sources);
+			});
 		obs::source_tracker::instance()->enumerate(
-			[&p](std::string name, ::streamfx::obs::source) {
+			obs::source_tracker::category::SCENE,
+			[&p](obs::source_tracker::entry const& entry) {
 				std::stringstream sstr;
-				sstr << name << " (" << D_TRANSLATE(S_SOURCETYPE_SCENE) << ")";
-				obs_property_list_add_string(p, sstr.str().c_str(), name.c_str());
+				sstr << entry.name << " (" << D_TRANSLATE(S_SOURCETYPE_SCENE) << ")";
+				obs_property_list_add_string(p, sstr.str().c_str(), entry.name.c_str());
 				return false;
-			},
-			obs::source_tracker::filter_scenes);
+			});
 	}
 
 	{
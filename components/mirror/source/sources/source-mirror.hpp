@@ -38,10 +38,12 @@ namespace streamfx::source::mirror {
 		std::pair<uint32_t, uint32_t>                         _source_size;
 
 		// Audio
-		bool                          _audio_enabled;
-		speaker_layout                _audio_layout;
-		std::mutex                    _audio_queue_lock;
-		std::queue<mirror_audio_data> _audio_queue;
+		bool                                                    _audio_enabled;
+		speaker_layout                                          _audio_layout;
+		std::mutex                                              _audio_queue_lock;
+		std::queue<mirror_audio_data>                           _audio_queue;
+		std::shared_ptr<streamfx::util::threadpool::threadpool> _audio_pool;
+		streamfx::util::threadpool::task_tag*                   _audio_tag;
 
 		public:
 		mirror_instance(obs_data_t* settings, obs_source_t* self);
@@ -102,7 +102,7 @@ using namespace streamfx::filter::sdf_effects;
 
 static constexpr std::string_view HELP_URL = "https://github.com/Xaymar/obs-StreamFX/wiki/Filter-SDF-Effects";
 
-sdf_effects_instance::sdf_effects_instance(obs_data_t* settings, obs_source_t* self) : obs::source_instance(settings, self), _gfx_util(::streamfx::gfx::util::get()), _source_rendered(false), _sdf_scale(1.0), _sdf_threshold(), _output_rendered(false), _inner_shadow(false), _inner_shadow_color(), _inner_shadow_range_min(), _inner_shadow_range_max(), _inner_shadow_offset_x(), _inner_shadow_offset_y(), _outer_shadow(false), _outer_shadow_color(), _outer_shadow_range_min(), _outer_shadow_range_max(), _outer_shadow_offset_x(), _outer_shadow_offset_y(), _inner_glow(false), _inner_glow_color(), _inner_glow_width(), _inner_glow_sharpness(), _inner_glow_sharpness_inv(), _outer_glow(false), _outer_glow_color(), _outer_glow_width(), _outer_glow_sharpness(), _outer_glow_sharpness_inv(), _outline(false), _outline_color(), _outline_width(), _outline_offset(), _outline_sharpness(), _outline_sharpness_inv()
+sdf_effects_instance::sdf_effects_instance(obs_data_t* settings, obs_source_t* self) : obs::source_instance(settings, self), _gfx_util(::streamfx::gfx::util::get()), _source_rendered(false), _sdf_scale(1.0), _sdf_threshold(), _output_rendered(false), _inner_shadow(false), _inner_shadow_color(), _inner_shadow_range_min(), _inner_shadow_range_max(), _inner_shadow_offset_x(), _inner_shadow_offset_y(), _outer_shadow(false), _outer_shadow_color(), _outer_shadow_range_min(), _outer_shadow_range_max(), _outer_shadow_offset_x(), _outer_shadow_offset_y(), _inner_glow(false), _inner_glow_color(), _inner_glow_width(), _inner_glow_sharpness(), _inner_glow_sharpness_inv(), _outer_glow(false), _outer_glow_color(), _outer_glow_width(), _outer_glow_sharpness(), _outer_glow_sharpness_inv(), _outline(false), _outline_color(), _outline_width(), _outline_offset(), _outline_sharpness(), _outline_sharpness_inv(), _budget(streamfx::gfx::render_budget::instance()->add_client(obs_source_get_name(self), 3))
 {
 	{
 		auto gctx        = streamfx::obs::gs::context();
@@ -299,6 +299,7 @@ void sdf_effects_instance::video_render(gs_effect_t* effect)
 #if defined(ENABLE_PROFILING) && !defined(D_PLATFORM_MAC) && _DEBUG
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "SDF Effects '%s' on '%s'", obs_source_get_name(_self), obs_source_get_name(obs_filter_get_parent(_self))};
 #endif
+	auto budget = _budget->measure();
 
 	auto gctx              = streamfx::obs::gs::context();
 	vec4 color_transparent = {0, 0, 0, 0};
@@ -351,10 +352,10 @@ void sdf_effects_instance::video_render(gs_effect_t* effect)
 					throw std::runtime_error("SDF Effect no loaded");
 				}
 
-				// Scale SDF Size
+				// Scale SDF Size, and compute it at a lower resolution when over budget.
 				double_t sdfW, sdfH;
-				sdfW = baseW * _sdf_scale;
-				sdfH = baseH * _sdf_scale;
+				sdfW = baseW * _sdf_scale / (1.0 + _budget->quality());
+				sdfH = baseH * _sdf_scale / (1.0 + _budget->quality());
 				if (sdfW <= 1) {
 					sdfW = 1.0;
 				}
@@ -4,6 +4,7 @@
 
 #pragma once
 #include "common.hpp"
+#include "gfx/gfx-render-budget.hpp"
 #include "gfx/gfx-util.hpp"
 #include "obs/gs/gs-effect.hpp"
 #include "obs/gs/gs-texrender.hpp"
@@ -68,6 +69,9 @@ namespace streamfx::filter::sdf_effects {
 		float _outline_sharpness;
 		float _outline_sharpness_inv;
 
+		// Render Budget
+		std::shared_ptr<streamfx::gfx::render_budget::client> _budget;
+
 		public:
 		sdf_effects_instance(obs_data_t* settings, obs_source_t* self);
 		virtual ~sdf_effects_instance();
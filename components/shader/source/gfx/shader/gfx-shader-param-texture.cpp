@@ -14,8 +14,10 @@
 
 #include "warning-disable.hpp"
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 #include "warning-enable.hpp"
 
 // TODO:
@@ -44,6 +46,41 @@ static constexpr std::string_view _annotation_default         = "default";
 static constexpr std::string_view _annotation_enum_entry      = "enum_%zu";
 static constexpr std::string_view _annotation_enum_entry_name = "enum_%zu_name";
 
+// Display name and value of each source that can be picked. A shader may have many texture parameters, and the properties
+// are rebuilt often, so the list is only rebuilt once the tracked sources change.
+static std::shared_ptr<const std::vector<std::pair<std::string, std::string>>> get_source_list()
+{
+	static std::mutex                                                              lock;
+	static uint64_t                                                                generation = 0;
+	static std::shared_ptr<const std::vector<std::pair<std::string, std::string>>> list;
+
+	auto                        tracker = streamfx::obs::source_tracker::instance();
+	std::lock_guard<std::mutex> lg(lock);
+	if (list && (generation == tracker->generation())) {
+		return list;
+	}
+
+	// Read before enumerating, so that a change during enumeration causes another rebuild next time.
+	generation = tracker->generation();
+
+	auto items = std::make_shared<std::vector<std::pair<std::string, std::string>>>();
+	tracker->enumerate(streamfx::obs::source_tracker::category::VIDEO_SOURCE, [&items](streamfx::obs::source_tracker::entry const& entry) {
+		std::stringstream sstr;
+		sstr << entry.name << " (" << D_TRANSLATE(S_SOURCETYPE_SOURCE) << ")";
+		items->emplace_back(sstr.str(), entry.name);
+		return false;
+	});
+	tracker->enumerate(streamfx::obs::source_tracker::category::SCENE, [&items](streamfx::obs::source_tracker::entry const& entry) {
+		std::stringstream sstr;
+		sstr << entry.name << " (" << D_TRANSLATE(S_SOURCETYPE_SCENE) << ")";
+		items->emplace_back(sstr.str(), entry.name);
+		return false;
+	});
+
+	list = items;
+	return list;
+}
+
 streamfx::gfx::shader::texture_field_type streamfx::gfx::shader::get_texture_field_type_from_string(std::string_view v)
 {
 	std::map<std::string, texture_field_type> matches = {
@@ -188,22 +225,9 @@ void streamfx::gfx::shader::texture_parameter::properties(obs_properties_t* prop
 		{
 			auto p = obs_properties_add_list(pr, _keys[2].c_str(), D_TRANSLATE(ST_I18N_SOURCE), OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 			obs_property_list_add_string(p, "", "");
-			obs::source_tracker::instance()->enumerate(
-				[&p](std::string name, ::streamfx::obs::source) {
-					std::stringstream sstr;
-					sstr << name << " (" << D_TRANSLATE(S_SOURCETYPE_SOURCE) << ")";
-					obs_property_list_add_string(p, sstr.str().c_str(), name.c_str());
-					return false;
-				},
-				obs::source_tracker::filter_video_sources);
-			obs::source_tracker::instance()->enumerate(
-				[&p](std::string name, ::streamfx::obs::source) {
-					std::stringstream sstr;
-					sstr << name << " (" << D_TRANSLATE(S_SOURCETYPE_SCENE) << ")";
-					obs_property_list_add_string(p, sstr.str().c_str(), name.c_str());
-					return false;
-				},
-				obs::source_tracker::filter_scenes);
+			for (auto const& kv : *get_source_list()) {
+				obs_property_list_add_string(p, kv.first.c_str(), kv.second.c_str());
+			}
 		}
 
 		modified_type(this, props, nullptr, settings);
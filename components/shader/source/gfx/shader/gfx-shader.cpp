@@ -38,7 +38,9 @@
 streamfx::gfx::shader::shader::shader(obs_source_t* self, shader_mode mode)
 	: _self(self), _gfx_util(::streamfx::gfx::util::get()), _mode(mode), _base_width(1), _base_height(1), _active(true),
 
-	  _shader(), _shader_file(), _shader_tech("Draw"), _shader_file_mt(), _shader_file_sz(), _shader_file_tick(0),
+	  _shader(), _shader_file(), _shader_tech("Draw"), _shader_file_mt(), _shader_file_sz(),
+
+	  _shader_file_lock(), _shader_file_changed(false), _shader_file_timer(),
 
 	  _width_type(size_type::Percent), _width_value(1.0), _height_type(size_type::Percent), _height_value(1.0),
 
@@ -51,9 +53,17 @@ streamfx::gfx::shader::shader::shader(obs_source_t* self, shader_mode mode)
 	for (size_t idx = 0; idx < 16; idx++) {
 		_random_values[idx] = static_cast<float>(static_cast<double_t>(_random()) / static_cast<double_t>(_random.max()));
 	}
+
+	// Check for changes to the shader file off the graphics thread.
+	_shader_file_timer = streamfx::util::threadpool::threadpool::instance()->schedule_every(std::chrono::milliseconds(333), [this]() { watch_shader_file(); });
 }
 
-streamfx::gfx::shader::shader::~shader() = default;
+streamfx::gfx::shader::shader::~shader()
+{
+	if (_shader_file_timer) {
+		_shader_file_timer->cancel();
+	}
+}
 
 bool streamfx::gfx::shader::shader::is_shader_different(const std::filesystem::path& file)
 {
@@ -101,11 +111,13 @@ bool streamfx::gfx::shader::shader::load_shader(const std::filesystem::path& fil
 
 		// Update Shader
 		if (shader_dirty) {
-			_shader           = streamfx::obs::gs::effect(file);
-			_shader_file_mt   = std::filesystem::last_write_time(file);
-			_shader_file_sz   = std::filesystem::file_size(file);
-			_shader_file      = file;
-			_shader_file_tick = 0;
+			_shader = streamfx::obs::gs::effect(file);
+
+			std::lock_guard<std::mutex> lg(_shader_file_lock);
+			_shader_file_mt      = std::filesystem::last_write_time(file);
+			_shader_file_sz      = std::filesystem::file_size(file);
+			_shader_file         = file;
+			_shader_file_changed = false;
 		}
 
 		// Update Params
@@ -170,6 +182,30 @@ bool streamfx::gfx::shader::shader::load_shader(const std::filesystem::path& fil
 	}
 }
 
+void streamfx::gfx::shader::shader::watch_shader_file()
+{
+	std::filesystem::path           file;
+	std::filesystem::file_time_type file_mt;
+	uintmax_t                       file_sz;
+	{
+		std::lock_guard<std::mutex> lg(_shader_file_lock);
+		file    = _shader_file;
+		file_mt = _shader_file_mt;
+		file_sz = _shader_file_sz;
+	}
+
+	try {
+		if (file.empty() || !std::filesystem::exists(file))
+			return;
+
+		// The graphics thread reloads the shader on the next tick.
+		if ((std::filesystem::last_write_time(file) != file_mt) || (std::filesystem::file_size(file) != file_sz))
+			_shader_file_changed = true;
+	} catch (...) {
+		// The file may be in the middle of being written, try again next time.
+	}
+}
+
 void streamfx::gfx::shader::shader::defaults(obs_data_t* data)
 {
 	obs_data_set_default_string(data, ST_KEY_SHADER_FILE, "");
@@ -401,9 +437,7 @@ uint32_t streamfx::gfx::shader::shader::base_height()
 
 bool streamfx::gfx::shader::shader::tick(float time)
 {
-	_shader_file_tick = static_cast<float>(static_cast<double_t>(_shader_file_tick) + static_cast<double_t>(time));
-	if (_shader_file_tick >= 1.0f / 3.0f) {
-		_shader_file_tick -= 1.0f / 3.0f;
+	if (_shader_file_changed.exchange(false)) {
 		bool v1, v2;
 		load_shader(_shader_file, _shader_tech, v1, v2);
 	}
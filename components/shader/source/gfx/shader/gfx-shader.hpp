@@ -12,9 +12,11 @@
 #include "obs/gs/gs-texrender.hpp"
 
 #include "warning-disable.hpp"
+#include <atomic>
 #include <filesystem>
 #include <list>
 #include <map>
+#include <mutex>
 #include <random>
 #include "warning-enable.hpp"
 
@@ -51,9 +53,13 @@ namespace streamfx::gfx {
 			std::string                     _shader_tech;
 			std::filesystem::file_time_type _shader_file_mt;
 			uintmax_t                       _shader_file_sz;
-			float                         _shader_file_tick;
 			shader_param_map_t              _shader_params;
 
+			// File Watcher
+			std::mutex                                         _shader_file_lock;
+			std::atomic<bool>                                  _shader_file_changed;
+			std::shared_ptr<streamfx::util::threadpool::timer> _shader_file_timer;
+
 			// Options
 			size_type _width_type;
 			double_t  _width_value;
@@ -127,6 +133,9 @@ namespace streamfx::gfx {
 			void set_visible(bool visible);
 
 			void set_active(bool active);
+
+			private:
+			void watch_shader_file();
 		};
 	} // namespace shader
 } // namespace streamfx::gfx
@@ -39,6 +39,7 @@
 #include "version.hpp"
 #include "util/util-bitmask.hpp"
 #include "util/util-library.hpp"
+#include "util/util-logging.hpp"
 #include "util/util-profiler.hpp"
 #include "util/util-threadpool.hpp"
 #include "util/utility.hpp"
@@ -72,11 +73,15 @@ extern "C" {
 
 // Common Global defines
 /// Logging
-#define DLOG_(level, ...) blog(level, "[" S_PLUGIN_NAME "] " __VA_ARGS__)
-#define DLOG_ERROR(...) DLOG_(LOG_ERROR, __VA_ARGS__)
-#define DLOG_WARNING(...) DLOG_(LOG_WARNING, __VA_ARGS__)
-#define DLOG_INFO(...) DLOG_(LOG_INFO, __VA_ARGS__)
-#define DLOG_DEBUG(...) DLOG_(LOG_DEBUG, __VA_ARGS__)
+#define DLOG_(level, ...)                                             \
+	{                                                                 \
+		static streamfx::util::logging::site _dlog_site;              \
+		streamfx::util::logging::log(_dlog_site, level, __VA_ARGS__); \
+	}
+#define DLOG_ERROR(...) DLOG_(streamfx::util::logging::level::LEVEL_ERROR, __VA_ARGS__)
+#define DLOG_WARNING(...) DLOG_(streamfx::util::logging::level::LEVEL_WARN, __VA_ARGS__)
+#define DLOG_INFO(...) DLOG_(streamfx::util::logging::level::LEVEL_INFO, __VA_ARGS__)
+#define DLOG_DEBUG(...) DLOG_(streamfx::util::logging::level::LEVEL_DEBUG, __VA_ARGS__)
 /// Currrent function name (as const char*)
 #ifdef _MSC_VER
 // Microsoft Visual Studio
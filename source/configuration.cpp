@@ -27,14 +27,20 @@ constexpr std::string_view path_backup_ext  = ".bk";
 streamfx::configuration::~configuration()
 {
 	try {
-		save();
-		_save_task->wait();
+		// Write any pending changes right away, instead of waiting for the timer.
+		{
+			std::lock_guard<std::mutex> lg(_task_lock);
+			if (_save_timer) {
+				_save_timer->cancel();
+			}
+		}
+		write();
 	} catch (std::exception const& ex) {
 		DLOG_ERROR("Failed to save configuration: %s", ex.what());
 	}
 }
 
-streamfx::configuration::configuration() : _config_path(), _data(), _task_lock(), _save_task()
+streamfx::configuration::configuration() : _config_path(), _data(), _task_lock(), _save_timer(), _write_lock()
 {
 	// Retrieve global configuration path.
 	_config_path = streamfx::config_file_path("config.json");
@@ -58,21 +64,24 @@ streamfx::configuration::configuration() : _config_path(), _data(), _task_lock()
 void streamfx::configuration::save()
 {
 	std::lock_guard<std::mutex> lg(_task_lock);
-	if (!_save_task || _save_task->is_completed()) {
-		_save_task = streamfx::util::threadpool::threadpool::instance()->push([this](streamfx::util::threadpool::task_data_t) {
-			// ToDo: Implement delayed tasks in ::threadpool.
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	if (!_save_timer || !_save_timer->is_pending()) {
+		// Delay the write a little, so that a burst of changes only hits the disk once.
+		_save_timer = streamfx::util::threadpool::threadpool::instance()->schedule_after(std::chrono::milliseconds(100), [this]() { write(); });
+	}
+}
 
-			// Update version tag.
-			obs_data_set_int(_data.get(), version_tag_name.data(), STREAMFX_VERSION);
+void streamfx::configuration::write()
+{
+	std::lock_guard<std::mutex> lg(_write_lock);
 
-			if (_config_path.has_parent_path()) {
-				std::filesystem::create_directories(_config_path.parent_path());
-			}
-			if (!obs_data_save_json_safe(_data.get(), reinterpret_cast<const char*>(_config_path.string().c_str()), ".tmp", path_backup_ext.data())) {
-				D_LOG_ERROR("Failed to save configuration file.", nullptr);
-			}
-		});
+	// Update version tag.
+	obs_data_set_int(_data.get(), version_tag_name.data(), STREAMFX_VERSION);
+
+	if (_config_path.has_parent_path()) {
+		std::filesystem::create_directories(_config_path.parent_path());
+	}
+	if (!obs_data_save_json_safe(_data.get(), reinterpret_cast<const char*>(_config_path.string().c_str()), ".tmp", path_backup_ext.data())) {
+		D_LOG_ERROR("Failed to save configuration file.", nullptr);
 	}
 }
 
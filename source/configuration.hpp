@@ -22,7 +22,10 @@ namespace streamfx {
 #endif
 			std::mutex _task_lock;
 
-		std::shared_ptr<streamfx::util::threadpool::task> _save_task;
+		std::shared_ptr<streamfx::util::threadpool::timer> _save_timer;
+
+		// A save requested while the previous write is still running schedules another one, which must wait for it.
+		std::mutex _write_lock;
 
 		public:
 		~configuration();
@@ -33,6 +36,9 @@ namespace streamfx {
 		public:
 		void save();
 
+		private:
+		void write();
+
 		public:
 		std::shared_ptr<obs_data_t> get();
 
@@ -0,0 +1,294 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "gfx-render-budget.hpp"
+#include "common.hpp"
+#include "configuration.hpp"
+#include "plugin.hpp"
+#include "util/util-logging.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include "warning-enable.hpp"
+
+#ifdef _DEBUG
+#define ST_PREFIX "<%s> "
+#define D_LOG_ERROR(x, ...) P_LOG_ERROR(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_WARNING(x, ...) P_LOG_WARN(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_INFO(x, ...) P_LOG_INFO(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_DEBUG(x, ...) P_LOG_DEBUG(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#else
+#define ST_PREFIX "<gfx::render_budget> "
+#define D_LOG_ERROR(...) P_LOG_ERROR(ST_PREFIX __VA_ARGS__)
+#define D_LOG_WARNING(...) P_LOG_WARN(ST_PREFIX __VA_ARGS__)
+#define D_LOG_INFO(...) P_LOG_INFO(ST_PREFIX __VA_ARGS__)
+#define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
+#endif
+
+// Share of the frame time StreamFX effects may use, in percent. Zero disables the governor.
+#define ST_CFG_RENDER_BUDGET "RenderBudget"
+
+streamfx::gfx::render_budget::client::client(std::string_view name, uint8_t levels) : _name(name), _sample(0), _quality(0), _levels(std::clamp<uint8_t>(levels, 1, max_levels)), _levels_changed(false), _cost(), _ratio(), _active(false)
+{
+	_cost.fill(-1.);
+	_ratio.fill(2.);
+}
+
+std::string_view streamfx::gfx::render_budget::client::name() const
+{
+	return _name;
+}
+
+uint8_t streamfx::gfx::render_budget::client::quality() const
+{
+	return _quality.load(std::memory_order_relaxed);
+}
+
+void streamfx::gfx::render_budget::client::set_levels(uint8_t levels)
+{
+	levels = std::clamp<uint8_t>(levels, 1, max_levels);
+	_levels.store(levels);
+	if (_quality.load() >= levels) {
+		_quality.store(levels - 1);
+	}
+	_levels_changed.store(true);
+}
+
+void streamfx::gfx::render_budget::client::report(std::chrono::nanoseconds time)
+{
+	_sample.fetch_add(std::max<int64_t>(time.count(), 1), std::memory_order_relaxed);
+}
+
+streamfx::gfx::render_budget::client::measurement::measurement(client* parent) : _parent(parent), _start(std::chrono::steady_clock::now()) {}
+
+streamfx::gfx::render_budget::client::measurement::~measurement()
+{
+	_parent->report(std::chrono::steady_clock::now() - _start);
+}
+
+streamfx::gfx::render_budget::client::measurement streamfx::gfx::render_budget::client::measure()
+{
+	return measurement(this);
+}
+
+streamfx::gfx::render_budget::render_budget() : render_budget(options{}) {}
+
+streamfx::gfx::render_budget::render_budget(options opts) : _lock(), _options(opts), _clients(), _lowered(), _settling(), _cooldown(0), _total(0) {}
+
+streamfx::gfx::render_budget::~render_budget() {}
+
+std::shared_ptr<streamfx::gfx::render_budget::client> streamfx::gfx::render_budget::add_client(std::string_view name, uint8_t levels)
+{
+	auto ptr = std::make_shared<client>(name, levels);
+
+	std::lock_guard<std::mutex> lg(_lock);
+	_clients.push_back(ptr);
+	return ptr;
+}
+
+streamfx::gfx::render_budget::options streamfx::gfx::render_budget::get_options()
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	return _options;
+}
+
+void streamfx::gfx::render_budget::set_options(options const& opts)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	_options = opts;
+}
+
+void streamfx::gfx::render_budget::frame()
+{
+	std::lock_guard<std::mutex> lg(_lock);
+
+	// Fold this frame's times into the cost of each client, and forget clients that no longer exist.
+	std::vector<std::shared_ptr<client>> clients;
+	clients.reserve(_clients.size());
+	_total = 0;
+	for (auto itr = _clients.begin(); itr != _clients.end();) {
+		auto ptr = itr->lock();
+		if (!ptr) {
+			itr = _clients.erase(itr);
+			continue;
+		}
+		itr++;
+
+		if (ptr->_levels_changed.exchange(false)) {
+			forget_levels(ptr);
+		}
+
+		int64_t sample = ptr->_sample.exchange(0, std::memory_order_relaxed);
+		ptr->_active   = (sample > 0);
+		if (ptr->_active) {
+			auto& cost = ptr->_cost[ptr->_quality.load()];
+			if (cost < 0) {
+				cost = double_t(sample);
+			} else {
+				cost += (double_t(sample) - cost) * _options.smoothing;
+			}
+			_total += cost;
+		}
+		clients.push_back(std::move(ptr));
+	}
+	_lowered.erase(std::remove_if(_lowered.begin(), _lowered.end(), [](auto const& ptr) { return ptr.expired(); }), _lowered.end());
+
+	// Without a budget, everything renders at full quality.
+	double_t budget = double_t(_options.budget.count());
+	if (budget <= 0) {
+		for (auto& ptr : clients) {
+			ptr->_quality.store(0);
+		}
+		_lowered.clear();
+		_settling.reset();
+		_cooldown = 0;
+		return;
+	}
+
+	if (_cooldown > 0) {
+		_cooldown--;
+		return;
+	}
+
+	// Costs change with the content, so remember how much a level saved right after lowering it, instead of comparing
+	// against a cost that may be minutes old when deciding to raise quality again.
+	if (auto ptr = _settling.lock(); ptr) {
+		uint8_t quality = ptr->_quality.load();
+		if ((quality > 0) && (ptr->_cost[quality] > 0) && (ptr->_cost[quality - 1] > 0)) {
+			ptr->_ratio[quality] = ptr->_cost[quality - 1] / ptr->_cost[quality];
+		}
+		_settling.reset();
+	}
+
+	if (_total > budget) {
+		// Lower the quality of whichever client currently costs the most and still has room to go lower.
+		std::shared_ptr<client> target;
+		double_t                target_cost = 0;
+		for (auto& ptr : clients) {
+			uint8_t quality = ptr->_quality.load();
+			if (!ptr->_active || ((quality + 1) >= ptr->_levels.load())) {
+				continue;
+			}
+			if (double_t cost = ptr->_cost[quality]; cost > target_cost) {
+				target      = ptr;
+				target_cost = cost;
+			}
+		}
+
+		if (target) {
+			uint8_t quality        = target->_quality.load() + 1;
+			target->_cost[quality] = -1;
+			target->_quality.store(quality);
+			_lowered.push_back(target);
+			_settling = target;
+			_cooldown = _options.cooldown;
+			D_LOG_DEBUG("Lowered quality of '%s' to level %" PRIu8 ", frame cost was %.3fms of %.3fms.", target->_name.c_str(), quality, _total / 1000000., budget / 1000000.);
+		}
+	} else if ((_total < (budget * _options.restore_below)) && !_lowered.empty()) {
+		// Raise the most recently lowered client again, if the estimated cost at the higher level still fits.
+		auto    target  = _lowered.back().lock();
+		uint8_t quality = target->_quality.load();
+		if (quality == 0) {
+			// Already back at full quality because its levels changed, see forget_levels().
+			_lowered.pop_back();
+			return;
+		}
+
+		double_t current = target->_active ? target->_cost[quality] : 0;
+		double_t raised  = current * target->_ratio[quality];
+		if ((_total - current + raised) < budget) {
+			target->_cost[quality - 1] = -1;
+			target->_quality.store(quality - 1);
+			_lowered.pop_back();
+			_cooldown = _options.cooldown;
+			D_LOG_DEBUG("Raised quality of '%s' to level %" PRIu8 ", frame cost was %.3fms of %.3fms.", target->_name.c_str(), static_cast<uint8_t>(quality - 1), _total / 1000000., budget / 1000000.);
+		}
+	}
+}
+
+void streamfx::gfx::render_budget::forget_levels(std::shared_ptr<client> const& ptr)
+{
+	// Levels the client no longer has can't be raised from, so drop the most recent of its entries until there is only
+	// one per level it is still lowered by.
+	uint8_t quality = std::min<uint8_t>(ptr->_quality.load(), ptr->_levels.load() - 1);
+	ptr->_quality.store(quality);
+
+	size_t entries = static_cast<size_t>(std::count_if(_lowered.begin(), _lowered.end(), [&ptr](auto const& entry) { return entry.lock() == ptr; }));
+	for (auto itr = _lowered.end(); (entries > quality) && (itr != _lowered.begin());) {
+		itr--;
+		if (itr->lock() == ptr) {
+			itr = _lowered.erase(itr);
+			entries--;
+		}
+	}
+
+	// Whatever was measured for the old levels no longer applies.
+	if (_settling.lock() == ptr) {
+		_settling.reset();
+	}
+	ptr->_cost.fill(-1.);
+	ptr->_ratio.fill(2.);
+}
+
+std::chrono::nanoseconds streamfx::gfx::render_budget::total()
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	return std::chrono::nanoseconds(static_cast<int64_t>(_total));
+}
+
+std::shared_ptr<streamfx::gfx::render_budget> streamfx::gfx::render_budget::instance()
+{
+	static std::weak_ptr<streamfx::gfx::render_budget> winst;
+	static std::mutex                                  mtx;
+
+	std::unique_lock<decltype(mtx)> lock(mtx);
+	auto                            instance = winst.lock();
+	if (!instance) {
+		instance = std::make_shared<streamfx::gfx::render_budget>();
+		winst    = instance;
+	}
+	return instance;
+}
+
+static std::shared_ptr<streamfx::gfx::render_budget> loader_instance;
+static int64_t                                       loader_percent = 0;
+
+static void loader_frame(void*, uint32_t, uint32_t)
+{
+	// The frame rate can change at any time, so the budget has to follow it.
+	obs_video_info ovi;
+	if (obs_get_video_info(&ovi) && (ovi.fps_num > 0)) {
+		auto opts   = loader_instance->get_options();
+		auto budget = std::chrono::nanoseconds((int64_t(1000000000) * ovi.fps_den * loader_percent) / (int64_t(ovi.fps_num) * 100));
+		if (opts.budget != budget) {
+			opts.budget = budget;
+			loader_instance->set_options(opts);
+		}
+	}
+
+	loader_instance->frame();
+}
+
+static auto loader = streamfx::component(
+	"core::render_budget",
+	[]() { // Initializer
+		loader_instance = streamfx::gfx::render_budget::instance();
+
+		if (auto config = streamfx::configuration::instance(); config) {
+			auto data      = config->get();
+			loader_percent = std::clamp<int64_t>(obs_data_get_int(data.get(), ST_CFG_RENDER_BUDGET), 0, 100);
+		}
+		if (loader_percent > 0) {
+			D_LOG_INFO("Limiting effects to %" PRId64 "%% of the frame time.", loader_percent);
+			obs_add_main_render_callback(loader_frame, nullptr);
+		}
+	},
+	[]() { // Finalizer
+		if (loader_percent > 0) {
+			obs_remove_main_render_callback(loader_frame, nullptr);
+		}
+		loader_instance.reset();
+	},
+	{"core::configuration"});
@@ -0,0 +1,131 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "warning-disable.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace streamfx::gfx {
+	/** Keeps the time spent rendering StreamFX effects within a share of the frame.
+	 *
+	 * Effects register as a client and report how long each render took. Once per frame the governor adds up the cost of
+	 * all clients that rendered, and if that exceeds the budget it lowers the quality of the most expensive client by
+	 * one level. Once the total is comfortably below the budget again, the most recently lowered client is raised again.
+	 * Only one change is made per cooldown period, so that costs can settle before the next decision.
+	 *
+	 * The governor itself does not depend on libobs, so the policy can be driven with synthetic timings.
+	 */
+	class render_budget {
+		public:
+		/// Highest number of quality levels a client can have, including full quality.
+		static constexpr uint8_t max_levels = 4;
+
+		struct options {
+			/// Time all clients may spend per frame. Zero disables the governor and restores full quality.
+			std::chrono::nanoseconds budget{0};
+
+			/// Quality is only raised again while the total is below this share of the budget.
+			double_t restore_below = 0.75;
+
+			/// Frames to wait after a change before making another one.
+			uint32_t cooldown = 30;
+
+			/// Weight of a new frame in the moving average of the cost of a client.
+			double_t smoothing = 0.1;
+		};
+
+		class client {
+			std::string          _name;
+			std::atomic<int64_t> _sample;
+			std::atomic<uint8_t> _quality;
+			std::atomic<uint8_t> _levels;
+			std::atomic<bool>    _levels_changed;
+
+			// Only used by the governor, under its lock.
+			std::array<double_t, max_levels> _cost;
+			std::array<double_t, max_levels> _ratio;
+			bool                             _active;
+
+			friend class render_budget;
+
+			public:
+			client(std::string_view name, uint8_t levels);
+
+			std::string_view name() const;
+
+			/** Quality level to render at, where 0 is full quality and higher levels are cheaper.
+			 */
+			uint8_t quality() const;
+
+			/** Change the number of quality levels this client supports.
+			 *
+			 * A client with a single level still counts towards the total, but is never asked to reduce quality. May be
+			 * called at any time, the governor catches up with the change on the next frame.
+			 */
+			void set_levels(uint8_t levels);
+
+			/// Add the time of a render to the current frame. May be called several times per frame.
+			void report(std::chrono::nanoseconds time);
+
+			/** Report the lifetime of this object when it goes out of scope.
+			 */
+			class measurement {
+				client*                               _parent;
+				std::chrono::steady_clock::time_point _start;
+
+				public:
+				measurement(client* parent);
+				~measurement();
+
+				measurement(measurement const&)            = delete;
+				measurement& operator=(measurement const&) = delete;
+			};
+
+			measurement measure();
+		};
+
+		private:
+		std::mutex                         _lock;
+		options                            _options;
+		std::vector<std::weak_ptr<client>> _clients;
+		std::vector<std::weak_ptr<client>> _lowered;
+		std::weak_ptr<client>              _settling;
+		uint32_t                           _cooldown;
+		double_t                           _total;
+
+		public:
+		render_budget();
+		render_budget(options opts);
+		~render_budget();
+
+		std::shared_ptr<client> add_client(std::string_view name, uint8_t levels = 1);
+
+		options get_options();
+
+		void set_options(options const& opts);
+
+		/** Finish the current frame and adjust quality levels. Must be called exactly once per frame.
+		 */
+		void frame();
+
+		/// Estimated time spent by all clients in the last frame.
+		std::chrono::nanoseconds total();
+
+		private:
+		void forget_levels(std::shared_ptr<client> const& ptr);
+
+		public /* Singleton */:
+		static std::shared_ptr<streamfx::gfx::render_budget> instance();
+	};
+} // namespace streamfx::gfx
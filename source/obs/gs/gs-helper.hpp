@@ -5,6 +5,7 @@
 #pragma once
 #include "common.hpp"
 #include "plugin.hpp"
+#include "util/util-trace.hpp"
 
 #include "warning-disable.hpp"
 #include <vector>
@@ -67,10 +68,12 @@ namespace streamfx::obs::gs {
 
 			_name = std::string(buffer.data(), buffer.data() + size);
 			gs_debug_marker_begin(color, _name.c_str());
+			streamfx::util::trace::begin("gs", _name);
 		}
 
 		inline ~debug_marker()
 		{
+			streamfx::util::trace::end("gs");
 			gs_debug_marker_end();
 		}
 	};
@@ -51,4 +51,4 @@ static auto loader = streamfx::component(
 	[]() { // Finalizer
 		loader_instance.reset();
 	},
-	{});
+	{"core::threadpool"});
@@ -72,4 +72,4 @@ static auto loader = streamfx::component(
 	[]() { // Finalizer
 		loader_instance.reset();
 	},
-	{});
+	{"core::threadpool"});
@@ -81,4 +81,4 @@ static auto loader = streamfx::component(
 	[]() { // Finalizer
 		loader_instance.reset();
 	},
-	{});
+	{"core::threadpool"});
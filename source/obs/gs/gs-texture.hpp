@@ -9,7 +9,9 @@
 
 #include "warning-disable.hpp"
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <tuple>
 #include "warning-enable.hpp"
 
 namespace streamfx::obs::gs {
@@ -129,8 +131,16 @@ namespace streamfx::obs::gs {
 
 		public:
 		class pool;
-		typedef std::tuple<uint64_t, std::filesystem::path>                                                                _pool_key_t;
-		typedef streamfx::util::multipool<streamfx::obs::gs::texture::pool, streamfx::obs::gs::texture, 1000, _pool_key_t> _pool_t;
+		typedef std::tuple<uint64_t, std::filesystem::path> _pool_key_t;
+
+		struct _pool_key_hash {
+			std::size_t operator()(_pool_key_t const& key) const noexcept
+			{
+				return std::hash<uint64_t>{}(std::get<0>(key)) ^ std::filesystem::hash_value(std::get<1>(key));
+			}
+		};
+
+		typedef streamfx::util::multipool<streamfx::obs::gs::texture::pool, streamfx::obs::gs::texture, 1000, _pool_key_t, _pool_key_hash> _pool_t;
 
 		class pool : public _pool_t {
 			friend streamfx::util::singleton<streamfx::obs::gs::texture::pool>;
@@ -8,6 +8,7 @@
 #include "util/util-logging.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
 #include <mutex>
 #include <stdexcept>
 #include "warning-enable.hpp"
@@ -26,7 +27,7 @@
 #define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
 #endif
 
-streamfx::obs::source_tracker::source_tracker() : _sources(), _mutex()
+streamfx::obs::source_tracker::source_tracker() : _sources(), _index(), _mutex(), _generation(0), events()
 {
 	auto osi = obs_get_signal_handler();
 	if (osi) {
@@ -61,26 +62,20 @@ streamfx::obs::source_tracker::~source_tracker()
 
 void streamfx::obs::source_tracker::enumerate(enumerate_cb_t ecb, filter_cb_t fcb)
 {
-	// Need func-local copy, otherwise we risk corruption if a new source is created or destroyed.
-	decltype(_sources) _clone;
-	{
-		std::lock_guard<decltype(_mutex)> lock(_mutex);
-		_clone = _sources;
-	}
-
-	for (auto kv : _clone) {
-		auto wsource = kv.second;
+	// The index is never modified once built, so it can be walked without holding the lock.
+	auto index = get_index();
+	for (auto const& ptr : (*index)[static_cast<size_t>(category::ALL)]) {
 		try {
-			auto source = wsource.lock();
+			auto source = ptr->source.lock();
 
 			if (fcb) {
-				if (fcb(kv.first, source)) {
+				if (fcb(ptr->name, source)) {
 					continue;
 				}
 			}
 
 			if (ecb) {
-				if (ecb(kv.first, source)) {
+				if (ecb(ptr->name, source)) {
 					break;
 				}
 			}
@@ -90,6 +85,61 @@ void streamfx::obs::source_tracker::enumerate(enumerate_cb_t ecb, filter_cb_t fc
 	}
 }
 
+::streamfx::obs::weak_source streamfx::obs::source_tracker::find(std::string_view name)
+{
+	std::lock_guard<decltype(_mutex)> lock(_mutex);
+	if (auto kv = _sources.find(name); kv != _sources.end()) {
+		return kv->second->source;
+	}
+	return {};
+}
+
+uint64_t streamfx::obs::source_tracker::generation()
+{
+	return _generation.load(std::memory_order_acquire);
+}
+
+std::shared_ptr<const streamfx::obs::source_tracker::index_t> streamfx::obs::source_tracker::get_index()
+{
+	std::lock_guard<decltype(_mutex)> lock(_mutex);
+	if (_index) {
+		return _index;
+	}
+
+	// Rebuilt on demand, as sources tend to be created and destroyed in bursts, such as when loading a scene collection.
+	std::vector<std::shared_ptr<const entry>> entries;
+	entries.reserve(_sources.size());
+	for (auto const& kv : _sources) {
+		entries.push_back(kv.second);
+	}
+	std::sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) { return a->name < b->name; });
+
+	auto index = std::make_shared<index_t>();
+	for (auto const& ptr : entries) {
+		bool input = (ptr->type == OBS_SOURCE_TYPE_INPUT);
+
+		(*index)[static_cast<size_t>(category::ALL)].push_back(ptr);
+		if (input) {
+			(*index)[static_cast<size_t>(category::SOURCE)].push_back(ptr);
+		}
+		if (input && (ptr->output_flags & OBS_SOURCE_AUDIO)) {
+			(*index)[static_cast<size_t>(category::AUDIO_SOURCE)].push_back(ptr);
+		}
+		if (input && (ptr->output_flags & OBS_SOURCE_VIDEO)) {
+			(*index)[static_cast<size_t>(category::VIDEO_SOURCE)].push_back(ptr);
+		}
+		if (ptr->type == OBS_SOURCE_TYPE_TRANSITION) {
+			(*index)[static_cast<size_t>(category::TRANSITION)].push_back(ptr);
+		}
+		if (ptr->type == OBS_SOURCE_TYPE_SCENE) {
+			(*index)[static_cast<size_t>(category::SCENE)].push_back(ptr);
+		}
+	}
+
+	_index = index;
+	return _index;
+}
+
 void streamfx::obs::source_tracker::insert_source(obs_source_t* source)
 {
 	const char* name = obs_source_get_name(source);
@@ -100,32 +150,61 @@ void streamfx::obs::source_tracker::insert_source(obs_source_t* source)
 		return;
 	}
 
+	// Type and flags are looked up once here, instead of on every enumeration.
+	auto ptr          = std::make_shared<entry>();
+	ptr->name         = name;
+	ptr->source       = ::streamfx::obs::weak_source{source};
+	ptr->type         = obs_source_get_type(source);
+	ptr->output_flags = obs_source_get_output_flags(source);
+
 	// Insert the newly tracked source into the map.
-	std::lock_guard<decltype(_mutex)> lock(_mutex);
-	_sources.emplace(std::string{name}, ::streamfx::obs::weak_source{source});
+	{
+		std::lock_guard<decltype(_mutex)> lock(_mutex);
+		if (!_sources.emplace(ptr->name, ptr).second) {
+			return;
+		}
+		_index.reset();
+		_generation.fetch_add(1, std::memory_order_release);
+	}
+
+	events.inserted(*this, *ptr);
 }
 
 void streamfx::obs::source_tracker::remove_source(obs_source_t* source)
 {
-	std::lock_guard<decltype(_mutex)> lock(_mutex);
-	const char*                       name = obs_source_get_name(source);
+	std::shared_ptr<const entry> removed;
+	const char*                  name = obs_source_get_name(source);
+	{
+		std::lock_guard<decltype(_mutex)> lock(_mutex);
 
-	// Try and find the source by name.
-	if (name) {
-		if (auto kv = _sources.find(std::string{name}); kv != _sources.end()) {
-			_sources.erase(kv);
-			return;
+		// Try and find the source by name.
+		if (name) {
+			if (auto kv = _sources.find(std::string_view{name}); (kv != _sources.end()) && (kv->second->source == source)) {
+				removed = kv->second;
+				_sources.erase(kv);
+			}
 		}
-	}
 
-	// Try and find the source by pointer.
-	for (auto kv = _sources.begin(); kv != _sources.end(); kv++) {
-		if (kv->second == source) {
-			_sources.erase(kv);
-			return;
+		// Try and find the source by pointer.
+		for (auto kv = _sources.begin(); !removed && (kv != _sources.end()); kv++) {
+			if (kv->second->source == source) {
+				removed = kv->second;
+				_sources.erase(kv);
+				break;
+			}
+		}
+
+		if (removed) {
+			_index.reset();
+			_generation.fetch_add(1, std::memory_order_release);
 		}
 	}
 
+	if (removed) {
+		events.removed(*this, *removed);
+		return;
+	}
+
 	// If we're still here, there's something wrong.
 	if (name) {
 		D_LOG_ERROR("Attempt to remove untracked source '0x%08zX' with name %s failed.", source, name);
@@ -139,15 +218,34 @@ void streamfx::obs::source_tracker::rename_source(std::string_view old_name, std
 		throw std::runtime_error("New and old name are identical.");
 	}
 
-	std::lock_guard<decltype(_mutex)> lock(_mutex);
+	// Entries are shared with enumerations that may still be running, so a renamed source gets a new one.
+	auto                         ptr = std::make_shared<entry>();
+	std::shared_ptr<const entry> old;
+	{
+		std::lock_guard<decltype(_mutex)> lock(_mutex);
 
-	// Remove the previously tracked entry.
-	if (auto kv = _sources.find(std::string{old_name}); kv != _sources.end()) {
-		_sources.erase(kv);
+		if (auto kv = _sources.find(old_name); kv != _sources.end()) {
+			old  = kv->second;
+			*ptr = *old;
+			_sources.erase(kv);
+		} else {
+			ptr->source       = ::streamfx::obs::weak_source{source};
+			ptr->type         = obs_source_get_type(source);
+			ptr->output_flags = obs_source_get_output_flags(source);
+		}
+		ptr->name = new_name;
+
+		// And then add the new entry.
+		_sources.emplace(ptr->name, ptr);
+		_index.reset();
+		_generation.fetch_add(1, std::memory_order_release);
 	}
 
-	// And then add the new entry.
-	_sources.emplace(std::string{new_name}, ::streamfx::obs::weak_source{source});
+	if (old) {
+		events.renamed(*this, *old, *ptr);
+	} else {
+		events.inserted(*this, *ptr);
+	}
 }
 
 bool streamfx::obs::source_tracker::filter_sources(std::string, ::streamfx::obs::source source)
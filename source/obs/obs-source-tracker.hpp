@@ -5,17 +5,57 @@
 #pragma once
 #include "common.hpp"
 #include "obs/obs-weak-source.hpp"
+#include "util/util-event.hpp"
 
 #include "warning-disable.hpp"
+#include <array>
+#include <atomic>
 #include <functional>
-#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include "warning-enable.hpp"
 
 namespace streamfx::obs {
 	class source_tracker {
-		std::map<std::string, ::streamfx::obs::weak_source> _sources;
-		std::mutex                                          _mutex;
+		public:
+		/// Groups of sources that can be enumerated without looking at each source.
+		enum class category : uint8_t {
+			ALL,
+			SOURCE, // Inputs.
+			AUDIO_SOURCE, // Inputs with audio output.
+			VIDEO_SOURCE, // Inputs with video output.
+			TRANSITION,
+			SCENE,
+			MAX,
+		};
+
+		struct entry {
+			std::string                  name;
+			::streamfx::obs::weak_source source;
+			obs_source_type              type;
+			uint32_t                     output_flags;
+		};
+
+		private:
+		struct name_hash {
+			using is_transparent = void;
+			size_t operator()(std::string_view name) const noexcept
+			{
+				return std::hash<std::string_view>{}(name);
+			}
+		};
+
+		// Entries of each category, sorted by name.
+		typedef std::array<std::vector<std::shared_ptr<const entry>>, static_cast<size_t>(category::MAX)> index_t;
+
+		std::unordered_map<std::string, std::shared_ptr<const entry>, name_hash, std::equal_to<>> _sources;
+		std::shared_ptr<const index_t>                                                            _index;
+		std::mutex                                                                                _mutex;
+		std::atomic<uint64_t>                                                                     _generation;
 
 		public:
 		// Callback function for enumerating sources.
@@ -44,6 +84,39 @@ namespace streamfx::obs {
 		// @param filter_cb Filter function to narrow down results.
 		void enumerate(enumerate_cb_t enumerate_cb, filter_cb_t filter_cb = nullptr);
 
+		/** Enumerate all tracked sources in a category, sorted by name.
+		 *
+		 * Neither allocates nor locks any source, so this is the preferred way to fill a list of sources. The entries may
+		 * be kept for as long as needed, but don't change if the source is renamed.
+		 *
+		 * @param callback Called with each `entry const&`, returns true to abort enumeration.
+		 */
+		template<typename T>
+		void enumerate(category cat, T&& callback)
+		{
+			auto index = get_index();
+			for (auto const& ptr : (*index)[static_cast<size_t>(cat)]) {
+				if (callback(*ptr)) {
+					break;
+				}
+			}
+		}
+
+		/** Find a tracked source by its name.
+		 *
+		 * @return The source, or an expired reference if there is no source by that name.
+		 */
+		::streamfx::obs::weak_source find(std::string_view name);
+
+		/** Number of changes to the tracked sources so far.
+		 *
+		 * Anything built from an enumeration only needs to be rebuilt once this has moved.
+		 */
+		uint64_t generation();
+
+		private:
+		std::shared_ptr<const index_t> get_index();
+
 		protected:
 		void insert_source(obs_source_t* source);
 		void remove_source(obs_source_t* source);
@@ -61,6 +134,15 @@ namespace streamfx::obs {
 		static void source_destroy_handler(void* ptr, calldata_t* data) noexcept;
 		static void source_rename_handler(void* ptr, calldata_t* data) noexcept;
 
+		public:
+		// Called after a change was made, and after generation() has moved. Listeners must not block, as they are called
+		// from within the libobs signal that caused the change.
+		struct _ {
+			streamfx::util::event<source_tracker&, entry const&>               inserted;
+			streamfx::util::event<source_tracker&, entry const&>               removed;
+			streamfx::util::event<source_tracker&, entry const&, entry const&> renamed; // Old and new entry.
+		} events;
+
 		public: // Singleton
 		static std::shared_ptr<streamfx::obs::source_tracker> instance();
 	};
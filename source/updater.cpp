@@ -485,7 +485,8 @@ void streamfx::updater::refresh()
 		save();
 
 		// Spawn a new task.
-		_task = streamfx::util::threadpool::threadpool::instance()->push(std::bind(&streamfx::updater::task, this, std::placeholders::_1), nullptr);
+		auto pool = streamfx::util::threadpool::threadpool::instance();
+		_task     = pool->push(std::bind(&streamfx::updater::task, this, std::placeholders::_1), nullptr, streamfx::util::threadpool::priority::background, pool->tag("updater"));
 	} else {
 		events.refreshed(*this);
 	}
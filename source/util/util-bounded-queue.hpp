@@ -0,0 +1,123 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include "warning-enable.hpp"
+
+namespace streamfx::util {
+	/** Bounded lock-free queue for any number of producers and consumers.
+	 *
+	 * Every slot carries a sequence number that tells producers and consumers whose turn it is, so neither side ever
+	 * waits on the other unless the queue is full or empty. The capacity is rounded up to the next power of two.
+	 *
+	 * Popped slots are reset to a default constructed value, so that shared or owning types release what they held.
+	 */
+	template<typename _type>
+	class bounded_queue {
+		struct slot {
+			std::atomic<size_t> sequence;
+			_type               value;
+		};
+
+		std::unique_ptr<slot[]> _slots;
+		size_t                  _mask;
+
+		alignas(64) std::atomic<size_t> _head;
+		alignas(64) std::atomic<size_t> _tail;
+
+		public:
+		bounded_queue(size_t capacity) : _slots(), _mask(0), _head(0), _tail(0)
+		{
+			capacity = std::bit_ceil(std::max<size_t>(capacity, 2));
+			_slots   = std::make_unique<slot[]>(capacity);
+			_mask    = capacity - 1;
+			for (size_t idx = 0; idx < capacity; idx++) {
+				_slots[idx].sequence.store(idx, std::memory_order_relaxed);
+			}
+		}
+
+		/** Append a value to the queue.
+		 *
+		 * @return false if the queue is full, in which case `value` is left untouched.
+		 */
+		bool try_push(_type&& value)
+		{
+			size_t pos = _head.load(std::memory_order_relaxed);
+			while (true) {
+				slot&    ptr  = _slots[pos & _mask];
+				size_t   seq  = ptr.sequence.load(std::memory_order_acquire);
+				intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+				if (diff == 0) {
+					if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						ptr.value = std::move(value);
+						ptr.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = _head.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool try_push(_type const& value)
+		{
+			_type copy = value;
+			return try_push(std::move(copy));
+		}
+
+		/** Take the oldest value from the queue.
+		 *
+		 * @return false if the queue is empty, in which case `value` is left untouched.
+		 */
+		bool try_pop(_type& value)
+		{
+			size_t pos = _tail.load(std::memory_order_relaxed);
+			while (true) {
+				slot&    ptr  = _slots[pos & _mask];
+				size_t   seq  = ptr.sequence.load(std::memory_order_acquire);
+				intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+				if (diff == 0) {
+					if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						value     = std::move(ptr.value);
+						ptr.value = _type();
+						ptr.sequence.store(pos + _mask + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = _tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/// Number of values in the queue. Either side may move while reading, so this is only an estimate.
+		size_t size() const
+		{
+			size_t tail = _tail.load(std::memory_order_acquire);
+			size_t head = _head.load(std::memory_order_acquire);
+			return (head > tail) ? (head - tail) : 0;
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		size_t capacity() const
+		{
+			return _mask + 1;
+		}
+	};
+} // namespace streamfx::util
@@ -0,0 +1,266 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "util/util-logging.hpp"
+#include "util/util-threadpool.hpp"
+
+#include "warning-disable.hpp"
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+#include "warning-enable.hpp"
+
+namespace streamfx::util::threadpool {
+	template<typename _type>
+	class async;
+
+	namespace detail {
+		class async_promise_base {
+			std::coroutine_handle<> _continuation;
+			bool                    _detached;
+
+			protected:
+			std::exception_ptr _exception;
+
+			public:
+			async_promise_base() : _continuation(), _detached(false), _exception() {}
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			struct final_awaiter {
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				template<typename _promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<_promise> handle) noexcept
+				{
+					async_promise_base& promise = handle.promise();
+					if (promise._continuation) {
+						// Transfer directly to whoever awaited us, without growing the stack.
+						return promise._continuation;
+					} else if (promise._detached) {
+						if (promise._exception) {
+							P_LOG_ERROR("<util::threadpool::async> Unhandled exception in detached coroutine.", nullptr);
+						}
+						handle.destroy();
+					}
+					return std::noop_coroutine();
+				}
+
+				void await_resume() noexcept {}
+			};
+
+			final_awaiter final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void unhandled_exception() noexcept
+			{
+				_exception = std::current_exception();
+			}
+
+			void set_continuation(std::coroutine_handle<> continuation)
+			{
+				_continuation = continuation;
+			}
+
+			void set_detached()
+			{
+				_detached = true;
+			}
+
+			void rethrow()
+			{
+				if (_exception) {
+					std::rethrow_exception(_exception);
+				}
+			}
+		};
+
+		template<typename _type>
+		class async_promise : public async_promise_base {
+			std::optional<_type> _value;
+
+			public:
+			async<_type> get_return_object() noexcept;
+
+			template<typename _value_type>
+			void return_value(_value_type&& value)
+			{
+				_value.emplace(std::forward<_value_type>(value));
+			}
+
+			_type result()
+			{
+				rethrow();
+				return std::move(*_value);
+			}
+		};
+
+		template<>
+		class async_promise<void> : public async_promise_base {
+			public:
+			async<void> get_return_object() noexcept;
+
+			void return_void() noexcept {}
+
+			void result()
+			{
+				rethrow();
+			}
+		};
+	} // namespace detail
+
+	/** Lazily started coroutine.
+	 *
+	 * Nothing runs until the coroutine is either awaited with co_await, or started with detach(). Awaiting it resumes
+	 * the awaiting coroutine on whichever thread the awaited one finished on.
+	 *
+	 * Usage:
+	 *     async<int> load(std::shared_ptr<threadpool> pool)
+	 *     {
+	 *         co_await schedule(pool, priority::background); // Continue on a worker thread.
+	 *         co_await pool->push(...);                       // Wait for a task without blocking the worker.
+	 *         co_return 42;
+	 *     }
+	 *
+	 *     load(pool).detach();
+	 */
+	template<typename _type = void>
+	class async {
+		public:
+		typedef detail::async_promise<_type> promise_type;
+
+		private:
+		std::coroutine_handle<promise_type> _handle;
+
+		public:
+		explicit async(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+		async(async&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+		async& operator=(async&& other) noexcept
+		{
+			if (this != &other) {
+				if (_handle) {
+					_handle.destroy();
+				}
+				_handle = std::exchange(other._handle, nullptr);
+			}
+			return *this;
+		}
+		~async()
+		{
+			if (_handle) {
+				_handle.destroy();
+			}
+		}
+
+		async(const async&)            = delete;
+		async& operator=(const async&) = delete;
+
+		/** Start the coroutine and let it clean up after itself once it finishes.
+		 */
+		void detach()
+		{
+			auto handle = std::exchange(_handle, nullptr);
+			handle.promise().set_detached();
+			handle.resume();
+		}
+
+		auto operator co_await() && noexcept
+		{
+			struct awaiter {
+				std::coroutine_handle<promise_type> handle;
+
+				bool await_ready() noexcept
+				{
+					return !handle || handle.done();
+				}
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+				{
+					handle.promise().set_continuation(awaiting);
+					return handle;
+				}
+
+				_type await_resume()
+				{
+					return handle.promise().result();
+				}
+			};
+			return awaiter{_handle};
+		}
+	};
+
+	template<typename _type>
+	inline async<_type> detail::async_promise<_type>::get_return_object() noexcept
+	{
+		return async<_type>{std::coroutine_handle<async_promise<_type>>::from_promise(*this)};
+	}
+
+	inline async<void> detail::async_promise<void>::get_return_object() noexcept
+	{
+		return async<void>{std::coroutine_handle<async_promise<void>>::from_promise(*this)};
+	}
+
+	/** Continue the current coroutine on a worker thread of the given pool.
+	 *
+	 * The caller gives up its thread, so this is how work gets moved off the graphics or UI thread.
+	 */
+	inline auto schedule(std::shared_ptr<threadpool> pool, priority klass = priority::background)
+	{
+		struct awaiter {
+			std::shared_ptr<threadpool> pool;
+			priority                    klass;
+
+			bool await_ready() noexcept
+			{
+				return false;
+			}
+
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				pool->dispatch([handle]() { handle.resume(); }, klass);
+			}
+
+			void await_resume() noexcept {}
+		};
+		return awaiter{pool, klass};
+	}
+
+	/** Wait for a task to complete or be cancelled, without blocking the thread.
+	 *
+	 * The coroutine continues on the thread that finished or cancelled the task. Check task::is_cancelled() or
+	 * task::has_failed() afterwards to find out how it ended.
+	 */
+	inline auto operator co_await(std::shared_ptr<task> value)
+	{
+		struct awaiter {
+			std::shared_ptr<task> value;
+
+			bool await_ready() noexcept
+			{
+				return !value || value->is_completed();
+			}
+
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				// The coroutine may already be resumed and destroyed before then() returns, so keep our own reference.
+				auto keep = value;
+				keep->then([handle]() { handle.resume(); });
+			}
+
+			void await_resume() noexcept {}
+		};
+		return awaiter{std::move(value)};
+	}
+} // namespace streamfx::util::threadpool
@@ -7,26 +7,117 @@
 #include "common.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
 #include <functional>
-#include <list>
 #include <mutex>
+#include <utility>
+#include <vector>
 #include "warning-enable.hpp"
 
 namespace streamfx::util {
+	/** List of listeners that can be called from any thread without taking a lock.
+	 *
+	 * The listeners are kept in an immutable snapshot, and any change publishes a new snapshot. A call announces itself
+	 * in one of two reader counters, chosen by the parity of the current epoch, and then iterates whichever snapshot is
+	 * current. Replaced snapshots are only freed once both counters have been seen at zero after the replacement, and as
+	 * every change advances the epoch, new calls always move away from the counter that still has to drain.
+	 *
+	 * Listeners may add or remove listeners, or call the event again, from within a call. A call that already started
+	 * finishes with the listeners it started with, so a listener may still be called once right after being removed.
+	 */
 	template<typename... _args>
 	class event {
-		std::list<std::function<void(_args...)>> _listeners;
-		std::recursive_mutex                     _lock;
+		typedef std::function<void(_args...)> listener_t;
+
+		struct snapshot {
+			std::vector<std::pair<uint64_t, listener_t>> listeners;
+		};
+
+		std::atomic<const snapshot*> _snapshot;
+		std::atomic<uint64_t>        _epoch;
+		std::atomic<size_t>          _readers[2];
+
+		// Only used while holding the lock.
+		std::recursive_mutex                             _lock;
+		std::vector<std::pair<const snapshot*, uint8_t>> _retired;
+		uint64_t                                         _next_id;
 
 		std::function<void()> _cb_fill;
 		std::function<void()> _cb_clear;
 
+		class reader {
+			event<_args...>* _parent;
+			size_t           _parity;
+
+			public:
+			reader(event<_args...>* parent) : _parent(parent), _parity(parent->_epoch.load() & 1)
+			{
+				_parent->_readers[_parity].fetch_add(1);
+			}
+			~reader()
+			{
+				_parent->_readers[_parity].fetch_sub(1);
+			}
+
+			const snapshot* get()
+			{
+				return _parent->_snapshot.load();
+			}
+		};
+
+		/// Replace the current snapshot, must hold the lock.
+		void publish(const snapshot* next)
+		{
+			const snapshot* prev = _snapshot.exchange(next);
+			_epoch.fetch_add(1);
+			if (prev) {
+				_retired.emplace_back(prev, 0);
+			}
+
+			// Every call that could still see a retired snapshot registered before it was replaced, so once a counter has
+			// been seen at zero, none of them are left in it.
+			for (size_t parity = 0; parity < 2; parity++) {
+				if (_readers[parity].load() == 0) {
+					for (auto& kv : _retired) {
+						kv.second |= static_cast<uint8_t>(1 << parity);
+					}
+				}
+			}
+			for (auto itr = _retired.begin(); itr != _retired.end();) {
+				if (itr->second == 3) {
+					delete itr->first;
+					itr = _retired.erase(itr);
+				} else {
+					itr++;
+				}
+			}
+		}
+
+		/// Copy of the current listeners, must hold the lock.
+		snapshot* copy()
+		{
+			auto            next = new snapshot();
+			const snapshot* prev = _snapshot.load();
+			if (prev) {
+				next->listeners = prev->listeners;
+			}
+			return next;
+		}
+
 		public /* constructor */:
-		event() : _listeners(), _lock(), _cb_fill(), _cb_clear() {}
+		event() : _snapshot(nullptr), _epoch(0), _readers{0, 0}, _lock(), _retired(), _next_id(0), _cb_fill(), _cb_clear() {}
 		virtual ~event()
 		{
 			std::lock_guard<std::recursive_mutex> lg(_lock);
 			this->clear();
+
+			// Nothing may call an event that is being destroyed, so everything can go.
+			delete _snapshot.exchange(nullptr);
+			for (auto& kv : _retired) {
+				delete kv.first;
+			}
+			_retired.clear();
 		}
 
 		/* Copy Constructor */
@@ -35,12 +126,7 @@ namespace streamfx::util {
 		/* Move Constructor */
 		event(event<_args...>&& other) noexcept : event()
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			std::lock_guard<std::recursive_mutex> lgo(other._lock);
-
-			_listeners.swap(other._listeners);
-			_cb_fill.swap(other._cb_fill);
-			_cb_clear.swap(other._cb_clear);
+			*this = std::move(other);
 		}
 
 		public /* operators */:
@@ -53,7 +139,12 @@ namespace streamfx::util {
 			std::lock_guard<std::recursive_mutex> lg(_lock);
 			std::lock_guard<std::recursive_mutex> lgo(other._lock);
 
-			_listeners.swap(other._listeners);
+			// Both sides get a new snapshot, so that calls in progress keep theirs until they are done.
+			auto mine   = copy();
+			auto theirs = other.copy();
+			publish(theirs);
+			other.publish(mine);
+			std::swap(_next_id, other._next_id);
 			_cb_fill.swap(other._cb_fill);
 			_cb_clear.swap(other._cb_clear);
 
@@ -70,25 +161,32 @@ namespace streamfx::util {
 		template<typename... _largs>
 		inline void call(_args... args)
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			for (auto& l : _listeners) {
-				l(args...);
+			reader rd(this);
+			if (auto snap = rd.get(); snap) {
+				for (auto& l : snap->listeners) {
+					l.second(args...);
+				}
 			}
 		}
 
 		public /* functions: listeners */:
 		/** Add a new listener to the event.
 		 * @param listener A listener bound with std::bind or a std::function.
+		 * @return A handle to remove the listener with.
 		 */
-		inline void add(std::function<void(_args...)> listener)
+		inline uint64_t add(std::function<void(_args...)> listener)
 		{
 			std::lock_guard<std::recursive_mutex> lg(_lock);
-			if (_listeners.size() == 0) {
+			auto                                  next = copy();
+			if (next->listeners.size() == 0) {
 				if (_cb_fill) {
 					_cb_fill();
 				}
 			}
-			_listeners.push_back(listener);
+			uint64_t id = ++_next_id;
+			next->listeners.emplace_back(id, std::move(listener));
+			publish(next);
+			return id;
 		}
 		inline event<_args...>& operator+=(std::function<void(_args...)> listener)
 		{
@@ -97,21 +195,24 @@ namespace streamfx::util {
 		}
 
 		/** Remove an existing listener from the event.
-		 * @param listener A listener bound with std::bind or a std::function.
+		 * @param handle The handle returned by add().
 		 */
-		inline void remove(std::function<void(_args...)> listener)
+		inline void remove(uint64_t handle)
 		{
 			std::lock_guard<std::recursive_mutex> lg(_lock);
-			_listeners.remove(listener);
-			if (_listeners.size() == 0) {
+			auto                                  next = copy();
+			next->listeners.erase(std::remove_if(next->listeners.begin(), next->listeners.end(), [handle](auto const& l) { return l.first == handle; }), next->listeners.end());
+			bool cleared = next->listeners.empty();
+			publish(next);
+			if (cleared) {
 				if (_cb_clear) {
 					_cb_clear();
 				}
 			}
 		}
-		inline event<_args...>& operator-=(std::function<void(_args...)> listener)
+		inline event<_args...>& operator-=(uint64_t handle)
 		{
-			this->remove(listener);
+			this->remove(handle);
 			return *this;
 		}
 
@@ -120,8 +221,9 @@ namespace streamfx::util {
 		 */
 		inline bool empty()
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			return _listeners.empty();
+			reader rd(this);
+			auto   snap = rd.get();
+			return !snap || snap->listeners.empty();
 		}
 		inline operator bool()
 		{
@@ -133,7 +235,7 @@ namespace streamfx::util {
 		inline void clear()
 		{
 			std::lock_guard<std::recursive_mutex> lg(_lock);
-			_listeners.clear();
+			publish(new snapshot());
 			if (_cb_clear) {
 				_cb_clear();
 			}
@@ -0,0 +1,426 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "util-logging-binary.hpp"
+
+#include "warning-disable.hpp"
+#include <cstdio>
+#include <stdexcept>
+#include "warning-enable.hpp"
+
+// File layout:
+// - Header: "SFXBLOG" with terminator, followed by the version as uint32_t.
+// - Entries: uint8_t type, int64_t time, followed by
+//   - 'F'ormat: uint32_t id, uint8_t level, uint32_t length, format string.
+//   - 'R'ecord: uint32_t id, uint32_t length, arguments.
+//   - 'T'ext: uint8_t level, uint32_t length, text.
+static constexpr char     file_magic[8] = "SFXBLOG";
+static constexpr uint32_t file_version  = 1;
+
+namespace {
+	struct conversion {
+		std::string spec; // Flags, width and precision, without the '*'s.
+		std::string length;
+		bool        width_arg     = false;
+		bool        precision_arg = false;
+		char        type          = 0;
+		const char* end           = nullptr;
+	};
+
+	/// Parse the conversion starting after a '%'.
+	conversion parse(const char* ptr)
+	{
+		conversion conv;
+		conv.spec = "%";
+		while (*ptr && strchr("-+ #0'", *ptr)) {
+			conv.spec.push_back(*ptr++);
+		}
+		if (*ptr == '*') {
+			conv.width_arg = true;
+			conv.spec.push_back(*ptr++);
+		}
+		while ((*ptr >= '0') && (*ptr <= '9')) {
+			conv.spec.push_back(*ptr++);
+		}
+		if (*ptr == '.') {
+			conv.spec.push_back(*ptr++);
+			if (*ptr == '*') {
+				conv.precision_arg = true;
+				conv.spec.push_back(*ptr++);
+			}
+			while ((*ptr >= '0') && (*ptr <= '9')) {
+				conv.spec.push_back(*ptr++);
+			}
+		}
+
+		// The stored arguments have a fixed size, so the length modifier is replaced later.
+		while (*ptr && strchr("hljztLqI", *ptr)) {
+			if ((*ptr == 'I') && (((ptr[1] == '6') && (ptr[2] == '4')) || ((ptr[1] == '3') && (ptr[2] == '2')))) {
+				conv.length.push_back(*ptr++);
+				conv.length.push_back(*ptr++);
+			}
+			conv.length.push_back(*ptr++);
+		}
+
+		conv.type = *ptr;
+		conv.end  = *ptr ? ptr + 1 : ptr;
+		return conv;
+	}
+
+	class decoder {
+		std::string_view _data;
+
+		public:
+		decoder(std::string_view data) : _data(data) {}
+
+		bool next(streamfx::util::logging::binary::tag& type, uint64_t& value, std::string_view& text)
+		{
+			if (_data.empty()) {
+				return false;
+			}
+
+			type = static_cast<streamfx::util::logging::binary::tag>(_data[0]);
+			_data.remove_prefix(1);
+			if (type == streamfx::util::logging::binary::tag::STRING) {
+				uint32_t length = 0;
+				if (_data.size() < sizeof(length)) {
+					return false;
+				}
+				memcpy(&length, _data.data(), sizeof(length));
+				_data.remove_prefix(sizeof(length));
+				if (_data.size() < length) {
+					return false;
+				}
+				text = _data.substr(0, length);
+				_data.remove_prefix(length);
+			} else {
+				if (_data.size() < sizeof(value)) {
+					return false;
+				}
+				memcpy(&value, _data.data(), sizeof(value));
+				_data.remove_prefix(sizeof(value));
+			}
+			return true;
+		}
+	};
+
+	template<typename... Args>
+	void append(std::string& out, std::string const& spec, Args... args)
+	{
+		int size = snprintf(nullptr, 0, spec.c_str(), args...);
+		if (size > 0) {
+			size_t offset = out.size();
+			out.resize(offset + static_cast<size_t>(size) + 1);
+			snprintf(out.data() + offset, static_cast<size_t>(size) + 1, spec.c_str(), args...);
+			out.resize(offset + static_cast<size_t>(size));
+		}
+	}
+} // namespace
+
+void streamfx::util::logging::binary::encoder::put_wide(const wchar_t* text)
+{
+	std::string utf8;
+	for (const wchar_t* ptr = text; *ptr; ptr++) {
+		uint32_t cp = static_cast<uint32_t>(*ptr);
+		if ((cp >= 0xD800) && (cp < 0xDC00) && (ptr[1] >= 0xDC00) && (ptr[1] < 0xE000)) { // UTF-16 surrogate pair.
+			cp = 0x10000 + ((cp - 0xD800) << 10) + (static_cast<uint32_t>(ptr[1]) - 0xDC00);
+			ptr++;
+		}
+
+		if (cp < 0x80) {
+			utf8.push_back(static_cast<char>(cp));
+		} else if (cp < 0x800) {
+			utf8.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+			utf8.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+		} else if (cp < 0x10000) {
+			utf8.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+			utf8.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+			utf8.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+		} else {
+			utf8.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+			utf8.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+			utf8.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+			utf8.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+		}
+	}
+
+	uint32_t length = static_cast<uint32_t>(utf8.size());
+	put(tag::STRING, &length, sizeof(length));
+	_out.append(utf8);
+}
+
+uint64_t streamfx::util::logging::binary::find_bounded_strings(const char* format)
+{
+	uint64_t result = 0;
+	size_t   index  = 0;
+	for (const char* ptr = format; *ptr; ptr++) {
+		if (*ptr != '%') {
+			continue;
+		} else if (ptr[1] == '%') {
+			ptr++;
+			continue;
+		}
+
+		auto conv = parse(ptr + 1);
+		index += conv.width_arg ? 1 : 0;
+		index += conv.precision_arg ? 1 : 0;
+		if ((conv.type == 's') && conv.precision_arg && (index < 64)) {
+			result |= uint64_t(1) << index;
+		}
+		index += (conv.type == 0) ? 0 : 1;
+		ptr = conv.end - 1;
+	}
+	return result;
+}
+
+std::string streamfx::util::logging::binary::format(const char* format, std::string_view arguments)
+{
+	std::string result;
+	result.reserve(strlen(format) + arguments.size());
+
+	decoder          args(arguments);
+	tag              type;
+	uint64_t         value;
+	std::string_view text;
+
+	// The '*' of width and precision is replaced with the value of its argument.
+	auto take_int = [&](std::string& spec) {
+		auto pos = spec.find('*');
+		if (args.next(type, value, text) && ((type == tag::SIGNED) || (type == tag::UNSIGNED))) {
+			spec.replace(pos, 1, std::to_string(static_cast<int>(value)));
+		} else {
+			spec.erase(pos, 1);
+		}
+	};
+
+	for (const char* ptr = format; *ptr; ptr++) {
+		if (*ptr != '%') {
+			result.push_back(*ptr);
+			continue;
+		} else if (ptr[1] == '%') {
+			result.push_back('%');
+			ptr++;
+			continue;
+		}
+
+		auto conv = parse(ptr + 1);
+		ptr       = conv.end - 1;
+		if (conv.width_arg) {
+			take_int(conv.spec);
+		}
+		if (conv.precision_arg) {
+			take_int(conv.spec);
+		}
+		if (conv.type == 0) {
+			break;
+		} else if (conv.type == 'n') {
+			args.next(type, value, text);
+			continue;
+		}
+
+		if (!args.next(type, value, text)) {
+			result.append("<?>");
+			continue;
+		}
+
+		bool integer = (type == tag::SIGNED) || (type == tag::UNSIGNED);
+		switch (conv.type) {
+		case 'd':
+		case 'i':
+			if (integer) {
+				append(result, conv.spec + "lld", static_cast<long long>(value));
+				continue;
+			}
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			if (integer || (type == tag::POINTER)) {
+				// Negative values were sign extended, so they have to be cut back to the size printf would have read.
+				if (conv.length.empty()) {
+					value &= 0xFFFFFFFFull;
+				} else if (conv.length == "h") {
+					value &= 0xFFFFull;
+				} else if (conv.length == "hh") {
+					value &= 0xFFull;
+				}
+				append(result, conv.spec + "ll" + conv.type, static_cast<unsigned long long>(value));
+				continue;
+			}
+			break;
+		case 'c':
+			if (integer) {
+				append(result, conv.spec + "c", static_cast<int>(value));
+				continue;
+			}
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			if (type == tag::REAL) {
+				double real;
+				memcpy(&real, &value, sizeof(real));
+				append(result, conv.spec + conv.type, real);
+				continue;
+			}
+			break;
+		case 's':
+			if (type == tag::STRING) {
+				append(result, conv.spec + "s", std::string(text).c_str());
+				continue;
+			}
+			break;
+		case 'p':
+			if ((type == tag::POINTER) || integer) {
+				append(result, conv.spec + "p", reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+				continue;
+			}
+			break;
+		}
+		result.append("<?>");
+	}
+
+	return result;
+}
+
+streamfx::util::logging::binary::writer::writer(std::filesystem::path const& path) : _stream(path, std::ios::binary | std::ios::trunc), _known()
+{
+	if (!_stream) {
+		throw std::runtime_error("Failed to open file for writing.");
+	}
+
+	_stream.write(file_magic, sizeof(file_magic));
+	_stream.write(reinterpret_cast<const char*>(&file_version), sizeof(file_version));
+}
+
+streamfx::util::logging::binary::writer::~writer()
+{
+	_stream.flush();
+}
+
+void streamfx::util::logging::binary::writer::write(uint32_t id, uint8_t level, const char* format, int64_t time, std::string_view arguments)
+{
+	// Each format string is written once, right before the first message using it.
+	if (_known.size() <= id) {
+		_known.resize(id + 1, false);
+	}
+	if (!_known[id]) {
+		uint32_t length = static_cast<uint32_t>(strlen(format));
+		_stream.put('F');
+		_stream.write(reinterpret_cast<const char*>(&time), sizeof(time));
+		_stream.write(reinterpret_cast<const char*>(&id), sizeof(id));
+		_stream.put(static_cast<char>(level));
+		_stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+		_stream.write(format, length);
+		_known[id] = true;
+	}
+
+	uint32_t length = static_cast<uint32_t>(arguments.size());
+	_stream.put('R');
+	_stream.write(reinterpret_cast<const char*>(&time), sizeof(time));
+	_stream.write(reinterpret_cast<const char*>(&id), sizeof(id));
+	_stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	_stream.write(arguments.data(), length);
+}
+
+void streamfx::util::logging::binary::writer::write(uint8_t level, int64_t time, std::string_view text)
+{
+	uint32_t length = static_cast<uint32_t>(text.size());
+	_stream.put('T');
+	_stream.write(reinterpret_cast<const char*>(&time), sizeof(time));
+	_stream.put(static_cast<char>(level));
+	_stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	_stream.write(text.data(), length);
+}
+
+void streamfx::util::logging::binary::writer::flush()
+{
+	_stream.flush();
+}
+
+streamfx::util::logging::binary::reader::reader(std::filesystem::path const& path) : _stream(path, std::ios::binary), _formats()
+{
+	if (!_stream) {
+		throw std::runtime_error("Failed to open file for reading.");
+	}
+
+	char     magic[sizeof(file_magic)] = {};
+	uint32_t version                   = 0;
+	_stream.read(magic, sizeof(magic));
+	_stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+	if (!_stream || (memcmp(magic, file_magic, sizeof(magic)) != 0)) {
+		throw std::runtime_error("Not a binary StreamFX log.");
+	} else if (version != file_version) {
+		throw std::runtime_error("Unsupported version or byte order.");
+	}
+}
+
+streamfx::util::logging::binary::reader::~reader() {}
+
+bool streamfx::util::logging::binary::reader::next(message& msg)
+{
+	auto read_string = [this](std::string& out) {
+		uint32_t length = 0;
+		_stream.read(reinterpret_cast<char*>(&length), sizeof(length));
+		out.resize(length);
+		_stream.read(out.data(), length);
+	};
+
+	while (true) {
+		int type = _stream.get();
+		if (type == std::char_traits<char>::eof()) {
+			return false;
+		}
+
+		_stream.read(reinterpret_cast<char*>(&msg.time), sizeof(msg.time));
+		if (type == 'F') {
+			uint32_t    id    = 0;
+			uint8_t     level = 0;
+			std::string format;
+			_stream.read(reinterpret_cast<char*>(&id), sizeof(id));
+			_stream.read(reinterpret_cast<char*>(&level), sizeof(level));
+			read_string(format);
+			_formats[id] = {level, std::move(format)};
+		} else if (type == 'R') {
+			uint32_t    id = 0;
+			std::string arguments;
+			_stream.read(reinterpret_cast<char*>(&id), sizeof(id));
+			read_string(arguments);
+			if (!_stream) {
+				break;
+			}
+
+			if (auto kv = _formats.find(id); kv != _formats.end()) {
+				msg.level = kv->second.first;
+				msg.text  = binary::format(kv->second.second.c_str(), arguments);
+			} else {
+				msg.level = 0;
+				msg.text  = "<Unknown format " + std::to_string(id) + ">";
+			}
+			return true;
+		} else if (type == 'T') {
+			_stream.read(reinterpret_cast<char*>(&msg.level), sizeof(msg.level));
+			read_string(msg.text);
+			if (!_stream) {
+				break;
+			}
+			return true;
+		} else {
+			throw std::runtime_error("File is corrupted.");
+		}
+
+		if (!_stream) {
+			break;
+		}
+	}
+
+	// A log that was still being written, or cut short by a crash, ends in a partial entry.
+	return false;
+}
@@ -0,0 +1,154 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "warning-enable.hpp"
+
+/** Deferred formatting of log messages.
+ *
+ * Instead of formatting a message where it is logged, only its arguments are stored. They are turned into text later on
+ * by format(), either by the logging thread or by the decoder tool reading a binary log written by writer.
+ *
+ * This must not depend on libobs, as the decoder tool is built without it.
+ */
+namespace streamfx::util::logging::binary {
+	enum class tag : uint8_t {
+		SIGNED   = 'i',
+		UNSIGNED = 'u',
+		REAL     = 'd',
+		STRING   = 's',
+		POINTER  = 'p',
+	};
+
+	/** Find the arguments of a format string which are strings with the precision given by the argument before them.
+	 *
+	 * Such strings ('%.*s') are not required to be terminated, so they may only be read up to that length.
+	 *
+	 * @return Bit N is set if argument N is such a string.
+	 */
+	uint64_t find_bounded_strings(const char* format);
+
+	/** Stores arguments to be formatted later. Only accepts what can be passed to printf.
+	 */
+	class encoder {
+		std::string& _out;
+		uint64_t     _bounded;
+		size_t       _index;
+		int64_t      _previous;
+
+		void put(tag type, const void* data, size_t size)
+		{
+			_out.push_back(static_cast<char>(type));
+			_out.append(static_cast<const char*>(data), size);
+		}
+
+		/// Wide strings ('%ls') are stored as UTF-8.
+		void put_wide(const wchar_t* text);
+
+		public:
+		encoder(std::string& out, uint64_t bounded) : _out(out), _bounded(bounded), _index(0), _previous(-1) {}
+
+		template<typename T>
+		encoder& operator<<(T value)
+		{
+			if constexpr (std::is_enum_v<T>) {
+				return *this << static_cast<std::underlying_type_t<T>>(value);
+			} else {
+				if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+					const char* text = value ? value : "(null)";
+					size_t      size = 0;
+					if (value && (_index < 64) && ((_bounded >> _index) & 1)) {
+						size = strnlen(text, static_cast<size_t>(std::max<int64_t>(_previous, 0)));
+					} else {
+						size = strlen(text);
+					}
+					uint32_t length = static_cast<uint32_t>(size);
+					put(tag::STRING, &length, sizeof(length));
+					_out.append(text, size);
+				} else if constexpr (std::is_same_v<T, const wchar_t*> || std::is_same_v<T, wchar_t*>) {
+					put_wide(value ? value : L"(null)");
+				} else if constexpr (std::is_same_v<T, bool> || (std::is_integral_v<T> && std::is_unsigned_v<T>)) {
+					uint64_t v = static_cast<uint64_t>(value);
+					_previous  = static_cast<int64_t>(v);
+					put(tag::UNSIGNED, &v, sizeof(v));
+				} else if constexpr (std::is_integral_v<T>) {
+					int64_t v = static_cast<int64_t>(value);
+					_previous = v;
+					put(tag::SIGNED, &v, sizeof(v));
+				} else if constexpr (std::is_floating_point_v<T>) {
+					double v = static_cast<double>(value);
+					put(tag::REAL, &v, sizeof(v));
+				} else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) {
+					uint64_t v = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(static_cast<const void*>(value)));
+					put(tag::POINTER, &v, sizeof(v));
+				} else {
+					static_assert(std::is_pointer_v<T>, "Type can not be passed to a log message.");
+				}
+				_index++;
+				return *this;
+			}
+		}
+	};
+
+	/** Format stored arguments like printf would have.
+	 *
+	 * Arguments that are missing or don't fit their conversion are replaced with '<?>'.
+	 */
+	std::string format(const char* format, std::string_view arguments);
+
+	/** Binary log file, containing each format string once followed by the arguments of each message.
+	 *
+	 * Values are stored in the byte order of the machine that wrote the file.
+	 */
+	class writer {
+		std::ofstream     _stream;
+		std::vector<bool> _known;
+
+		public:
+		writer(std::filesystem::path const& path);
+		~writer();
+
+		/// Write a message logged with a registered format string.
+		void write(uint32_t id, uint8_t level, const char* format, int64_t time, std::string_view arguments);
+
+		/// Write a message that is already text.
+		void write(uint8_t level, int64_t time, std::string_view text);
+
+		void flush();
+	};
+
+	class reader {
+		std::ifstream                                                 _stream;
+		std::unordered_map<uint32_t, std::pair<uint8_t, std::string>> _formats;
+
+		public:
+		struct message {
+			/// Nanoseconds since the epoch of the system clock.
+			int64_t     time;
+			uint8_t     level;
+			std::string text;
+		};
+
+		public:
+		reader(std::filesystem::path const& path);
+		~reader();
+
+		/** Read and format the next message.
+		 *
+		 * @return false at the end of the file.
+		 */
+		bool next(message& msg);
+	};
+} // namespace streamfx::util::logging::binary
@@ -5,32 +5,468 @@
 
 #include "util-logging.hpp"
 #include "common.hpp"
+#include "plugin.hpp"
+#include "util-bounded-queue.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <stdarg.h>
+#include <string>
+#include <thread>
+#include <vector>
 #include "warning-enable.hpp"
 
-void streamfx::util::logging::log(level lvl, const char* format, ...)
-{
-	const static std::map<level, int32_t> level_map = {
-		{level::LEVEL_DEBUG, LOG_DEBUG},
-		{level::LEVEL_INFO, LOG_INFO},
-		{level::LEVEL_WARN, LOG_WARNING},
-		{level::LEVEL_ERROR, LOG_ERROR},
+#if defined(D_PLATFORM_WINDOWS)
+#include "warning-disable.hpp"
+#include <Windows.h>
+#include "warning-enable.hpp"
+#elif defined(D_PLATFORM_LINUX)
+#include "warning-disable.hpp"
+#include <pthread.h>
+#include "warning-enable.hpp"
+#endif
+
+namespace {
+	/// Messages a call site may burst before being limited.
+	constexpr uint64_t rate_burst = 64;
+
+	/// Messages a call site may burst at the informational level, which is where settings are dumped at startup.
+	constexpr uint64_t rate_burst_info = 4096;
+
+	/// Messages per second a call site may log once its burst is used up.
+	constexpr uint64_t rate_refill = 4;
+
+	/// Call sites that are tracked for rate limiting, any further ones are not limited.
+	constexpr size_t rate_sites = 512;
+
+	/// Messages that can wait for the background thread, any further ones are dropped.
+	constexpr size_t queue_size = 4096;
+
+	/// Repeats of the same message are reported at least this often.
+	constexpr auto repeat_interval = std::chrono::seconds(1);
+
+	int64_t now_ms()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void emit(streamfx::util::logging::level lvl, const char* text)
+	{
+		int32_t obs_level = LOG_INFO;
+		switch (lvl) {
+		case streamfx::util::logging::level::LEVEL_DEBUG:
+			obs_level = LOG_DEBUG;
+			break;
+		case streamfx::util::logging::level::LEVEL_INFO:
+			obs_level = LOG_INFO;
+			break;
+		case streamfx::util::logging::level::LEVEL_WARN:
+			obs_level = LOG_WARNING;
+			break;
+		case streamfx::util::logging::level::LEVEL_ERROR:
+			obs_level = LOG_ERROR;
+			break;
+		}
+		blog(obs_level, "[StreamFX] %s", text);
+	}
+
+	/** Token bucket per call site, identified by the address of its registration.
+	 *
+	 * Format strings can't be used for this, as the compiler merges identical ones from different call sites. The state
+	 * packs the time of the last refill in milliseconds into the upper 40 bits, and the available tokens in thousandths
+	 * into the lower 24 bits, so that it can be updated with a single compare-and-swap.
+	 */
+	struct rate_site {
+		std::atomic<void const*> key{nullptr};
+		std::atomic<uint64_t>    state{0};
+		std::atomic<uint64_t>    suppressed{0};
+	};
+
+	std::array<rate_site, rate_sites> rate_table;
+
+	/// Returns false if the message should be dropped, otherwise how many messages were dropped before it.
+	bool rate_limit(void const* site, streamfx::util::logging::level lvl, uint64_t& suppressed)
+	{
+		constexpr uint64_t token = 1000;
+		constexpr uint64_t mask  = 0xFFFFFF;
+		static_assert((std::max(rate_burst, rate_burst_info) * token) <= mask, "Token count must fit into 24 bits.");
+		uint64_t full = ((lvl == streamfx::util::logging::level::LEVEL_INFO) ? rate_burst_info : rate_burst) * token;
+
+		// Find or claim the slot of this call site, giving up after a few probes.
+		size_t     hash = std::hash<void const*>{}(site);
+		rate_site* slot = nullptr;
+		for (size_t probe = 0; probe < 8; probe++) {
+			auto&       entry = rate_table[(hash + probe) % rate_sites];
+			void const* key   = entry.key.load(std::memory_order_acquire);
+			if ((key == site) || ((key == nullptr) && (entry.key.compare_exchange_strong(key, site, std::memory_order_acq_rel) || (key == site)))) {
+				slot = &entry;
+				break;
+			}
+		}
+		if (!slot) {
+			suppressed = 0;
+			return true;
+		}
+
+		uint64_t now   = static_cast<uint64_t>(now_ms());
+		uint64_t state = slot->state.load(std::memory_order_relaxed);
+		while (true) {
+			uint64_t last   = state >> 24;
+			uint64_t tokens = (state == 0) ? full : (state & mask);
+			if (now > last) {
+				tokens = std::min(full, tokens + (now - last) * rate_refill);
+			}
+
+			bool     allowed = tokens >= token;
+			uint64_t next    = (std::max(now, last) << 24) | (allowed ? (tokens - token) : tokens);
+			if (slot->state.compare_exchange_weak(state, next, std::memory_order_relaxed)) {
+				if (!allowed) {
+					slot->suppressed.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				suppressed = slot->suppressed.exchange(0, std::memory_order_relaxed);
+				return true;
+			}
+		}
+	}
+
+	/// Highest number of call sites that can defer formatting, any further ones format on the calling thread.
+	constexpr size_t max_sites = 8192;
+
+	struct site_info {
+		streamfx::util::logging::level lvl;
+		const char*                    format;
+	};
+
+	std::array<site_info, max_sites> site_table;
+	uint32_t                         site_count = 0;
+	std::mutex                       site_lock;
+
+	int64_t now_system()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	struct message {
+		streamfx::util::logging::level lvl        = streamfx::util::logging::level::LEVEL_INFO;
+		uint32_t                       id         = 0; // 0 if data is text, otherwise the arguments for this call site.
+		int64_t                        time       = 0;
+		uint64_t                       suppressed = 0;
+		std::string                    data;
+	};
+
+	struct async_state {
+		streamfx::util::bounded_queue<message> queue{queue_size};
+		std::atomic<uint64_t>                  dropped{0};
+		std::atomic<size_t>                    producers{0};
+		std::atomic<bool>                      enabled{false};
+		std::atomic<bool>                      sleeping{false};
+		std::mutex                             lock;
+		std::condition_variable                cv;
+		bool                                   stop = false;
+		std::thread                            worker;
+
+		// Only used by the worker.
+		std::unique_ptr<streamfx::util::logging::binary::writer> writer;
+		message                                                  last;
+		uint64_t                                                 repeats      = 0;
+		int64_t                                                  repeats_time = 0;
+
+		void output(streamfx::util::logging::level lvl, std::string const& text)
+		{
+			if (writer) {
+				writer->write(static_cast<uint8_t>(lvl), now_system(), text);
+			} else {
+				emit(lvl, text.c_str());
+			}
+		}
+
+		void output(message const& msg)
+		{
+			if (msg.id == 0) {
+				output(msg.lvl, msg.data);
+			} else if (writer) {
+				writer->write(msg.id, static_cast<uint8_t>(msg.lvl), site_table[msg.id].format, msg.time, msg.data);
+			} else {
+				emit(msg.lvl, streamfx::util::logging::binary::format(site_table[msg.id].format, msg.data).c_str());
+			}
+
+			if (msg.suppressed > 0) {
+				output(msg.lvl, std::to_string(msg.suppressed) + " similar messages were suppressed.");
+			}
+		}
+
+		void flush_repeats()
+		{
+			if (repeats > 0) {
+				output(last.lvl, "Last message repeated " + std::to_string(repeats) + " times.");
+				repeats = 0;
+			}
+		}
+
+		void drain()
+		{
+			message msg;
+			while (queue.try_pop(msg)) {
+				// Collapse a message that is repeated over and over into a single line every so often.
+				if ((msg.lvl == last.lvl) && (msg.id == last.id) && (msg.suppressed == 0) && (msg.data == last.data)) {
+					if (repeats == 0) {
+						repeats_time = now_ms();
+					}
+					repeats++;
+					continue;
+				}
+
+				flush_repeats();
+				output(msg);
+				std::swap(last, msg);
+			}
+
+			if ((repeats > 0) && ((now_ms() - repeats_time) >= std::chrono::duration_cast<std::chrono::milliseconds>(repeat_interval).count())) {
+				flush_repeats();
+			}
+
+			if (uint64_t count = dropped.exchange(0, std::memory_order_relaxed); count > 0) {
+				flush_repeats();
+				output(streamfx::util::logging::level::LEVEL_WARN, "Dropped " + std::to_string(count) + " messages as the log could not keep up.");
+			}
+
+			if (writer) {
+				writer->flush();
+			}
+		}
+
+		/** Hand a message to the worker, unless logging is synchronous.
+		 *
+		 * @return false if logging is synchronous, in which case `msg` is left untouched.
+		 */
+		bool enqueue(message& msg)
+		{
+			// Pairs with work(): either we see that logging went synchronous, or the worker waits for us to finish.
+			producers.fetch_add(1, std::memory_order_seq_cst);
+			if (!enabled.load(std::memory_order_seq_cst)) {
+				producers.fetch_sub(1, std::memory_order_release);
+				return false;
+			}
+
+			// Logging must never block the caller, so a full queue drops the message.
+			if (!queue.try_push(std::move(msg))) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+			} else if (sleeping.load(std::memory_order_relaxed)) {
+				cv.notify_one();
+			}
+			producers.fetch_sub(1, std::memory_order_release);
+			return true;
+		}
+
+		void work()
+		{
+#if defined(D_PLATFORM_WINDOWS)
+			SetThreadDescription(GetCurrentThread(), L"StreamFX Logging Thread");
+#elif defined(D_PLATFORM_LINUX)
+			pthread_setname_np(pthread_self(), "StreamFX Log");
+#endif
+
+			std::unique_lock<std::mutex> ul(lock);
+			while (!stop) {
+				ul.unlock();
+				drain();
+				ul.lock();
+
+				// Producers don't take the lock, so a wake up may be missed. The timeout bounds how late a message can be.
+				sleeping.store(true);
+				cv.wait_for(ul, std::chrono::milliseconds(50));
+				sleeping.store(false);
+			}
+			ul.unlock();
+
+			// Messages from threads that saw logging enabled just before it was stopped are still on their way.
+			while (producers.load(std::memory_order_seq_cst) != 0) {
+				std::this_thread::yield();
+			}
+
+			drain();
+			flush_repeats();
+			writer.reset();
+		}
 	};
+
+	async_state& get_async()
+	{
+		static async_state instance;
+		return instance;
+	}
+} // namespace
+
+static void log_v(void const* key, streamfx::util::logging::level lvl, const char* format, va_list vargs)
+{
 	thread_local static std::vector<char> buffer;
 
-	va_list vargs;
-	va_start(vargs, format);
+	uint64_t suppressed = 0;
+	if (key && !rate_limit(key, lvl, suppressed)) {
+		return;
+	}
 
 	va_list vargs_copy;
 	va_copy(vargs_copy, vargs);
 	int32_t ret = vsnprintf(buffer.data(), buffer.size(), format, vargs);
 	buffer.resize(static_cast<size_t>(ret) + 1);
 	ret = vsnprintf(buffer.data(), buffer.size(), format, vargs_copy);
+	va_end(vargs_copy);
+
+	std::string text(buffer.data(), static_cast<size_t>(std::max<int32_t>(ret, 0)));
+	if (suppressed > 0) {
+		text += " (" + std::to_string(suppressed) + " similar messages were suppressed)";
+	}
+
+	message msg;
+	msg.lvl  = lvl;
+	msg.time = now_system();
+	msg.data = std::move(text);
+	if (get_async().enqueue(msg)) {
+		return;
+	}
 
+	emit(lvl, msg.data.c_str());
+}
+
+void streamfx::util::logging::log(level lvl, const char* format, ...)
+{
+	va_list vargs;
+	va_start(vargs, format);
+	log_v(nullptr, lvl, format, vargs);
 	va_end(vargs);
-	va_end(vargs_copy);
+}
 
-	blog(level_map.at(lvl), "[StreamFX] %s", buffer.data());
+void streamfx::util::logging::log(site& where, level lvl, const char* format, ...)
+{
+	va_list vargs;
+	va_start(vargs, format);
+	log_v(&where, lvl, format, vargs);
+	va_end(vargs);
 }
+
+uint32_t streamfx::util::logging::register_site(site& where, level lvl, const char* format)
+{
+	std::lock_guard<std::mutex> lg(site_lock);
+	if (uint32_t id = where.id.load(std::memory_order_relaxed); id != 0) {
+		return id;
+	} else if ((site_count + 1) >= max_sites) {
+		return 0;
+	}
+
+	uint32_t id    = ++site_count;
+	site_table[id] = {lvl, format};
+	where.bounded  = binary::find_bounded_strings(format);
+	where.id.store(id, std::memory_order_release);
+	return id;
+}
+
+void streamfx::util::logging::record(uint32_t id, level lvl, const char* format, std::string&& arguments)
+{
+	uint64_t suppressed = 0;
+	if (!rate_limit(&site_table[id], lvl, suppressed)) {
+		return;
+	}
+
+	message msg;
+	msg.lvl        = lvl;
+	msg.id         = id;
+	msg.time       = now_system();
+	msg.suppressed = suppressed;
+	msg.data       = std::move(arguments);
+	if (get_async().enqueue(msg)) {
+		return;
+	}
+
+	std::string text = binary::format(format, msg.data);
+	if (suppressed > 0) {
+		text += " (" + std::to_string(suppressed) + " similar messages were suppressed)";
+	}
+	emit(lvl, text.c_str());
+}
+
+void streamfx::util::logging::start_async(std::filesystem::path const& binary_path)
+{
+	auto&                       async = get_async();
+	std::lock_guard<std::mutex> lg(async.lock);
+	if (async.worker.joinable()) {
+		return;
+	}
+
+	if (!binary_path.empty()) {
+		async.writer = std::make_unique<binary::writer>(binary_path);
+	}
+
+	async.stop   = false;
+	async.worker = std::thread(std::bind(&async_state::work, &async));
+	async.enabled.store(true, std::memory_order_release);
+}
+
+void streamfx::util::logging::stop_async()
+{
+	auto& async = get_async();
+	{
+		std::lock_guard<std::mutex> lg(async.lock);
+		if (!async.worker.joinable()) {
+			return;
+		}
+		async.enabled.store(false, std::memory_order_seq_cst);
+		async.stop = true;
+		async.cv.notify_all();
+	}
+
+	// Anything that was queued before logging went back to synchronous is written before this returns.
+	async.worker.join();
+}
+
+static std::string loader_getenv(const char* name)
+{
+#if defined(D_PLATFORM_WINDOWS)
+	char*       env_value     = nullptr;
+	size_t      env_value_len = 0;
+	std::string result;
+	if ((_dupenv_s(&env_value, &env_value_len, name) == 0) && env_value) {
+		result = env_value;
+	}
+	free(env_value);
+	return result;
+#else
+	const char* env_value = getenv(name);
+	return env_value ? env_value : "";
+#endif
+}
+
+static auto loader = streamfx::component(
+	"core::logging",
+	[]() { // Initializer
+		// Writing the log on the calling thread is easier to follow while debugging a crash.
+		if (!loader_getenv("STREAMFX_LOG_SYNC").empty()) {
+			return;
+		}
+
+		// Verbose logging is nearly free if the messages are only decoded later on.
+		if (auto path = loader_getenv("STREAMFX_LOG_BINARY"); !path.empty()) {
+			try {
+				streamfx::util::logging::start_async(std::filesystem::path(path));
+				emit(streamfx::util::logging::level::LEVEL_INFO, ("Writing log to binary file '" + path + "'.").c_str());
+				return;
+			} catch (std::exception const& ex) {
+				emit(streamfx::util::logging::level::LEVEL_ERROR, ("Failed to create binary log '" + path + "': " + ex.what()).c_str());
+			}
+		}
+
+		streamfx::util::logging::start_async();
+	},
+	[]() { // Finalizer
+		streamfx::util::logging::stop_async();
+	},
+	{}, streamfx::loader_priority::HIGHEST);
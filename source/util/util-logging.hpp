@@ -3,12 +3,41 @@
 // AUTOGENERATED COPYRIGHT HEADER END
 
 #pragma once
+#include "util-logging-binary.hpp"
+
 #include "warning-disable.hpp"
+#include <atomic>
 #include <cinttypes>
 #include <cstdint>
+#include <filesystem>
+#include <string>
 #include "warning-enable.hpp"
 
-#define P_LOG(...) streamfx::util::logging::log(__VA_ARGS__);
+extern "C" {
+#include "warning-disable.hpp"
+#include <util/c99defs.h>
+#include "warning-enable.hpp"
+}
+
+// Checks the format against the arguments at compile time, even though formatting happens later on. Call sites that pass
+// an unused nullptr to satisfy their D_LOG_ macros are fine.
+#if defined(__GNUC__) || defined(__clang__)
+#define P_LOG_CHECK_FORMAT(...)                                       \
+	_Pragma("GCC diagnostic push")                                    \
+	_Pragma("GCC diagnostic ignored \"-Wformat-extra-args\"")         \
+	(void)sizeof(streamfx::util::logging::check_format(__VA_ARGS__)); \
+	_Pragma("GCC diagnostic pop")
+#else
+#define P_LOG_CHECK_FORMAT(...)
+#endif
+
+// The format must be a string literal, as it is only looked at the first time a call site is reached.
+#define P_LOG(LEVEL, ...)                                                 \
+	{                                                                     \
+		static streamfx::util::logging::site _p_log_site;                 \
+		P_LOG_CHECK_FORMAT(__VA_ARGS__)                                   \
+		streamfx::util::logging::record(_p_log_site, LEVEL, __VA_ARGS__); \
+	}
 #define P_LOG_ERROR(...) P_LOG(streamfx::util::logging::level::LEVEL_ERROR, __VA_ARGS__)
 #define P_LOG_WARN(...) P_LOG(streamfx::util::logging::level::LEVEL_WARN, __VA_ARGS__)
 #define P_LOG_INFO(...) P_LOG(streamfx::util::logging::level::LEVEL_INFO, __VA_ARGS__)
@@ -41,5 +70,64 @@ namespace streamfx::util::logging {
 		LEVEL_ERROR, // Errors that must be fixed.
 	};
 
-	void log(level lvl, const char* format, ...);
+	/** Registration of a call site of P_LOG or DLOG_, constant initialized so that it costs nothing until first used.
+	 */
+	struct site {
+		std::atomic<uint32_t> id{0};
+		uint64_t              bounded = 0;
+	};
+
+	/** Write a message to the log, without any rate limit.
+	 *
+	 * While asynchronous logging is active, the message is only formatted on the calling thread and written by a
+	 * background thread, which also collapses repeats.
+	 */
+	PRINTFATTR(2, 3) void log(level lvl, const char* format, ...);
+
+	/** Write a message to the log from the given call site.
+	 *
+	 * Each call site may only log a burst of messages before being limited to a few per second, the number of messages
+	 * that were dropped is appended to the next one that gets through. Informational messages get a much larger burst,
+	 * so that settings and capabilities dumped at startup make it into the log in full.
+	 */
+	PRINTFATTR(3, 4) void log(site& where, level lvl, const char* format, ...);
+
+	/// Never called, only lets the compiler check the format and arguments of P_LOG within an unevaluated operand.
+	PRINTFATTR(1, 2) int check_format(const char* format, ...);
+
+	/// Assign an id to a call site, returns 0 if there are no ids left.
+	uint32_t register_site(site& where, level lvl, const char* format);
+
+	/// Log a message whose arguments were stored by binary::encoder.
+	void record(uint32_t id, level lvl, const char* format, std::string&& arguments);
+
+	/** Write a message to the log, but defer formatting it to the background thread.
+	 *
+	 * Only the arguments are stored on the calling thread, which is a lot cheaper than formatting them.
+	 */
+	template<typename... Args>
+	inline void record(site& where, level lvl, const char* format, Args... args)
+	{
+		uint32_t id = where.id.load(std::memory_order_acquire);
+		if ((id == 0) && ((id = register_site(where, lvl, format)) == 0)) {
+			log(where, lvl, format, args...);
+			return;
+		}
+
+		std::string     arguments;
+		binary::encoder enc(arguments, where.bounded);
+		(void)(enc << ... << args);
+		record(id, lvl, format, std::move(arguments));
+	}
+
+	/** Write messages from a background thread from now on.
+	 *
+	 * @param binary_path If not empty, deferred messages are written to this file without being formatted, and need to be
+	 *                    decoded with the log decoder tool. Throws if the file can't be created.
+	 */
+	void start_async(std::filesystem::path const& binary_path = {});
+
+	/** Write all queued messages, then go back to writing messages on the calling thread.
+	 */
+	void stop_async();
 } // namespace streamfx::util::logging
@@ -0,0 +1,193 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "util/util-threadpool.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include "warning-enable.hpp"
+
+namespace streamfx::util::threadpool {
+	struct parallel_options {
+		/// Pool to run on, defaults to the global instance.
+		std::shared_ptr<threadpool> pool = nullptr;
+
+		/// Priority class for helper tasks.
+		priority klass = priority::interactive;
+
+		/// Maximum number of threads working on the range, including the caller. 0 uses the concurrency of the pool plus
+		/// the caller.
+		size_t threads = 0;
+
+		/// Smallest number of elements handed out at once.
+		size_t grain = 1;
+
+		/// Size of a single element in bytes. If set, chunk boundaries are placed on cache line boundaries, so that no two
+		/// threads write to the same cache line.
+		size_t element_size = 0;
+	};
+
+	namespace detail {
+#if __cpp_lib_hardware_interference_size >= 201603
+		constexpr size_t cache_line_size = std::hardware_destructive_interference_size;
+#else
+		constexpr size_t cache_line_size = 64;
+#endif
+
+		template<typename _callable>
+		struct parallel_state {
+			_callable* fn;
+			size_t     end;
+			size_t     grain;
+			size_t     alignment;
+			size_t     participants;
+
+			alignas(cache_line_size) std::atomic<size_t> next;
+			alignas(cache_line_size) std::atomic<size_t> completed;
+
+			std::atomic<bool>  failed;
+			std::mutex         exception_lock;
+			std::exception_ptr exception;
+
+			/** Claim the next chunk, using guided self-scheduling.
+			 *
+			 * Chunks start large and shrink as the range runs out, which keeps overhead low while still balancing the tail
+			 * between threads that finish at different times.
+			 */
+			bool claim(size_t& chunk_begin, size_t& chunk_end)
+			{
+				size_t current = next.load(std::memory_order_relaxed);
+				do {
+					if (current >= end) {
+						return false;
+					}
+
+					size_t remaining = end - current;
+					size_t size      = std::max(grain, remaining / (participants * 2));
+					chunk_end        = std::min(end, current + size);
+					if (alignment > 1) {
+						chunk_end = std::min(end, ((chunk_end + alignment - 1) / alignment) * alignment);
+					}
+				} while (!next.compare_exchange_weak(current, chunk_end, std::memory_order_relaxed));
+
+				chunk_begin = current;
+				return true;
+			}
+
+			void work()
+			{
+				size_t chunk_begin, chunk_end;
+				while (claim(chunk_begin, chunk_end)) {
+					if (!failed.load(std::memory_order_relaxed)) {
+						try {
+							(*fn)(chunk_begin, chunk_end);
+						} catch (...) {
+							std::lock_guard<std::mutex> lg(exception_lock);
+							if (!exception) {
+								exception = std::current_exception();
+							}
+							failed = true;
+						}
+					}
+
+					if (completed.fetch_add(chunk_end - chunk_begin, std::memory_order_acq_rel) + (chunk_end - chunk_begin) == end) {
+						completed.notify_all();
+					}
+				}
+			}
+		};
+	} // namespace detail
+
+	/** Run `fn(chunk_begin, chunk_end)` over the range [begin, end) on multiple threads.
+	 *
+	 * The calling thread works on the range as well instead of blocking, so this is safe to call from inside a task. Once
+	 * it runs out of work, it only waits for chunks that other threads are still working on. Helpers that start late find
+	 * nothing left to do and leave immediately. The first exception thrown by `fn` is rethrown on the calling thread, and
+	 * stops any chunks that have not yet started.
+	 */
+	template<typename _callable>
+	void parallel_for(size_t begin, size_t end, _callable&& fn, parallel_options options = {})
+	{
+		if (end <= begin) {
+			return;
+		}
+
+		if (!options.pool) {
+			options.pool = threadpool::instance();
+		}
+		size_t threads = options.threads;
+		if (threads == 0) {
+			threads = options.pool->concurrency(options.klass) + 1;
+		}
+		size_t grain = std::max<size_t>(options.grain, 1);
+
+		// Not worth the overhead of involving other threads.
+		size_t count = end - begin;
+		if ((threads <= 1) || (count <= grain)) {
+			fn(begin, end);
+			return;
+		}
+
+		// Work on indices relative to zero, so that cache line alignment does not depend on begin.
+		auto body = [&fn, begin](size_t chunk_begin, size_t chunk_end) { fn(begin + chunk_begin, begin + chunk_end); };
+
+		typedef detail::parallel_state<decltype(body)> state_t;
+		auto state          = std::make_shared<state_t>();
+		state->fn           = &body;
+		state->end          = count;
+		state->grain        = grain;
+		state->alignment    = (options.element_size > 0) ? std::max<size_t>(detail::cache_line_size / options.element_size, 1) : 1;
+		state->participants = std::min(threads, (count + grain - 1) / grain);
+		state->next         = 0;
+		state->completed    = 0;
+		state->failed       = false;
+
+		// Helpers only touch `body` after successfully claiming a chunk, which can't happen once we returned.
+		for (size_t idx = 1; idx < state->participants; idx++) {
+			options.pool->dispatch([state]() { state->work(); }, options.klass);
+		}
+		state->work();
+
+		// Wait for chunks that other threads are still working on.
+		for (size_t value = state->completed.load(std::memory_order_acquire); value != count; value = state->completed.load(std::memory_order_acquire)) {
+			state->completed.wait(value, std::memory_order_acquire);
+		}
+
+		if (state->exception) {
+			std::rethrow_exception(state->exception);
+		}
+	}
+
+	/** Reduce the range [begin, end) to a single value on multiple threads.
+	 *
+	 * `map(chunk_begin, chunk_end)` produces a value for each chunk, and `reduce(a, b)` combines two values. Chunks are
+	 * combined in no particular order, so `reduce` must be associative and commutative.
+	 */
+	template<typename _type, typename _map, typename _reduce>
+	_type parallel_reduce(size_t begin, size_t end, _type identity, _map&& map, _reduce&& reduce, parallel_options options = {})
+	{
+		_type      result = identity;
+		std::mutex lock;
+
+		parallel_for(
+			begin, end,
+			[&](size_t chunk_begin, size_t chunk_end) {
+				_type value = map(chunk_begin, chunk_end);
+
+				std::lock_guard<std::mutex> lg(lock);
+				result = reduce(std::move(result), std::move(value));
+			},
+			options);
+
+		return result;
+	}
+} // namespace streamfx::util::threadpool
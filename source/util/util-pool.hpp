@@ -4,13 +4,22 @@
 
 #pragma once
 #include "util/util-singleton.hpp"
+#include "util/util-threadpool.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <functional>
-#include <list>
-#include <map>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "warning-enable.hpp"
 
 namespace streamfx::util {
@@ -22,68 +31,425 @@ namespace streamfx::util {
 		virtual void reset(void* ptr){};
 	};
 
+	namespace detail {
+		inline int64_t pool_now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		/** Free objects of a single kind.
+		 *
+		 * Each thread has a small magazine of objects in front of a shared lock-free list, so that the common case of
+		 * releasing and re-acquiring an object on the same thread never touches shared state. Magazines are sharded by
+		 * thread, and a thread that finds its shard in use by another thread simply goes to the shared list instead.
+		 *
+		 * The shared list is a tagged index stack over slots that are allocated in chunks and never freed, like the job
+		 * pool of util::threadpool, which avoids both the ABA problem and use-after-free of list nodes.
+		 */
+		template<class _type>
+		class pool_bucket {
+			static constexpr size_t magazine_size = 8;
+			static constexpr size_t shard_count   = 16;
+			static constexpr size_t chunk_size    = 64;
+			static constexpr size_t max_chunks    = 256;
+
+			struct slot {
+				_type*                object;
+				int64_t               released;
+				std::atomic<uint32_t> next;
+				uint32_t              index;
+			};
+
+			struct entry {
+				_type*  object;
+				int64_t released;
+			};
+
+			struct magazine {
+#if __cpp_lib_hardware_interference_size >= 201603
+				alignas(std::hardware_destructive_interference_size)
+#endif
+					std::atomic<bool>                busy{false};
+				size_t                               count = 0;
+				std::array<entry, magazine_size>     items;
+			};
+
+#if __cpp_lib_hardware_interference_size >= 201603
+			alignas(std::hardware_destructive_interference_size)
+#endif
+				std::atomic<uint64_t> _full;
+#if __cpp_lib_hardware_interference_size >= 201603
+			alignas(std::hardware_destructive_interference_size)
+#endif
+				std::atomic<uint64_t> _empty;
+
+			std::mutex                                 _chunks_lock;
+			std::array<std::atomic<slot*>, max_chunks> _chunks;
+			std::atomic<size_t>                        _chunk_count;
+
+			std::array<magazine, shard_count> _magazines;
+
+			public:
+			pool_bucket() : _full(0), _empty(0), _chunks_lock(), _chunks(), _chunk_count(0), _magazines()
+			{
+				for (auto& chunk : _chunks) {
+					chunk.store(nullptr, std::memory_order_relaxed);
+				}
+			}
+
+			~pool_bucket()
+			{
+				clear();
+				for (size_t idx = 0, edx = _chunk_count.load(); idx < edx; idx++) {
+					delete[] _chunks[idx].load();
+				}
+			}
+
+			/** Take a free object, or nullptr if there is none.
+			 */
+			_type* acquire()
+			{
+				if (auto& mag = _magazines[shard()]; !mag.busy.exchange(true, std::memory_order_acquire)) {
+					_type* ptr = nullptr;
+					if (mag.count > 0) {
+						ptr = mag.items[--mag.count].object;
+					}
+					mag.busy.store(false, std::memory_order_release);
+					if (ptr) {
+						return ptr;
+					}
+				}
+
+				slot* ptr = pop(_full);
+				if (!ptr) {
+					return nullptr;
+				}
+				_type* object = ptr->object;
+				push(_empty, ptr);
+				return object;
+			}
+
+			/** Return an object.
+			 */
+			void release(_type* object, int64_t now)
+			{
+				if (auto& mag = _magazines[shard()]; !mag.busy.exchange(true, std::memory_order_acquire)) {
+					if (mag.count == magazine_size) {
+						// Move the older half to the shared list, so that other threads can use them.
+						constexpr size_t half = magazine_size / 2;
+						for (size_t idx = 0; idx < half; idx++) {
+							share(mag.items[idx]);
+						}
+						std::move(mag.items.begin() + half, mag.items.end(), mag.items.begin());
+						mag.count -= half;
+					}
+					mag.items[mag.count++] = {object, now};
+					mag.busy.store(false, std::memory_order_release);
+					return;
+				}
+
+				share({object, now});
+			}
+
+			/** Take out all objects that were released before the given time, for the caller to destroy.
+			 *
+			 * @return true if the bucket holds no more objects afterwards.
+			 */
+			bool sweep(int64_t expired, std::vector<_type*>& garbage)
+			{
+				bool empty = true;
+
+				for (auto& mag : _magazines) {
+					if (mag.busy.exchange(true, std::memory_order_acquire)) {
+						// In use, try again next time.
+						empty = false;
+						continue;
+					}
+
+					size_t kept = 0;
+					for (size_t idx = 0; idx < mag.count; idx++) {
+						if (mag.items[idx].released < expired) {
+							garbage.push_back(mag.items[idx].object);
+						} else {
+							mag.items[kept++] = mag.items[idx];
+						}
+					}
+					mag.count = kept;
+					empty     = empty && (kept == 0);
+					mag.busy.store(false, std::memory_order_release);
+				}
+
+				// Take everything from the shared list and put back what is still fresh.
+				std::vector<slot*> survivors;
+				while (slot* ptr = pop(_full)) {
+					if (ptr->released < expired) {
+						garbage.push_back(ptr->object);
+						push(_empty, ptr);
+					} else {
+						survivors.push_back(ptr);
+					}
+				}
+				for (auto itr = survivors.rbegin(); itr != survivors.rend(); itr++) {
+					push(_full, *itr);
+				}
+				empty = empty && survivors.empty();
+
+				return empty;
+			}
+
+			/** Delete all objects. Must not be called while other threads use the bucket.
+			 */
+			void clear()
+			{
+				for (auto& mag : _magazines) {
+					for (size_t idx = 0; idx < mag.count; idx++) {
+						delete mag.items[idx].object;
+					}
+					mag.count = 0;
+				}
+				while (slot* ptr = pop(_full)) {
+					delete ptr->object;
+					push(_empty, ptr);
+				}
+			}
+
+			private:
+			static size_t shard()
+			{
+				thread_local size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id());
+				return index % shard_count;
+			}
+
+			void share(entry const& value)
+			{
+				slot* ptr = pop(_empty);
+				if (!ptr && grow()) {
+					ptr = pop(_empty);
+				}
+				if (!ptr) {
+					// Too many free objects already, nobody will miss this one.
+					delete value.object;
+					return;
+				}
+
+				ptr->object   = value.object;
+				ptr->released = value.released;
+				push(_full, ptr);
+			}
+
+			slot* at(uint32_t index)
+			{
+				return &(_chunks[index / chunk_size].load(std::memory_order_acquire)[index % chunk_size]);
+			}
+
+			// The head stores a tag in the upper 32 bits, and the index + 1 of the first slot in the lower 32 bits.
+			slot* pop(std::atomic<uint64_t>& list)
+			{
+				uint64_t head = list.load(std::memory_order_acquire);
+				while (true) {
+					uint32_t index = static_cast<uint32_t>(head & 0xFFFFFFFFull);
+					if (index == 0) {
+						return nullptr;
+					}
+
+					slot*    ptr  = at(index - 1);
+					uint64_t next = ((head & 0xFFFFFFFF00000000ull) + 0x100000000ull) | ptr->next.load(std::memory_order_relaxed);
+					if (list.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+						return ptr;
+					}
+				}
+			}
+
+			void push(std::atomic<uint64_t>& list, slot* ptr)
+			{
+				uint64_t head = list.load(std::memory_order_relaxed);
+				while (true) {
+					ptr->next.store(static_cast<uint32_t>(head & 0xFFFFFFFFull), std::memory_order_relaxed);
+					uint64_t next = ((head & 0xFFFFFFFF00000000ull) + 0x100000000ull) | (ptr->index + 1);
+					if (list.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed)) {
+						return;
+					}
+				}
+			}
+
+			bool grow()
+			{
+				std::lock_guard<std::mutex> lg(_chunks_lock);
+
+				// Someone else may have grown the bucket while we waited.
+				if ((_empty.load(std::memory_order_acquire) & 0xFFFFFFFFull) != 0) {
+					return true;
+				}
+
+				size_t chunk = _chunk_count.load();
+				if (chunk >= max_chunks) {
+					return false;
+				}
+
+				slot* ptr = new slot[chunk_size];
+				for (size_t idx = 0; idx < chunk_size; idx++) {
+					ptr[idx].object   = nullptr;
+					ptr[idx].released = 0;
+					ptr[idx].index    = static_cast<uint32_t>(chunk * chunk_size + idx);
+				}
+				_chunks[chunk].store(ptr, std::memory_order_release);
+				_chunk_count.store(chunk + 1);
+
+				for (size_t idx = 0; idx < chunk_size; idx++) {
+					push(_empty, &ptr[idx]);
+				}
+				return true;
+			}
+		};
+
+		/** Expired objects, waiting for the next acquire to destroy them.
+		 *
+		 * Objects such as textures may only be destroyed on the thread that owns their context, which the sweeper never
+		 * does. The thread that acquires an object from the pool is the one that creates them, so it is the right one to
+		 * destroy them as well.
+		 */
+		template<class _type>
+		class pool_graveyard {
+			std::atomic<bool>   _filled;
+			std::mutex          _lock;
+			std::vector<_type*> _objects;
+
+			public:
+			pool_graveyard() : _filled(false), _lock(), _objects() {}
+
+			~pool_graveyard()
+			{
+				collect();
+			}
+
+			void bury(std::vector<_type*>& objects)
+			{
+				if (objects.empty()) {
+					return;
+				}
+
+				std::lock_guard<std::mutex> lg(_lock);
+				_objects.insert(_objects.end(), objects.begin(), objects.end());
+				_filled.store(true, std::memory_order_release);
+			}
+
+			/** Destroy all buried objects, on the calling thread.
+			 */
+			void collect()
+			{
+				if (!_filled.load(std::memory_order_acquire)) {
+					return;
+				}
+
+				std::vector<_type*> objects;
+				{
+					std::lock_guard<std::mutex> lg(_lock);
+					objects.swap(_objects);
+					_filled.store(false, std::memory_order_release);
+				}
+				for (auto ptr : objects) {
+					delete ptr; // Internal object is untracked.
+				}
+			}
+		};
+
+		/** Periodically expires objects, instead of scanning for them on every release.
+		 *
+		 * The timer is only started on first use, as the thread pool may not exist yet when a pool is created. Sweeps run
+		 * on the interactive lane, as the background lane may not get to run at all while the CPU is busy.
+		 */
+		class pool_sweeper {
+			std::atomic<bool>                                          _started;
+			std::mutex                                                 _lock;
+			std::shared_ptr<streamfx::util::threadpool::threadpool> _pool;
+			std::shared_ptr<streamfx::util::threadpool::timer>      _timer;
+
+			public:
+			pool_sweeper() : _started(false), _lock(), _pool(), _timer() {}
+
+			~pool_sweeper()
+			{
+				stop();
+			}
+
+			void start(std::chrono::milliseconds interval, std::function<void()> callback)
+			{
+				if (_started.load(std::memory_order_acquire)) {
+					return;
+				}
+
+				std::lock_guard<std::mutex> lg(_lock);
+				if (!_started) {
+					_pool    = streamfx::util::threadpool::threadpool::instance();
+					_timer   = _pool->schedule_every(interval, callback, streamfx::util::threadpool::priority::interactive);
+					_started = true;
+				}
+			}
+
+			/** Stop sweeping, and wait for a sweep that is currently running.
+			 */
+			void stop()
+			{
+				std::lock_guard<std::mutex> lg(_lock);
+				if (_timer) {
+					_timer->cancel();
+					_timer.reset();
+				}
+				_pool.reset();
+			}
+		};
+	} // namespace detail
+
 	/** Simple pool for objects of a single type.
-	 * 
+	 *
+	 * Released objects expire once they were not used for `_lifetime` milliseconds, and are destroyed by the next call
+	 * to acquire().
 	 */
 	template<class _self, class _type, uint64_t _lifetime>
 	class pool : public poolbase, public streamfx::util::singleton<_self> {
-		typedef std::chrono::high_resolution_clock::time_point _time;
-		typedef _type*                                         _ptr;
-		typedef std::shared_ptr<_type>                         _tracked;
+		typedef _type*                 _ptr;
+		typedef std::shared_ptr<_type> _tracked;
 
 		friend _tracked;
 		friend streamfx::util::singleton<_self>;
 
-		std::list<std::pair<_time, _ptr>> _pool;
-		std::mutex                        _lock;
+		detail::pool_bucket<_type>    _bucket;
+		detail::pool_graveyard<_type> _graveyard;
+		detail::pool_sweeper          _sweeper;
 
 		public:
 		~pool()
 		{
-			std::unique_lock<decltype(_lock)> lock(_lock);
-			for (auto kv : _pool) {
-				delete kv.second;
-			}
+			_sweeper.stop();
+			_graveyard.collect();
+			_bucket.clear();
 		}
 
 		protected:
-		pool(void) {}
+		pool(void) : _bucket(), _graveyard(), _sweeper() {}
 
 		void release(_ptr ptr)
 		{
-			std::unique_lock<decltype(_lock)> lock(_lock);
-
-			_time now = std::chrono::high_resolution_clock::now();
-
-			// Insert the released object into the pool.
-			_pool.emplace_front(std::pair<_time, _ptr>{now, ptr});
 			reset(ptr);
+			_bucket.release(ptr, detail::pool_now());
+			_sweeper.start(std::chrono::milliseconds(std::max<uint64_t>(_lifetime / 2, 1)), [this]() { sweep(); });
+		}
 
-			// Clean up any stragglers that exceeded their time limit.
-			for (auto pit = _pool.begin(); pit != _pool.end();) {
-				if ((pit->first - now) >= std::chrono::milliseconds(_lifetime)) {
-					delete pit->second; // Internal object is untracked.
-					pit = _pool.erase(pit);
-				} else {
-					pit++;
-				}
-			}
+		void sweep()
+		{
+			std::vector<_type*> garbage;
+			_bucket.sweep(detail::pool_now() - static_cast<int64_t>(_lifetime) * 1000000, garbage);
+			_graveyard.bury(garbage);
 		}
 
 		public:
 		template<class... _valuetypes>
 		_tracked acquire(_valuetypes&&... _values)
 		{
-			std::unique_lock<decltype(_lock)> lock(_lock);
+			_graveyard.collect();
 
-			// Try and find a free object.
-			_ptr ptr = nullptr;
-			if (_pool.size() > 0) {
-				ptr = _pool.front().second;
-				_pool.pop_front();
-			}
-
-			// If there was no usable object, create a new one.
+			// Try and find a free object, and if there is none create a new one.
+			_ptr ptr = _bucket.acquire();
 			if (!ptr) {
 				ptr = new _type(std::forward<_valuetypes>(_values)...);
 			}
@@ -116,82 +482,101 @@ namespace streamfx::util {
 	 * Usage:
 	 *     auto inst = example::pool::instance()->acquire(...);
 	 *
-	 * The returned pointer will keep a reference to the pool, and automatically release back into it when needed.
+	 * The returned pointer will keep a reference to the pool, and automatically release back into it when needed. Keys
+	 * must be hashable, either through std::hash or through the optional `_hash` parameter. Objects that expired are
+	 * destroyed by the next call to acquire(), so that graphics objects are only ever destroyed on the graphics thread.
 	 */
-	template<class _self, class _type, uint64_t _lifetime, typename _key>
+	template<class _self, class _type, uint64_t _lifetime, typename _key, typename _hash = std::hash<_key>>
 	class multipool : public poolbase, public streamfx::util::singleton<_self> {
-		typedef std::chrono::high_resolution_clock::time_point _time;
-		typedef _type*                                         _ptr;
-		typedef std::shared_ptr<_type>                         _tracked;
+		typedef _type*                 _ptr;
+		typedef std::shared_ptr<_type> _tracked;
 
 		friend _tracked;
 		friend streamfx::util::singleton<_self>;
 
-		std::map<_key, std::list<std::pair<_time, _ptr>>> _pool;
-		std::mutex                                        _lock;
+		// Buckets are only ever removed while holding the lock exclusively, so a shared lock keeps them alive.
+		std::unordered_map<_key, std::unique_ptr<detail::pool_bucket<_type>>, _hash> _pool;
+		std::shared_mutex                                                            _lock;
+		detail::pool_graveyard<_type>                                                _graveyard;
+		detail::pool_sweeper                                                         _sweeper;
 
 		public:
 		~multipool()
 		{
+			_sweeper.stop();
+			_graveyard.collect();
+
 			std::unique_lock<decltype(_lock)> lock(_lock);
-			for (auto kv : _pool) {
-				for (auto lv : kv.second) {
-					delete lv.second;
-				}
-			}
+			_pool.clear();
 		}
 
 		protected:
-		multipool(void) : _pool(), _lock() {}
+		multipool(void) : _pool(), _lock(), _graveyard(), _sweeper() {}
 
 		void release(_ptr ptr)
 		{
-			std::unique_lock<decltype(_lock)> lock(_lock);
+			auto hash = _self::as_key(ptr);
+			reset(ptr);
 
-			_time now = std::chrono::high_resolution_clock::now();
+			int64_t now = detail::pool_now();
+			{
+				std::shared_lock<decltype(_lock)> lock(_lock);
+				if (auto kv = _pool.find(hash); kv != _pool.end()) {
+					kv->second->release(ptr, now);
+					ptr = nullptr;
+				}
+			}
+			if (ptr) {
+				// First object of its kind, so the bucket needs to be created.
+				std::unique_lock<decltype(_lock)> lock(_lock);
+				auto                              kv = _pool.try_emplace(hash, std::make_unique<detail::pool_bucket<_type>>()).first;
+				kv->second->release(ptr, now);
+			}
 
-			// Re-insert the released object into the pool(s).
-			auto hash = _self::as_key(ptr);
-			if (auto kv = _pool.find(hash); kv != _pool.end()) {
-				kv->second.emplace_front(now, ptr);
-			} else {
-				_pool.emplace(hash, std::list<std::pair<_time, _ptr>>{{now, ptr}});
+			_sweeper.start(std::chrono::milliseconds(std::max<uint64_t>(_lifetime / 2, 1)), [this]() { sweep(); });
+		}
+
+		void sweep()
+		{
+			int64_t             expired = detail::pool_now() - static_cast<int64_t>(_lifetime) * 1000000;
+			std::vector<_type*> garbage;
+
+			bool have_empty = false;
+			{
+				std::shared_lock<decltype(_lock)> lock(_lock);
+				for (auto& kv : _pool) {
+					have_empty |= kv.second->sweep(expired, garbage);
+				}
 			}
-			reset(ptr);
 
-			// Clean up any stragglers that exceeded their time limit.
-			for (auto pit = _pool.begin(); pit != _pool.end();) {
-				for (auto lit = pit->second.begin(); lit != pit->second.end();) {
-					if ((lit->first - now) >= std::chrono::milliseconds(_lifetime)) {
-						delete lit->second; // Internal object is untracked.
-						lit = pit->second.erase(lit);
+			// Delete any empty buckets from memory.
+			if (have_empty) {
+				std::unique_lock<decltype(_lock)> lock(_lock);
+				for (auto kv = _pool.begin(); kv != _pool.end();) {
+					if (kv->second->sweep(expired, garbage)) {
+						kv = _pool.erase(kv);
 					} else {
-						lit++;
+						kv++;
 					}
 				}
-
-				// Delete any empty lists from memory.
-				if (pit->second.empty()) {
-					pit = _pool.erase(pit);
-				} else {
-					pit++;
-				}
 			}
+
+			_graveyard.bury(garbage);
 		}
 
 		public:
 		template<class... _valuetypes>
 		_tracked acquire(_valuetypes&&... _values)
 		{
-			std::unique_lock<decltype(_lock)> lock(_lock);
+			_graveyard.collect();
 
 			// Try and find an existing pool, and a free object.
-			_ptr ptr  = nullptr;
-			auto hash = _self::as_key(std::forward<_valuetypes>(_values)...);
-			if (auto kv = _pool.find(hash); kv != _pool.cend()) {
-				if (kv->second.size() > 0) {
-					ptr = kv->second.front().second;
-					kv->second.pop_front();
+			_ptr ptr = nullptr;
+			{
+				auto                              hash = _self::as_key(_values...);
+				std::shared_lock<decltype(_lock)> lock(_lock);
+				if (auto kv = _pool.find(hash); kv != _pool.end()) {
+					ptr = kv->second->acquire();
 				}
 			}
 
@@ -3,133 +3,221 @@
 // AUTOGENERATED COPYRIGHT HEADER END
 
 #include "util-profiler.hpp"
+#include "util-trace.hpp"
 
 #include "warning-disable.hpp"
-#include <iterator>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
 #include "warning-enable.hpp"
 
-streamfx::util::profiler::profiler() {}
+static constexpr uint64_t value_limit = (uint64_t(1) << streamfx::util::profiler::magnitudes) - 1;
 
-streamfx::util::profiler::~profiler() {}
-
-std::shared_ptr<streamfx::util::profiler::instance> streamfx::util::profiler::track()
+size_t streamfx::util::profiler::bucket_index(uint64_t value)
 {
-	return std::make_shared<streamfx::util::profiler::instance>(shared_from_this());
+	value = std::min(value, value_limit);
+	if (value < (sub_buckets << 1)) {
+		return static_cast<size_t>(value);
+	}
+
+	size_t shift = static_cast<size_t>(std::bit_width(value)) - 1 - sub_bucket_bits;
+	return ((shift + 1) * sub_buckets) + static_cast<size_t>((value >> shift) - sub_buckets);
 }
 
-void streamfx::util::profiler::track(std::chrono::nanoseconds duration)
+std::pair<uint64_t, uint64_t> streamfx::util::profiler::bucket_range(size_t index)
 {
-	std::unique_lock<std::mutex> ul(_timings_lock);
-	auto                         itr = _timings.find(duration);
-	if (itr == _timings.end()) {
-		_timings.emplace(duration, 1u);
-	} else {
-		itr->second++;
+	if (index < (sub_buckets << 1)) {
+		return {index, index};
 	}
+
+	size_t   shift    = (index / sub_buckets) - 1;
+	uint64_t mantissa = (index % sub_buckets) + sub_buckets;
+	return {mantissa << shift, ((mantissa + 1) << shift) - 1};
 }
 
-uint64_t streamfx::util::profiler::count()
+streamfx::util::profiler::histogram::histogram() : _buckets(), _count(0), _total(0), _minimum(std::numeric_limits<uint64_t>::max()), _maximum(0)
 {
-	uint64_t count = 0;
+	_buckets.fill(0);
+}
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
-	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), std::inserter(copy_timings, copy_timings.end()));
+streamfx::util::profiler::histogram& streamfx::util::profiler::histogram::merge(histogram const& other)
+{
+	for (size_t idx = 0; idx < histogram_length; idx++) {
+		_buckets[idx] += other._buckets[idx];
 	}
+	_count += other._count;
+	_total += other._total;
+	_minimum = std::min(_minimum, other._minimum);
+	_maximum = std::max(_maximum, other._maximum);
+	return *this;
+}
 
-	for (auto kv : copy_timings) {
-		count += kv.second;
-	}
+streamfx::util::profiler::histogram& streamfx::util::profiler::histogram::operator+=(histogram const& other)
+{
+	return merge(other);
+}
 
-	return count;
+uint64_t streamfx::util::profiler::histogram::count() const
+{
+	return _count;
 }
 
-std::chrono::nanoseconds streamfx::util::profiler::total_duration()
+std::chrono::nanoseconds streamfx::util::profiler::histogram::total_duration() const
 {
-	std::chrono::nanoseconds duration{0};
+	return std::chrono::nanoseconds(_total);
+}
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
-	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), std::inserter(copy_timings, copy_timings.end()));
-	}
+double_t streamfx::util::profiler::histogram::average_duration() const
+{
+	return double_t(_total) / double_t(_count);
+}
 
-	for (auto kv : copy_timings) {
-		duration += kv.first * kv.second;
-	}
+std::chrono::nanoseconds streamfx::util::profiler::histogram::minimum() const
+{
+	return std::chrono::nanoseconds(_count > 0 ? _minimum : 0);
+}
 
-	return duration;
+std::chrono::nanoseconds streamfx::util::profiler::histogram::maximum() const
+{
+	return std::chrono::nanoseconds(_maximum);
 }
 
-double_t streamfx::util::profiler::average_duration()
+std::chrono::nanoseconds streamfx::util::profiler::histogram::percentile(double_t percentile, bool by_time) const
 {
-	std::chrono::nanoseconds duration{0};
-	uint64_t                 count = 0;
+	if (_count == 0) {
+		return std::chrono::nanoseconds(-1);
+	}
+
+	percentile = std::clamp(percentile, 0.0, 1.0);
+
+	// Report the middle of the bucket, but never outside of what was actually tracked.
+	auto value_of = [this](size_t index) {
+		auto range = bucket_range(index);
+		return std::chrono::nanoseconds(std::clamp(range.first + ((range.second - range.first) >> 1), _minimum, _maximum));
+	};
+
+	if (by_time) { // Return by time percentile.
+		uint64_t threshold = _minimum + static_cast<uint64_t>(std::llround(double_t(_maximum - _minimum) * percentile));
+		for (size_t idx = bucket_index(threshold); idx < histogram_length; idx++) {
+			if (_buckets[idx] > 0) {
+				return value_of(idx);
+			}
+		}
+	} else { // Return by call percentile.
+		if (percentile == 0.0) {
+			return std::chrono::nanoseconds(_minimum);
+		}
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
-	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), std::inserter(copy_timings, copy_timings.end()));
+		uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(double_t(_count) * percentile)), 1);
+		uint64_t accu = 0;
+		for (size_t idx = 0; idx < histogram_length; idx++) {
+			accu += _buckets[idx];
+			if (accu >= rank) {
+				return value_of(idx);
+			}
+		}
 	}
 
-	for (auto kv : copy_timings) {
-		duration += kv.first * kv.second;
-		count += kv.second;
+	return std::chrono::nanoseconds(_maximum);
+}
+
+streamfx::util::profiler::profiler(std::string_view name) : _name(name), _buckets(), _count(0), _total(0), _minimum(std::numeric_limits<uint64_t>::max()), _maximum(0)
+{
+	for (auto& bucket : _buckets) {
+		bucket.store(0, std::memory_order_relaxed);
 	}
+}
+
+streamfx::util::profiler::~profiler() {}
 
-	return double_t(duration.count()) / double_t(count);
+std::string_view streamfx::util::profiler::name() const
+{
+	return _name;
 }
 
-template<typename T>
-inline bool is_equal(T a, T b, T c)
+std::shared_ptr<streamfx::util::profiler::instance> streamfx::util::profiler::track()
 {
-	return (a == b) || ((a >= (b - c)) && (a <= (b + c)));
+	return std::make_shared<streamfx::util::profiler::instance>(shared_from_this());
 }
 
-std::chrono::nanoseconds streamfx::util::profiler::percentile(double_t percentile, bool by_time)
+void streamfx::util::profiler::track(std::chrono::nanoseconds duration)
 {
-	constexpr double_t edge  = 0.00005;
-	uint64_t           calls = count();
+	uint64_t value = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
-	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), inserter(copy_timings, copy_timings.end()));
-	}
-	if (by_time) { // Return by time percentile.
-		// Find largest and smallest time.
-		std::chrono::nanoseconds smallest = copy_timings.begin()->first;
-		std::chrono::nanoseconds largest  = copy_timings.rbegin()->first;
-		std::chrono::nanoseconds variance = largest - smallest;
-
-		for (auto kv : copy_timings) {
-			double_t kv_pct = double_t((kv.first - smallest).count()) / double_t(variance.count());
-			if (is_equal<double_t>(kv_pct, percentile, edge) || (kv_pct > percentile)) {
-				return std::chrono::nanoseconds(kv.first);
-			}
-		}
-	} else { // Return by call percentile.
-		if (percentile == 0.0) {
-			return copy_timings.begin()->first;
-		}
+	_buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+	_total.fetch_add(value, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
 
-		uint64_t accu_calls_now = 0;
-		for (auto kv : copy_timings) {
-			uint64_t accu_calls_last = accu_calls_now;
-			accu_calls_now += kv.second;
+	// Only contended if the value is a new extreme, which becomes rare quickly.
+	uint64_t minimum = _minimum.load(std::memory_order_relaxed);
+	while ((value < minimum) && !_minimum.compare_exchange_weak(minimum, value, std::memory_order_relaxed)) {
+	}
+	uint64_t maximum = _maximum.load(std::memory_order_relaxed);
+	while ((value > maximum) && !_maximum.compare_exchange_weak(maximum, value, std::memory_order_relaxed)) {
+	}
+}
 
-			double_t percentile_last = double_t(accu_calls_last) / double_t(calls);
-			double_t percentile_now  = double_t(accu_calls_now) / double_t(calls);
+streamfx::util::profiler::histogram streamfx::util::profiler::snapshot() const
+{
+	histogram result;
+	for (size_t idx = 0; idx < histogram_length; idx++) {
+		result._buckets[idx] = _buckets[idx].load(std::memory_order_relaxed);
+		result._count += result._buckets[idx];
+	}
+	result._total   = _total.load(std::memory_order_relaxed);
+	result._minimum = _minimum.load(std::memory_order_relaxed);
+	result._maximum = _maximum.load(std::memory_order_relaxed);
+	return result;
+}
 
-			if (is_equal<double_t>(percentile, percentile_now, edge)
-				|| ((percentile_last < percentile) && (percentile_now > percentile))) {
-				return std::chrono::nanoseconds(kv.first);
-			}
+void streamfx::util::profiler::merge(histogram const& other)
+{
+	for (size_t idx = 0; idx < histogram_length; idx++) {
+		if (other._buckets[idx] > 0) {
+			_buckets[idx].fetch_add(other._buckets[idx], std::memory_order_relaxed);
 		}
 	}
+	_total.fetch_add(other._total, std::memory_order_relaxed);
+	_count.fetch_add(other._count, std::memory_order_relaxed);
+
+	uint64_t minimum = _minimum.load(std::memory_order_relaxed);
+	while ((other._minimum < minimum) && !_minimum.compare_exchange_weak(minimum, other._minimum, std::memory_order_relaxed)) {
+	}
+	uint64_t maximum = _maximum.load(std::memory_order_relaxed);
+	while ((other._maximum > maximum) && !_maximum.compare_exchange_weak(maximum, other._maximum, std::memory_order_relaxed)) {
+	}
+}
+
+void streamfx::util::profiler::reset()
+{
+	for (auto& bucket : _buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	_count.store(0, std::memory_order_relaxed);
+	_total.store(0, std::memory_order_relaxed);
+	_minimum.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+	_maximum.store(0, std::memory_order_relaxed);
+}
+
+uint64_t streamfx::util::profiler::count()
+{
+	return _count.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds streamfx::util::profiler::total_duration()
+{
+	return std::chrono::nanoseconds(_total.load(std::memory_order_relaxed));
+}
 
-	return std::chrono::nanoseconds(-1);
+double_t streamfx::util::profiler::average_duration()
+{
+	return snapshot().average_duration();
+}
+
+std::chrono::nanoseconds streamfx::util::profiler::percentile(double_t percentile, bool by_time)
+{
+	return snapshot().percentile(percentile, by_time);
 }
 
 streamfx::util::profiler::instance::instance(std::shared_ptr<streamfx::util::profiler> parent)
@@ -142,6 +230,12 @@ streamfx::util::profiler::instance::~instance()
 	auto dur = end - _start;
 	if (_parent) {
 		_parent->track(dur);
+
+		if (streamfx::util::trace::is_recording() && !_parent->_name.empty()) {
+			// The trace uses a different clock, so only the duration can be carried over.
+			int64_t trace_end = streamfx::util::trace::now();
+			streamfx::util::trace::complete("profiler", _parent->_name, trace_end - std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count(), trace_end);
+		}
 	}
 }
 
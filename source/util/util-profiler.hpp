@@ -3,20 +3,73 @@
 // AUTOGENERATED COPYRIGHT HEADER END
 
 #pragma once
-#include "common.hpp"
-
 #include "warning-disable.hpp"
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <map>
-#include <mutex>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
 #include "warning-enable.hpp"
 
 namespace streamfx::util {
+	/** Low overhead collection of timings.
+	 *
+	 * Timings are counted in an HDR-style histogram: every power of two range is split into 32 linear buckets, so any
+	 * reported value is within about 3% of the real one. Values below 64ns are exact, values above about 78 hours are
+	 * counted as 78 hours. Tracking is a few relaxed atomic operations and never blocks, so profilers can stay enabled
+	 * in production.
+	 */
 	class profiler : public std::enable_shared_from_this<streamfx::util::profiler> {
-		std::map<std::chrono::nanoseconds, size_t> _timings;
-		std::mutex                                 _timings_lock;
-
 		public:
+		static constexpr size_t sub_bucket_bits  = 5;
+		static constexpr size_t sub_buckets      = size_t(1) << sub_bucket_bits;
+		static constexpr size_t magnitudes       = 48;
+		static constexpr size_t histogram_length = (magnitudes - sub_bucket_bits + 1) * sub_buckets;
+
+		/** Copy of the state of a profiler at some point in time.
+		 *
+		 * Histograms can be merged, for example to combine the timings of several sources or threads.
+		 */
+		class histogram {
+			std::array<uint64_t, histogram_length> _buckets;
+			uint64_t                               _count;
+			uint64_t                               _total;
+			uint64_t                               _minimum;
+			uint64_t                               _maximum;
+
+			friend class profiler;
+
+			public:
+			histogram();
+
+			histogram& merge(histogram const& other);
+
+			histogram& operator+=(histogram const& other);
+
+			uint64_t count() const;
+
+			std::chrono::nanoseconds total_duration() const;
+
+			double_t average_duration() const;
+
+			std::chrono::nanoseconds minimum() const;
+
+			std::chrono::nanoseconds maximum() const;
+
+			/** Find the duration at the given percentile (0..1).
+			 *
+			 * @param by_time If true, the percentile is of the range between the smallest and largest duration instead
+			 *                of the number of calls.
+			 * @return The duration, or -1ns if nothing was tracked.
+			 */
+			std::chrono::nanoseconds percentile(double_t percentile, bool by_time = false) const;
+		};
+
 		class instance {
 			std::shared_ptr<profiler>                      _parent;
 			std::chrono::high_resolution_clock::time_point _start;
@@ -32,15 +85,38 @@ namespace streamfx::util {
 		};
 
 		private:
-		profiler();
+		std::string                                         _name;
+		std::array<std::atomic<uint64_t>, histogram_length> _buckets;
+		std::atomic<uint64_t>                               _count;
+		std::atomic<uint64_t>                               _total;
+		std::atomic<uint64_t>                               _minimum;
+		std::atomic<uint64_t>                               _maximum;
+
+		profiler(std::string_view name);
 
 		public:
 		~profiler();
 
+		/// Name used in recorded traces. Unnamed profilers are not recorded.
+		std::string_view name() const;
+
 		std::shared_ptr<class streamfx::util::profiler::instance> track();
 
 		void track(std::chrono::nanoseconds duration);
 
+		/** Take a copy of all timings so far.
+		 *
+		 * This does not stop other threads from tracking, so the copy may be off by the few calls that were tracked while
+		 * it was being taken.
+		 */
+		histogram snapshot() const;
+
+		/** Add the timings of another profiler or snapshot to this profiler.
+		 */
+		void merge(histogram const& other);
+
+		void reset();
+
 		uint64_t count();
 
 		std::chrono::nanoseconds total_duration();
@@ -50,9 +126,15 @@ namespace streamfx::util {
 		std::chrono::nanoseconds percentile(double_t percentile, bool by_time = false);
 
 		public:
-		static std::shared_ptr<streamfx::util::profiler> create()
+		static std::shared_ptr<streamfx::util::profiler> create(std::string_view name = {})
 		{
-			return std::shared_ptr<streamfx::util::profiler>{new profiler()};
+			return std::shared_ptr<streamfx::util::profiler>{new profiler(name)};
 		}
+
+		/// Bucket that counts the given duration in nanoseconds.
+		static size_t bucket_index(uint64_t value);
+
+		/// Range of durations in nanoseconds counted by a bucket, both ends inclusive.
+		static std::pair<uint64_t, uint64_t> bucket_range(size_t index);
 	};
 } // namespace streamfx::util
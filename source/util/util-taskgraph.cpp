@@ -0,0 +1,234 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "util-taskgraph.hpp"
+#include "util/util-logging.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include "warning-enable.hpp"
+
+#ifdef _DEBUG
+#define ST_PREFIX "<%s> "
+#define D_LOG_ERROR(x, ...) P_LOG_ERROR(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_WARNING(x, ...) P_LOG_WARN(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_INFO(x, ...) P_LOG_INFO(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_DEBUG(x, ...) P_LOG_DEBUG(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#else
+#define ST_PREFIX "<util::taskgraph> "
+#define D_LOG_ERROR(...) P_LOG_ERROR(ST_PREFIX __VA_ARGS__)
+#define D_LOG_WARNING(...) P_LOG_WARN(ST_PREFIX __VA_ARGS__)
+#define D_LOG_INFO(...) P_LOG_INFO(ST_PREFIX __VA_ARGS__)
+#define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
+#endif
+
+streamfx::util::taskgraph::node::node(std::shared_ptr<state> state, node_callback_t callback, streamfx::util::threadpool::priority klass) : _state(state), _callback(callback), _klass(klass), _dependents(), _dependencies(0), _pending(0), _status(status::waiting), _cancelled(false) {}
+
+streamfx::util::taskgraph::node::~node() {}
+
+void streamfx::util::taskgraph::node::cancel()
+{
+	// Stop at nodes that were already cancelled, so that diamonds are only walked once.
+	if (_cancelled.exchange(true)) {
+		return;
+	}
+
+	for (auto& dependent : _dependents) {
+		dependent->cancel();
+	}
+}
+
+streamfx::util::taskgraph::status streamfx::util::taskgraph::node::get_status()
+{
+	return _status;
+}
+
+bool streamfx::util::taskgraph::node::is_finished()
+{
+	auto value = _status.load();
+	return (value == status::completed) || (value == status::cancelled) || (value == status::failed);
+}
+
+void streamfx::util::taskgraph::node::ready()
+{
+	if (_cancelled || _state->cancelled) {
+		finish(false);
+		return;
+	}
+
+	_state->pool->dispatch([self = shared_from_this()]() { self->execute(); }, _klass);
+}
+
+void streamfx::util::taskgraph::node::execute()
+{
+	if (_cancelled || _state->cancelled) {
+		finish(false);
+		return;
+	}
+
+	_status = status::running;
+	try {
+		_callback();
+		finish(true);
+	} catch (const std::exception& ex) {
+		D_LOG_ERROR("Unhandled exception in node: %s.", ex.what());
+		_status = status::failed;
+		cancel();
+		finish(false);
+	} catch (...) {
+		D_LOG_ERROR("Unhandled exception in node.", nullptr);
+		_status = status::failed;
+		cancel();
+		finish(false);
+	}
+}
+
+void streamfx::util::taskgraph::node::finish(bool success)
+{
+	if (success) {
+		_status = status::completed;
+	} else {
+		if (_status != status::failed) {
+			_status = status::cancelled;
+		}
+		for (auto& dependent : _dependents) {
+			dependent->cancel();
+		}
+	}
+
+	// Release the callback early, it may hold on to large resources.
+	_callback = nullptr;
+
+	// Queue every dependent for which we were the last dependency.
+	for (auto& dependent : _dependents) {
+		if (--dependent->_pending == 0) {
+			dependent->ready();
+		}
+	}
+
+	if (--_state->remaining == 0) {
+		std::lock_guard<std::mutex> lg(_state->lock);
+		_state->finished.notify_all();
+	}
+}
+
+streamfx::util::taskgraph::graph::graph(std::shared_ptr<streamfx::util::threadpool::threadpool> pool) : _state(std::make_shared<state>()), _nodes(), _started(false)
+{
+	_state->pool      = pool;
+	_state->cancelled = false;
+	_state->remaining = 0;
+}
+
+streamfx::util::taskgraph::graph::~graph() {}
+
+std::shared_ptr<streamfx::util::taskgraph::node> streamfx::util::taskgraph::graph::add(node_callback_t callback, streamfx::util::threadpool::priority klass)
+{
+	if (_started) {
+		throw std::logic_error("Graph has already been started.");
+	}
+
+	auto result = std::make_shared<node>(_state, callback, klass);
+	_nodes.push_back(result);
+	return result;
+}
+
+void streamfx::util::taskgraph::graph::precede(std::shared_ptr<node> first, std::shared_ptr<node> second)
+{
+	if (_started) {
+		throw std::logic_error("Graph has already been started.");
+	}
+	if (!first || !second || (first->_state != _state) || (second->_state != _state)) {
+		throw std::invalid_argument("Nodes must belong to this graph.");
+	}
+	if (first == second) {
+		throw std::invalid_argument("Node can't depend on itself.");
+	}
+
+	// A cycle would never finish, so reject the edge if `first` already (indirectly) depends on `second`.
+	std::vector<node*>        stack{second.get()};
+	std::unordered_set<node*> visited{second.get()};
+	while (!stack.empty()) {
+		node* current = stack.back();
+		stack.pop_back();
+		for (auto& dependent : current->_dependents) {
+			if (dependent == first) {
+				throw std::invalid_argument("Dependency would create a cycle.");
+			}
+			if (visited.insert(dependent.get()).second) {
+				stack.push_back(dependent.get());
+			}
+		}
+	}
+
+	first->_dependents.push_back(second);
+	second->_dependencies++;
+}
+
+std::shared_ptr<streamfx::util::taskgraph::node> streamfx::util::taskgraph::graph::then(std::shared_ptr<node> dependency, node_callback_t callback, streamfx::util::threadpool::priority klass)
+{
+	auto result = add(callback, klass);
+	precede(dependency, result);
+	return result;
+}
+
+std::shared_ptr<streamfx::util::taskgraph::node> streamfx::util::taskgraph::graph::join(std::vector<std::shared_ptr<node>> dependencies, node_callback_t callback, streamfx::util::threadpool::priority klass)
+{
+	auto result = add(callback, klass);
+	for (auto& dependency : dependencies) {
+		precede(dependency, result);
+	}
+	return result;
+}
+
+void streamfx::util::taskgraph::graph::start()
+{
+	if (_started) {
+		throw std::logic_error("Graph has already been started.");
+	}
+	_started = true;
+
+	// All counters must be set up before the first node can finish.
+	_state->remaining = _nodes.size();
+	for (auto& node : _nodes) {
+		node->_pending = node->_dependencies;
+	}
+
+	for (auto& node : _nodes) {
+		if (node->_dependencies == 0) {
+			node->ready();
+		}
+	}
+}
+
+void streamfx::util::taskgraph::graph::cancel()
+{
+	_state->cancelled = true;
+	if (!_started) {
+		// Nothing will ever run, so there is nothing to wait for.
+		for (auto& node : _nodes) {
+			node->_cancelled = true;
+			node->_status    = status::cancelled;
+		}
+	}
+}
+
+bool streamfx::util::taskgraph::graph::is_completed()
+{
+	if (!_started) {
+		return _state->cancelled;
+	}
+	return _state->remaining == 0;
+}
+
+void streamfx::util::taskgraph::graph::wait()
+{
+	if (!_started) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> ul(_state->lock);
+	_state->finished.wait(ul, [this]() { return _state->remaining == 0; });
+}
@@ -0,0 +1,136 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "util/util-threadpool.hpp"
+
+#include "warning-disable.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace streamfx::util::taskgraph {
+	typedef std::function<void()> node_callback_t;
+
+	enum class status {
+		waiting,
+		running,
+		completed,
+		cancelled,
+		failed,
+	};
+
+	/** State shared between a graph and all of its nodes.
+	 */
+	struct state {
+		std::shared_ptr<streamfx::util::threadpool::threadpool> pool;
+
+		std::atomic<bool>   cancelled;
+		std::atomic<size_t> remaining;
+
+		std::mutex              lock;
+		std::condition_variable finished;
+	};
+
+	class node : public std::enable_shared_from_this<node> {
+		std::shared_ptr<state>               _state;
+		node_callback_t                      _callback;
+		streamfx::util::threadpool::priority _klass;
+
+		std::vector<std::shared_ptr<node>> _dependents;
+		size_t                             _dependencies;
+		std::atomic<size_t>                _pending;
+
+		std::atomic<status> _status;
+		std::atomic<bool>   _cancelled;
+
+		friend class graph;
+
+		public:
+		node(std::shared_ptr<state> state, node_callback_t callback, streamfx::util::threadpool::priority klass);
+		~node();
+
+		/** Cancel this node and everything that depends on it.
+		 *
+		 * A node that is already running will finish, but its dependents will not run.
+		 */
+		void cancel();
+
+		status get_status();
+
+		bool is_finished();
+
+		private:
+		void ready();
+
+		void execute();
+
+		void finish(bool success);
+	};
+
+	/** Directed acyclic graph of tasks executed on a thread pool.
+	 *
+	 * Nodes without dependencies are queued when the graph is started, and every other node is queued by the last of its
+	 * dependencies to finish. No thread ever blocks waiting for a dependency. If a node fails or is cancelled, all nodes
+	 * that depend on it are cancelled as well.
+	 *
+	 * Usage:
+	 *     streamfx::util::taskgraph::graph g;
+	 *     auto readback = g.add([]() { ... });
+	 *     auto analyze  = g.then(readback, []() { ... });
+	 *     auto left     = g.then(analyze, []() { ... });
+	 *     auto right    = g.then(analyze, []() { ... });
+	 *     g.join({left, right}, []() { ... });
+	 *     g.start();
+	 *
+	 * The graph may be destroyed while it is still running, already queued nodes will run to completion.
+	 */
+	class graph {
+		std::shared_ptr<state>             _state;
+		std::vector<std::shared_ptr<node>> _nodes;
+		bool                               _started;
+
+		public:
+		graph(std::shared_ptr<streamfx::util::threadpool::threadpool> pool = streamfx::util::threadpool::threadpool::instance());
+		~graph();
+
+		/** Add a new node without any dependencies.
+		 */
+		std::shared_ptr<node> add(node_callback_t callback, streamfx::util::threadpool::priority klass = streamfx::util::threadpool::priority::background);
+
+		/** Make `second` depend on `first`.
+		 *
+		 * Throws std::invalid_argument if `first` already depends on `second`, as the graph could never finish.
+		 */
+		void precede(std::shared_ptr<node> first, std::shared_ptr<node> second);
+
+		/** Add a new node that runs after `dependency` finished.
+		 */
+		std::shared_ptr<node> then(std::shared_ptr<node> dependency, node_callback_t callback, streamfx::util::threadpool::priority klass = streamfx::util::threadpool::priority::background);
+
+		/** Add a new node that runs after all `dependencies` finished.
+		 */
+		std::shared_ptr<node> join(std::vector<std::shared_ptr<node>> dependencies, node_callback_t callback, streamfx::util::threadpool::priority klass = streamfx::util::threadpool::priority::background);
+
+		/** Queue all nodes without dependencies.
+		 */
+		void start();
+
+		/** Cancel all nodes that have not started running yet.
+		 */
+		void cancel();
+
+		bool is_completed();
+
+		/** Block until every node has either run or been cancelled.
+		 *
+		 * Only meant for the end of a pipeline, never call this from inside a node.
+		 */
+		void wait();
+	};
+} // namespace streamfx::util::taskgraph
@@ -0,0 +1,54 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "util-telemetry.hpp"
+
+streamfx::util::threadpool::statistics::statistics() : wait(streamfx::util::profiler::create()), run(streamfx::util::profiler::create()), queued(0), completed(0), cancelled(0), depth(0), depth_peak(0) {}
+
+void streamfx::util::threadpool::statistics::on_queued()
+{
+	queued.fetch_add(1, std::memory_order_relaxed);
+
+	size_t value = depth.fetch_add(1, std::memory_order_relaxed) + 1;
+	for (size_t peak = depth_peak.load(std::memory_order_relaxed); (value > peak) && !depth_peak.compare_exchange_weak(peak, value, std::memory_order_relaxed);) {
+	}
+}
+
+void streamfx::util::threadpool::statistics::on_started(std::chrono::nanoseconds wait_time)
+{
+	depth.fetch_sub(1, std::memory_order_relaxed);
+	wait->track(wait_time);
+}
+
+void streamfx::util::threadpool::statistics::on_completed(std::chrono::nanoseconds run_time)
+{
+	completed.fetch_add(1, std::memory_order_relaxed);
+	run->track(run_time);
+}
+
+void streamfx::util::threadpool::statistics::on_cancelled()
+{
+	depth.fetch_sub(1, std::memory_order_relaxed);
+	cancelled.fetch_add(1, std::memory_order_relaxed);
+}
+
+streamfx::util::threadpool::statistics_snapshot streamfx::util::threadpool::statistics::snapshot() const
+{
+	statistics_snapshot result;
+	result.wait       = wait->snapshot();
+	result.run        = run->snapshot();
+	result.queued     = queued.load(std::memory_order_relaxed);
+	result.completed  = completed.load(std::memory_order_relaxed);
+	result.cancelled  = cancelled.load(std::memory_order_relaxed);
+	result.depth      = depth.load(std::memory_order_relaxed);
+	result.depth_peak = depth_peak.load(std::memory_order_relaxed);
+	return result;
+}
+
+streamfx::util::threadpool::task_tag::task_tag(std::string_view name) : _name(name), stats() {}
+
+std::string_view streamfx::util::threadpool::task_tag::name() const
+{
+	return _name;
+}
@@ -0,0 +1,73 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "util/util-profiler.hpp"
+
+#include "warning-disable.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "warning-enable.hpp"
+
+namespace streamfx::util::threadpool {
+	struct statistics_snapshot {
+		streamfx::util::profiler::histogram wait;
+		streamfx::util::profiler::histogram run;
+		uint64_t                            queued;
+		uint64_t                            completed;
+		uint64_t                            cancelled;
+		size_t                              depth;
+		size_t                              depth_peak;
+	};
+
+	/** Counters for a group of tasks, such as all tasks of a priority class or all tasks with the same tag.
+	 */
+	struct statistics {
+		/// Time between being queued and being started.
+		std::shared_ptr<streamfx::util::profiler> wait;
+
+		/// Time spent running.
+		std::shared_ptr<streamfx::util::profiler> run;
+
+		std::atomic<uint64_t> queued;
+		std::atomic<uint64_t> completed;
+		std::atomic<uint64_t> cancelled;
+
+		/// Number of tasks that are queued but not yet started, and the highest value this ever reached.
+		std::atomic<size_t> depth;
+		std::atomic<size_t> depth_peak;
+
+		statistics();
+
+		void on_queued();
+
+		void on_started(std::chrono::nanoseconds wait_time);
+
+		void on_completed(std::chrono::nanoseconds run_time);
+
+		void on_cancelled();
+
+		statistics_snapshot snapshot() const;
+	};
+
+	/** Label to group tasks by in telemetry.
+	 *
+	 * Tags are owned by the pool that created them and live as long as it does, so it is safe to keep a pointer to them.
+	 */
+	class task_tag {
+		std::string _name;
+
+		public:
+		statistics stats;
+
+		task_tag(std::string_view name);
+
+		std::string_view name() const;
+	};
+} // namespace streamfx::util::threadpool
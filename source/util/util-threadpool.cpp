@@ -8,9 +8,15 @@
 #include "common.hpp"
 #include "plugin.hpp"
 #include "util/util-logging.hpp"
+#include "util/util-trace.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <charconv>
 #include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <set>
 #include "warning-enable.hpp"
 
 #include "warning-disable.hpp"
@@ -35,34 +41,43 @@
 #define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
 #endif
 
-streamfx::util::threadpool::task::task(task_callback_t callback, task_data_t data) : _callback(callback), _data(data), _lock(), _status_changed(), _cancelled(false), _completed(false), _failed(false) {}
+// How often a worker looks at the injection queue before its own queue, see acquire().
+static constexpr size_t injection_interval = 32;
+
+streamfx::util::threadpool::task::task(task_callback_t callback, task_data_t data) : _callback(callback), _data(data), _lock(), _status_changed(), _cancelled(false), _completed(false), _failed(false), _continuations_lock(), _continuations() {}
 
 streamfx::util::threadpool::task::~task() {}
 
 void streamfx::util::threadpool::task::run()
 {
-	std::lock_guard<std::mutex> lg(_lock);
-	if (!_cancelled) {
-		try {
-			_callback(_data);
-		} catch (const std::exception& ex) {
-			D_LOG_ERROR("Unhandled exception in Task: %s.", ex.what());
-			_failed = false;
-		} catch (...) {
-			D_LOG_ERROR("Unhandled exception in Task.", nullptr);
-			_failed = true;
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		if (!_cancelled) {
+			try {
+				_callback(_data);
+			} catch (const std::exception& ex) {
+				D_LOG_ERROR("Unhandled exception in Task: %s.", ex.what());
+				_failed = false;
+			} catch (...) {
+				D_LOG_ERROR("Unhandled exception in Task.", nullptr);
+				_failed = true;
+			}
 		}
+		_completed = true;
+		_status_changed.notify_all();
 	}
-	_completed = true;
-	_status_changed.notify_all();
+	continue_with();
 }
 
 void streamfx::util::threadpool::task::cancel()
 {
-	std::lock_guard<std::mutex> lg(_lock);
-	_cancelled = true;
-	_completed = true;
-	_status_changed.notify_all();
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		_cancelled = true;
+		_completed = true;
+		_status_changed.notify_all();
+	}
+	continue_with();
 }
 
 bool streamfx::util::threadpool::task::is_cancelled()
@@ -93,52 +108,355 @@ void streamfx::util::threadpool::task::await_completion()
 	wait();
 }
 
-streamfx::util::threadpool::threadpool::~threadpool()
+void streamfx::util::threadpool::task::then(std::function<void()> callback)
 {
-	{ // Terminate all remaining tasks.
-		std::lock_guard<std::mutex> lg(_tasks_lock);
-		for (auto task : _tasks) {
-			task->cancel();
+	{
+		std::lock_guard<std::mutex> lg(_continuations_lock);
+		if (!_completed) {
+			_continuations.emplace_back(std::move(callback));
+			return;
 		}
-		_tasks.clear();
 	}
+	callback();
+}
 
-	{ // Notify workers to stop working.
-		{
-			std::lock_guard<std::mutex> lg(_workers_lock);
-			for (auto worker : _workers) {
-				worker->stop = true;
+void streamfx::util::threadpool::task::continue_with()
+{
+	std::vector<std::function<void()>> continuations;
+	{
+		std::lock_guard<std::mutex> lg(_continuations_lock);
+		continuations.swap(_continuations);
+	}
+	for (auto& continuation : continuations) {
+		continuation();
+	}
+}
+
+streamfx::util::threadpool::job_pool::job_pool() : _free(0), _chunks_lock(), _chunks(), _chunk_count(0)
+{
+	for (auto& chunk : _chunks) {
+		chunk.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+streamfx::util::threadpool::job_pool::~job_pool()
+{
+	for (size_t idx = 0, edx = _chunk_count.load(); idx < edx; idx++) {
+		delete[] _chunks[idx].load();
+	}
+}
+
+streamfx::util::threadpool::job* streamfx::util::threadpool::job_pool::acquire()
+{
+	// The free list head stores a tag in the upper 32 bits, and the index + 1 of the first free job in the lower 32 bits.
+	uint64_t head = _free.load(std::memory_order_acquire);
+	while (true) {
+		uint32_t index = static_cast<uint32_t>(head & 0xFFFFFFFFull);
+		if (index == 0) {
+			grow();
+			head = _free.load(std::memory_order_acquire);
+			continue;
+		}
+
+		job*     ptr  = at(index - 1);
+		uint64_t next = ((head & 0xFFFFFFFF00000000ull) + 0x100000000ull) | ptr->free_next.load(std::memory_order_relaxed);
+		if (_free.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+			ptr->prev = nullptr;
+			ptr->next = nullptr;
+			return ptr;
+		}
+	}
+}
+
+void streamfx::util::threadpool::job_pool::release(job* ptr)
+{
+	ptr->function.reset();
+	ptr->owner = nullptr;
+	ptr->tag   = nullptr;
+
+	uint64_t head = _free.load(std::memory_order_relaxed);
+	while (true) {
+		ptr->free_next.store(static_cast<uint32_t>(head & 0xFFFFFFFFull), std::memory_order_relaxed);
+		uint64_t next = ((head & 0xFFFFFFFF00000000ull) + 0x100000000ull) | (ptr->index + 1);
+		if (_free.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed)) {
+			return;
+		}
+	}
+}
+
+streamfx::util::threadpool::job* streamfx::util::threadpool::job_pool::at(uint32_t index)
+{
+	return &(_chunks[index / chunk_size].load(std::memory_order_acquire)[index % chunk_size]);
+}
+
+void streamfx::util::threadpool::job_pool::grow()
+{
+	std::lock_guard<std::mutex> lg(_chunks_lock);
+
+	// Someone else may have grown the pool while we waited.
+	if ((_free.load(std::memory_order_acquire) & 0xFFFFFFFFull) != 0) {
+		return;
+	}
+
+	size_t chunk = _chunk_count.load();
+	if (chunk >= max_chunks) {
+		throw std::runtime_error("Too many queued jobs.");
+	}
+
+	job* ptr = new job[chunk_size];
+	for (size_t idx = 0; idx < chunk_size; idx++) {
+		ptr[idx].index = static_cast<uint32_t>(chunk * chunk_size + idx);
+		ptr[idx].owner = nullptr;
+		ptr[idx].tag   = nullptr;
+	}
+	_chunks[chunk].store(ptr, std::memory_order_release);
+	_chunk_count.store(chunk + 1);
+
+	for (size_t idx = 0; idx < chunk_size; idx++) {
+		release(&ptr[idx]);
+	}
+}
+
+static void queue_push_back(streamfx::util::threadpool::task_queue& queue, streamfx::util::threadpool::job* ptr)
+{
+	ptr->next = nullptr;
+	ptr->prev = queue.tail;
+	if (queue.tail) {
+		queue.tail->next = ptr;
+	} else {
+		queue.head = ptr;
+	}
+	queue.tail = ptr;
+}
+
+static void queue_erase(streamfx::util::threadpool::task_queue& queue, streamfx::util::threadpool::job* ptr)
+{
+	if (ptr->prev) {
+		ptr->prev->next = ptr->next;
+	} else {
+		queue.head = ptr->next;
+	}
+	if (ptr->next) {
+		ptr->next->prev = ptr->prev;
+	} else {
+		queue.tail = ptr->prev;
+	}
+	ptr->prev = nullptr;
+	ptr->next = nullptr;
+}
+
+static int64_t telemetry_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void telemetry_cancelled(streamfx::util::threadpool::lane& lane, streamfx::util::threadpool::job* ptr)
+{
+	lane.stats.on_cancelled();
+	if (ptr->tag) {
+		ptr->tag->stats.on_cancelled();
+	}
+}
+
+streamfx::util::threadpool::placement_options streamfx::util::threadpool::placement_options::parse(std::string_view text)
+{
+	placement_options result;
+
+	auto trim = [](std::string_view value) {
+		while (!value.empty() && (value.front() == ' ')) {
+			value.remove_prefix(1);
+		}
+		while (!value.empty() && (value.back() == ' ')) {
+			value.remove_suffix(1);
+		}
+		return value;
+	};
+
+	while (!text.empty()) {
+		size_t           end   = text.find(';');
+		std::string_view entry = trim(text.substr(0, end));
+		text                   = (end == std::string_view::npos) ? std::string_view() : text.substr(end + 1);
+		if (entry.empty()) {
+			continue;
+		}
+		result.enabled = true;
+
+		size_t           split = entry.find('=');
+		std::string_view key   = trim(entry.substr(0, split));
+		std::string_view value = (split == std::string_view::npos) ? std::string_view() : trim(entry.substr(split + 1));
+		if (key == "reserve") {
+			result.reserved = streamfx::util::platform::parse_cpu_list(value);
+		} else if (key == "per_node") {
+			std::from_chars(value.data(), value.data() + value.size(), result.per_node);
+		} else if (key == "exclusive") {
+			result.exclusive = true;
+		}
+	}
+
+	return result;
+}
+
+// Thread-local information about the current worker, if any.
+thread_local static streamfx::util::threadpool::threadpool*  tl_pool   = nullptr;
+thread_local static streamfx::util::threadpool::worker_info* tl_worker = nullptr;
+
+streamfx::util::threadpool::threadpool::~threadpool()
+{
+	// Stop timers first, so that nothing new gets queued.
+	_timers->stop();
+
+	for (auto& lane : _lanes) {
+		{ // Terminate all remaining tasks.
+			auto cancel_all = [this, &lane](task_queue& queue) {
+				std::lock_guard<std::mutex> lg(queue.lock);
+				while (job* ptr = queue.head) {
+					queue_erase(queue, ptr);
+					telemetry_cancelled(*lane, ptr);
+					if (ptr->owner) {
+						ptr->owner->cancel();
+					}
+					_jobs.release(ptr);
+				}
+			};
+
+			cancel_all(lane->global);
+			for (auto& queue : lane->queues) {
+				cancel_all(*queue);
 			}
+			lane->pending = 0;
 		}
-		{
-			std::lock_guard<std::mutex> lg(_tasks_lock);
-			_tasks_cv.notify_all();
+
+		{ // Notify workers to stop working.
+			{
+				std::lock_guard<std::mutex> lg(lane->workers_lock);
+				for (auto worker : lane->workers) {
+					worker->stop = true;
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lg(lane->idle_lock);
+				lane->idle_cv.notify_all();
+			}
 		}
-		for (auto worker : _workers) {
+	}
+
+	// Wait for all workers to finish.
+	for (auto& lane : _lanes) {
+		for (auto worker : lane->workers) {
 			std::lock_guard<std::mutex> lg(worker->lifeline);
 		}
 	}
 }
 
-streamfx::util::threadpool::threadpool::threadpool(size_t minimum, size_t maximum) : _limits{minimum, maximum}, _workers_lock(), _worker_count(0), _workers(), _tasks_lock(), _tasks_cv(), _tasks()
+streamfx::util::threadpool::threadpool::threadpool(size_t minimum, size_t maximum, queue_mode mode, placement_options placement) : _mode(mode), _lanes(), _jobs(), _tags_lock(), _tags(), _timers(), _placement(placement), _topology(streamfx::util::platform::cpu_topology()), _topology_nodes(), _placement_lock(), _node_workers(), _cpu_workers()
 {
+	// Remember which node each processor belongs to, so that workers can tell when they were moved to another node.
+	for (auto& cpu : _topology) {
+		if (cpu.id >= _topology_nodes.size()) {
+			_topology_nodes.resize(cpu.id + 1, 0);
+		}
+		_topology_nodes[cpu.id] = cpu.node;
+	}
+
+	// Realtime work should start immediately, so it spawns a new worker for every queued task.
+	constexpr std::array<size_t, priority_count> thresholds{1, 3, 3};
+
+	std::array<std::pair<size_t, size_t>, priority_count> limits{
+		std::pair<size_t, size_t>{0, std::max<size_t>(maximum / 4, 1)},
+		std::pair<size_t, size_t>{0, std::max<size_t>(maximum / 2, 1)},
+		std::pair<size_t, size_t>{minimum, maximum},
+	};
+
+	for (size_t idx = 0; idx < priority_count; idx++) {
+		auto lane = std::make_unique<streamfx::util::threadpool::lane>();
+
+		lane->klass        = static_cast<priority>(idx);
+		lane->limits       = limits[idx];
+		lane->threshold    = thresholds[idx];
+		lane->worker_count = 0;
+		lane->pending      = 0;
+		lane->idle         = 0;
+		lane->spawned      = 0;
+		lane->died         = 0;
+		lane->migrations   = 0;
+
+		if (_placement.enabled) {
+			auto usable = [this](streamfx::util::platform::cpu_info const& cpu) { return std::find(_placement.reserved.begin(), _placement.reserved.end(), cpu.id) == _placement.reserved.end(); };
+
+			// Prefer the core type that suits the lane, but use whatever is there on systems without it.
+			auto preferred = (lane->klass == priority::background) ? streamfx::util::platform::core_type::efficiency : streamfx::util::platform::core_type::performance;
+			for (auto& cpu : _topology) {
+				if (usable(cpu) && (cpu.type == preferred)) {
+					lane->cpus.push_back(cpu.id);
+				}
+			}
+			if (lane->cpus.empty()) {
+				for (auto& cpu : _topology) {
+					if (usable(cpu)) {
+						lane->cpus.push_back(cpu.id);
+					}
+				}
+			}
+			if (lane->cpus.empty()) {
+				D_LOG_WARNING("All processors are reserved, ignoring the reservation.", nullptr);
+				for (auto& cpu : _topology) {
+					lane->cpus.push_back(cpu.id);
+				}
+			}
+
+			// Order processors so that the first logical processor of every core comes before any SMT siblings.
+			std::map<size_t, size_t> rank;
+			{
+				std::map<size_t, size_t> siblings;
+				for (auto& cpu : _topology) {
+					rank[cpu.id] = siblings[cpu.core]++;
+				}
+			}
+			std::stable_sort(lane->cpus.begin(), lane->cpus.end(), [&rank](size_t a, size_t b) { return rank[a] < rank[b]; });
+
+			// Never have more workers than processors to run them on.
+			std::set<size_t> nodes;
+			for (auto cpu : lane->cpus) {
+				nodes.insert(_topology_nodes[cpu]);
+			}
+			size_t cap = lane->cpus.size();
+			if (_placement.per_node > 0) {
+				cap = std::min(cap, _placement.per_node * nodes.size());
+			}
+			lane->limits.second = std::max<size_t>(std::min(lane->limits.second, cap), 1);
+			lane->limits.first  = std::min(lane->limits.first, lane->limits.second);
+		}
+
+		if (_mode == queue_mode::work_stealing) {
+			// Each potential worker gets its own queue, which remains alive even when the worker dies.
+			lane->queues.resize(std::max<size_t>(lane->limits.second, 1));
+			for (auto& queue : lane->queues) {
+				queue = std::make_unique<task_queue>();
+			}
+			lane->workers_queues.resize(lane->queues.size(), false);
+		}
+
+		_lanes[idx] = std::move(lane);
+	}
+
+	// The timer wheel registers its own tag, so it can only be created once everything else exists.
+	_timers = std::make_shared<timer_wheel>(this);
+
 	// Spawn the minimum number of threads.
-	spawn(_limits.first);
+	for (auto& lane : _lanes) {
+		spawn(*lane, lane->limits.first);
+	}
 }
 
-std::shared_ptr<streamfx::util::threadpool::task> streamfx::util::threadpool::threadpool::push(task_callback_t callback, task_data_t data /*= nullptr*/)
+std::shared_ptr<streamfx::util::threadpool::task> streamfx::util::threadpool::threadpool::push(task_callback_t callback, task_data_t data /*= nullptr*/, priority klass /*= priority::background*/, task_tag* tag /*= nullptr*/)
 {
-	std::lock_guard<std::mutex> lg(_tasks_lock);
-	constexpr size_t            threshold = 3;
-
-	// Enqueue the new task.
 	auto task = std::make_shared<streamfx::util::threadpool::task>(callback, data);
-	_tasks.emplace_back(task);
 
-	// Spawn additional workers if the number of queued tasks exceeds a threshold.
-	if (_tasks.size() > (threshold * _worker_count)) {
-		spawn(_tasks.size() / threshold);
-	}
+	job* ptr   = _jobs.acquire();
+	ptr->owner = task.get();
+	ptr->tag   = tag;
+	ptr->function.emplace([task]() { task->run(); });
+	submit(ptr, klass);
 
 	// Return handle to caller.
 	return task;
@@ -146,25 +464,331 @@ std::shared_ptr<streamfx::util::threadpool::task> streamfx::util::threadpool::th
 
 void streamfx::util::threadpool::threadpool::pop(std::shared_ptr<task> task)
 {
-	if (task) {
-		task->cancel();
+	if (!task) {
+		return;
+	}
+	task->cancel();
+
+	auto remove = [this, &task](lane& lane, task_queue& queue) {
+		job* found = nullptr;
+		{
+			std::lock_guard<std::mutex> lg(queue.lock);
+			for (job* ptr = queue.head; ptr; ptr = ptr->next) {
+				if (ptr->owner == task.get()) {
+					queue_erase(queue, ptr);
+					--lane.pending;
+					telemetry_cancelled(lane, ptr);
+					found = ptr;
+					break;
+				}
+			}
+		}
+		if (found) {
+			_jobs.release(found);
+		}
+		return found != nullptr;
+	};
+
+	for (auto& lane : _lanes) {
+		if (remove(*lane, lane->global)) {
+			return;
+		}
+		for (auto& queue : lane->queues) {
+			if (remove(*lane, *queue)) {
+				return;
+			}
+		}
+	}
+}
+
+std::shared_ptr<streamfx::util::threadpool::timer> streamfx::util::threadpool::threadpool::schedule_after(std::chrono::milliseconds delay, timer_callback_t callback, priority klass)
+{
+	return _timers->schedule(delay, std::chrono::milliseconds(0), callback, klass);
+}
+
+std::shared_ptr<streamfx::util::threadpool::timer> streamfx::util::threadpool::threadpool::schedule_every(std::chrono::milliseconds interval, timer_callback_t callback, priority klass)
+{
+	return _timers->schedule(interval, interval, callback, klass);
+}
+
+streamfx::util::threadpool::queue_mode streamfx::util::threadpool::threadpool::mode() const
+{
+	return _mode;
+}
+
+size_t streamfx::util::threadpool::threadpool::concurrency(priority klass) const
+{
+	return _lanes[static_cast<size_t>(klass)]->limits.second;
+}
+
+streamfx::util::threadpool::task_tag* streamfx::util::threadpool::threadpool::tag(std::string_view name)
+{
+	std::lock_guard<std::mutex> lg(_tags_lock);
+	if (auto itr = _tags.find(name); itr != _tags.end()) {
+		return itr->second.get();
+	}
+	return _tags.emplace(std::string(name), std::make_unique<task_tag>(name)).first->second.get();
+}
+
+streamfx::util::threadpool::telemetry streamfx::util::threadpool::threadpool::snapshot()
+{
+	telemetry result;
+
+	for (size_t idx = 0; idx < priority_count; idx++) {
+		auto& lane                   = *_lanes[idx];
+		result.lanes[idx].klass      = lane.klass;
+		result.lanes[idx].tasks      = lane.stats.snapshot();
+		result.lanes[idx].workers    = lane.worker_count.load();
+		result.lanes[idx].spawned    = lane.spawned.load();
+		result.lanes[idx].died       = lane.died.load();
+		result.lanes[idx].migrations = lane.migrations.load();
+	}
+
+	std::lock_guard<std::mutex> lg(_tags_lock);
+	result.tags.reserve(_tags.size());
+	for (auto& kv : _tags) {
+		result.tags.push_back({kv.first, kv.second->stats.snapshot()});
+	}
+
+	return result;
+}
+
+void streamfx::util::threadpool::threadpool::log_telemetry()
+{
+	constexpr std::array<const char*, priority_count> names{"Realtime", "Interactive", "Background"};
+
+	// Histograms report -1ns for percentiles of nothing, which is better shown as zero.
+	auto to_us = [](std::chrono::nanoseconds value) { return static_cast<double_t>(std::max<int64_t>(value.count(), 0)) / 1000.; };
+	auto mean  = [](streamfx::util::profiler::histogram const& value) { return (value.count() > 0) ? (value.average_duration() / 1000.) : 0.; };
+
+	auto data = snapshot();
+	for (auto& lane : data.lanes) {
+		auto& tasks = lane.tasks;
+		D_LOG_INFO("%s: %" PRIu64 " queued, %" PRIu64 " completed, %" PRIu64 " cancelled, depth %zu (peak %zu), %zu workers (%" PRIu64 " spawned, %" PRIu64 " died, %" PRIu64 " node migrations).", names[static_cast<size_t>(lane.klass)], tasks.queued, tasks.completed, tasks.cancelled, tasks.depth, tasks.depth_peak, lane.workers, lane.spawned, lane.died, lane.migrations);
+		D_LOG_INFO("%s: Wait %.1f / %.1f / %.1f / %.1f us, Run %.1f / %.1f / %.1f / %.1f us (mean / p50 / p99 / max).", names[static_cast<size_t>(lane.klass)], mean(tasks.wait), to_us(tasks.wait.percentile(0.50)), to_us(tasks.wait.percentile(0.99)), to_us(tasks.wait.maximum()), mean(tasks.run), to_us(tasks.run.percentile(0.50)), to_us(tasks.run.percentile(0.99)), to_us(tasks.run.maximum()));
+	}
+	for (auto& tag : data.tags) {
+		auto& tasks = tag.tasks;
+		D_LOG_INFO("'%s': %" PRIu64 " queued, %" PRIu64 " completed, %" PRIu64 " cancelled, depth %zu (peak %zu), Wait %.1f / %.1f us, Run %.1f / %.1f us (p99 / max).", tag.name.c_str(), tasks.queued, tasks.completed, tasks.cancelled, tasks.depth, tasks.depth_peak, to_us(tasks.wait.percentile(0.99)), to_us(tasks.wait.maximum()), to_us(tasks.run.percentile(0.99)), to_us(tasks.run.maximum()));
+	}
+}
+
+void streamfx::util::threadpool::threadpool::submit(job* ptr, priority klass)
+{
+	auto& lane = *_lanes[static_cast<size_t>(klass)];
+
+	// Counters must be updated before a worker can see the job.
+	ptr->queued = telemetry_now();
+	lane.stats.on_queued();
+	if (ptr->tag) {
+		ptr->tag->stats.on_queued();
+	}
+
+	// Enqueue the new job.
+	if ((_mode == queue_mode::work_stealing) && (tl_pool == this) && tl_worker && (tl_worker->owner == &lane)) {
+		// Workers keep their own work local, which is usually still hot in cache.
+		enqueue(lane, *lane.queues[tl_worker->queue], ptr);
+	} else {
+		// Everyone else goes through the injection queue, which is served oldest first.
+		enqueue(lane, lane.global, ptr);
+	}
+	notify(lane);
+
+	// Spawn additional workers if the number of queued tasks exceeds a threshold. Lanes without a minimum may have no
+	// workers at all, and then need one even for fewer tasks than the threshold.
+	if (size_t pending = lane.pending.load(); pending > (lane.threshold * lane.worker_count.load())) {
+		spawn(lane, std::max<size_t>(pending / lane.threshold, 1));
+	}
+}
+
+void streamfx::util::threadpool::threadpool::enqueue(lane& lane, task_queue& queue, job* ptr)
+{
+	std::lock_guard<std::mutex> lg(queue.lock);
+	queue_push_back(queue, ptr);
+	++lane.pending;
+}
+
+streamfx::util::threadpool::job* streamfx::util::threadpool::threadpool::dequeue(lane& lane, task_queue& queue, bool lifo)
+{
+	std::lock_guard<std::mutex> lg(queue.lock);
+
+	job* ptr = lifo ? queue.tail : queue.head;
+	if (ptr) {
+		queue_erase(queue, ptr);
+		--lane.pending;
+	}
+
+	return ptr;
+}
+
+streamfx::util::threadpool::job* streamfx::util::threadpool::threadpool::acquire(std::shared_ptr<worker_info> wi)
+{
+	auto& lane = *wi->owner;
+
+	if (lane.pending.load(std::memory_order_acquire) == 0) {
+		return nullptr;
+	}
+
+	if (_mode != queue_mode::work_stealing) {
+		return dequeue(lane, lane.global, false);
+	}
+
+	// A worker that keeps feeding itself would never get to the injection queue, so look there first every now and then.
+	bool injected_first = ((++wi->acquired) % injection_interval) == 0;
+	if (injected_first) {
+		if (auto ptr = dequeue(lane, lane.global, false); ptr) {
+			return ptr;
+		}
+	}
+
+	// Prefer our own queue, taking the most recently pushed job.
+	if (auto ptr = dequeue(lane, *lane.queues[wi->queue], true); ptr) {
+		return ptr;
+	}
+
+	// Then work that was pushed from outside of the pool, oldest first.
+	if (!injected_first) {
+		if (auto ptr = dequeue(lane, lane.global, false); ptr) {
+			return ptr;
+		}
+	}
+
+	// Otherwise steal the oldest job from someone else.
+	for (size_t idx = 1, edx = lane.queues.size(); idx < edx; idx++) {
+		if (auto ptr = dequeue(lane, *lane.queues[(wi->queue + idx) % edx], false); ptr) {
+			return ptr;
+		}
+	}
+
+	return nullptr;
+}
+
+void streamfx::util::threadpool::threadpool::execute(lane& lane, job* ptr)
+{
+	task_tag* tag   = ptr->tag;
+	int64_t   start = telemetry_now();
+	lane.stats.on_started(std::chrono::nanoseconds(start - ptr->queued));
+	if (tag) {
+		tag->stats.on_started(std::chrono::nanoseconds(start - ptr->queued));
+	}
+
+	// Waitable tasks handle their own exceptions, so this only catches those of dispatched callables.
+	try {
+		ptr->function();
+	} catch (const std::exception& ex) {
+		D_LOG_ERROR("Unhandled exception in Task: %s.", ex.what());
+	} catch (...) {
+		D_LOG_ERROR("Unhandled exception in Task.", nullptr);
+	}
+	_jobs.release(ptr);
+
+	int64_t end = telemetry_now();
+	lane.stats.on_completed(std::chrono::nanoseconds(end - start));
+	if (tag) {
+		tag->stats.on_completed(std::chrono::nanoseconds(end - start));
+	}
+	streamfx::util::trace::complete("threadpool", tag ? tag->name() : "task", start, end);
+}
+
+void streamfx::util::threadpool::threadpool::notify(lane& lane)
+{
+	// Only touch the lock if someone is actually waiting for work.
+	if (lane.idle.load() > 0) {
+		std::lock_guard<std::mutex> lg(lane.idle_lock);
+		lane.idle_cv.notify_one();
+	}
+}
+
+bool streamfx::util::threadpool::threadpool::place(lane& lane, worker_info& wi)
+{
+	wi.affinity.clear();
+	wi.node = 0;
+	if (!_placement.enabled) {
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lg(_placement_lock);
+
+	// Group the usable processors by node, keeping their order.
+	std::map<size_t, std::vector<size_t>> nodes;
+	for (auto cpu : lane.cpus) {
+		nodes[_topology_nodes[cpu]].push_back(cpu);
+	}
+
+	// Pick the node with the fewest workers that still has room for one more.
+	auto best = nodes.end();
+	for (auto itr = nodes.begin(); itr != nodes.end(); itr++) {
+		size_t count = _node_workers[itr->first];
+		if ((_placement.per_node > 0) && (count >= _placement.per_node)) {
+			continue;
+		}
+		if ((best == nodes.end()) || (count < _node_workers[best->first])) {
+			best = itr;
+		}
+	}
+	if (best == nodes.end()) {
+		return false;
+	}
+
+	wi.node = best->first;
+	if (_placement.exclusive) {
+		// Processors are ordered so that this fills up cores before it starts using their SMT siblings.
+		size_t cpu  = *std::min_element(best->second.begin(), best->second.end(), [this](size_t a, size_t b) { return _cpu_workers[a] < _cpu_workers[b]; });
+		wi.affinity = {cpu};
+		_cpu_workers[cpu]++;
+	} else {
+		wi.affinity = best->second;
+	}
+	_node_workers[wi.node]++;
+
+	return true;
+}
+
+void streamfx::util::threadpool::threadpool::unplace(worker_info& wi)
+{
+	if (wi.affinity.empty()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lg(_placement_lock);
+	_node_workers[wi.node]--;
+	if (_placement.exclusive) {
+		_cpu_workers[wi.affinity.front()]--;
 	}
-	std::lock_guard<std::mutex> lg(_tasks_lock);
-	_tasks.remove(task);
 }
 
-void streamfx::util::threadpool::threadpool::spawn(size_t count)
+void streamfx::util::threadpool::threadpool::spawn(lane& lane, size_t count)
 {
-	std::lock_guard<std::mutex> lg(_workers_lock);
-	for (size_t n = 0; (n < count) && (_worker_count < _limits.second); n++) {
+	std::lock_guard<std::mutex> lg(lane.workers_lock);
+	for (size_t n = 0; (n < count) && (lane.worker_count < lane.limits.second); n++) {
 		auto wi            = std::make_shared<worker_info>();
 		wi->stop           = false;
 		wi->last_work_time = std::chrono::high_resolution_clock::now();
-		wi->thread         = std::thread(std::bind(&streamfx::util::threadpool::threadpool::work, this, wi));
+		wi->owner          = &lane;
+		wi->queue          = 0;
+		wi->acquired       = 0;
+		if (_mode == queue_mode::work_stealing) {
+			// Claim the first unowned queue.
+			auto itr = std::find(lane.workers_queues.begin(), lane.workers_queues.end(), false);
+			if (itr == lane.workers_queues.end()) {
+				break;
+			}
+			*itr      = true;
+			wi->queue = static_cast<size_t>(std::distance(lane.workers_queues.begin(), itr));
+		}
+		if (!place(lane, *wi)) {
+			// Every node the lane may use is full.
+			if (_mode == queue_mode::work_stealing) {
+				lane.workers_queues[wi->queue] = false;
+			}
+			break;
+		}
+		wi->thread = std::thread(std::bind(&streamfx::util::threadpool::threadpool::work, this, wi));
 		wi->thread.detach();
-		_workers.emplace_back(wi);
-		++_worker_count;
-		D_LOG_DEBUG("Spawning new worker thread (%zu < %zu < %zu).", _limits.first, _worker_count.load(), _limits.second);
+		lane.workers.emplace_back(wi);
+		++lane.worker_count;
+		++lane.spawned;
+		D_LOG_DEBUG("Spawning new worker thread (%zu < %zu < %zu).", lane.limits.first, lane.worker_count.load(), lane.limits.second);
 	}
 }
 
@@ -172,18 +796,32 @@ bool streamfx::util::threadpool::threadpool::die(std::shared_ptr<worker_info> wi
 {
 	constexpr std::chrono::seconds delay{1};
 
-	std::lock_guard<std::mutex> lg(_workers_lock);
+	auto&                       lane = *wi->owner;
+	std::lock_guard<std::mutex> lg(lane.workers_lock);
 	bool                        result = false;
 
-	if (_worker_count > _limits.first) {
+	if (lane.worker_count > lane.limits.first) {
 		auto now = std::chrono::high_resolution_clock::now();
-		result   = ((wi->last_work_time + delay) <= now) && ((_last_worker_death + delay) <= now);
+		result   = ((wi->last_work_time + delay) <= now) && ((lane.last_worker_death + delay) <= now);
 
 		if (result) {
-			_last_worker_death = now;
-			--_worker_count;
-			_workers.remove(wi);
-			D_LOG_DEBUG("Terminated idle worker thread (%zu < %zu < %zu).", _limits.first, _worker_count.load(), _limits.second);
+			--lane.worker_count;
+
+			// Work may have been pushed while we were deciding, and the pusher may not have seen us leave.
+			if (lane.pending > 0) {
+				++lane.worker_count;
+				return false;
+			}
+
+			lane.last_worker_death = now;
+			lane.workers.remove(wi);
+			++lane.died;
+			unplace(*wi);
+			if (_mode == queue_mode::work_stealing) {
+				// Anything left behind in the queue will be stolen by the remaining workers.
+				lane.workers_queues[wi->queue] = false;
+			}
+			D_LOG_DEBUG("Terminated idle worker thread (%zu < %zu < %zu).", lane.limits.first, lane.worker_count.load(), lane.limits.second);
 		}
 	}
 
@@ -192,49 +830,112 @@ bool streamfx::util::threadpool::threadpool::die(std::shared_ptr<worker_info> wi
 
 void streamfx::util::threadpool::threadpool::work(std::shared_ptr<worker_info> wi)
 {
-	std::shared_ptr<streamfx::util::threadpool::task> task{};
-	std::lock_guard<std::mutex>                       lg(wi->lifeline);
+	std::lock_guard<std::mutex> lg(wi->lifeline);
+	auto&                       lane = *wi->owner;
+
+	tl_pool   = this;
+	tl_worker = wi.get();
+
+	if (!wi->affinity.empty() && !streamfx::util::platform::set_thread_affinity(wi->affinity)) {
+		D_LOG_WARNING("Failed to pin worker thread to its processors.", nullptr);
+	}
 
+	// Only systems with more than one node can migrate between them.
+	bool numa         = std::adjacent_find(_topology_nodes.begin(), _topology_nodes.end(), std::not_equal_to<size_t>()) != _topology_nodes.end();
+	auto current_node = [this]() {
+		size_t cpu = streamfx::util::platform::current_cpu();
+		return (cpu < _topology_nodes.size()) ? _topology_nodes[cpu] : size_t(0);
+	};
+	size_t node = numa ? current_node() : 0;
+
+	// Apply the scheduling policy of the lane to this thread.
 #if defined(D_PLATFORM_WINDOWS)
-	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN | THREAD_PRIORITY_BELOW_NORMAL);
-	SetThreadDescription(GetCurrentThread(), L"StreamFX Worker Thread");
+	switch (lane.klass) {
+	case priority::realtime:
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+		SetThreadDescription(GetCurrentThread(), L"StreamFX Worker Thread (Realtime)");
+		break;
+	case priority::interactive:
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+		SetThreadDescription(GetCurrentThread(), L"StreamFX Worker Thread (Interactive)");
+		break;
+	case priority::background:
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN | THREAD_PRIORITY_BELOW_NORMAL);
+		SetThreadDescription(GetCurrentThread(), L"StreamFX Worker Thread");
+		break;
+	}
 #elif defined(D_PLATFORM_LINUX)
+	// Thread names are limited to 15 characters.
 	struct sched_param param;
-	param.sched_priority = 0;
-	pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
-	pthread_setname_np(pthread_self(), "StreamFX Worker Thread");
+	switch (lane.klass) {
+	case priority::realtime:
+		// Real-time scheduling requires privileges we may not have, so fall back to normal scheduling.
+		param.sched_priority = sched_get_priority_min(SCHED_RR);
+		if (pthread_setschedparam(pthread_self(), SCHED_RR, &param) != 0) {
+			param.sched_priority = 0;
+			pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+		}
+		pthread_setname_np(pthread_self(), "StreamFX RT");
+		break;
+	case priority::interactive:
+		param.sched_priority = 0;
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+		pthread_setname_np(pthread_self(), "StreamFX Int");
+		break;
+	case priority::background:
+		param.sched_priority = 0;
+		pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+		pthread_setname_np(pthread_self(), "StreamFX Worker");
+		break;
+	}
 #endif
+	switch (lane.klass) {
+	case priority::realtime:
+		streamfx::util::trace::name_thread("StreamFX Worker Thread (Realtime)");
+		break;
+	case priority::interactive:
+		streamfx::util::trace::name_thread("StreamFX Worker Thread (Interactive)");
+		break;
+	case priority::background:
+		streamfx::util::trace::name_thread("StreamFX Worker Thread");
+		break;
+	}
 
 	while (!wi->stop) {
-		{ // Try and acquire new work.
-			std::unique_lock<std::mutex> ul(_tasks_lock);
-
-			// Is there any work available right now?
-			if (_tasks.size() == 0) { // If not:
-				// Block this thread until it is notified of a change.
-				_tasks_cv.wait_until(ul, std::chrono::time_point(std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(250)), [this, wi]() { return wi->stop || _tasks.size() > 0; });
+		// Try and acquire new work.
+		if (job* ptr = acquire(wi); ptr) {
+			wi->last_work_time = std::chrono::high_resolution_clock::now();
+			execute(lane, ptr);
+
+			if (numa) {
+				if (size_t now = current_node(); now != node) {
+					++lane.migrations;
+					node = now;
+				}
 			}
+			continue;
+		}
 
-			// If we were asked to stop, skip everything.
-			if (wi->stop) {
-				continue;
-			}
+		{ // Block this thread until it is notified of a change.
+			std::unique_lock<std::mutex> ul(lane.idle_lock);
+			++lane.idle;
+			lane.idle_cv.wait_until(ul, std::chrono::time_point(std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(250)), [&lane, wi]() { return wi->stop || (lane.pending > 0); });
+			--lane.idle;
+		}
 
-			// If there is work to be done, take it.
-			if (_tasks.size() > 0) {
-				wi->last_work_time = std::chrono::high_resolution_clock::now();
-				task               = _tasks.front();
-				_tasks.pop_front();
-			} else if (die(wi)) { // Is the threadpool requesting less threads?
-				break;
-			}
+		// If we were asked to stop, skip everything.
+		if (wi->stop) {
+			continue;
 		}
 
-		if (task) {
-			task->run();
-			task.reset();
+		// Is the threadpool requesting less threads?
+		if ((lane.pending == 0) && die(wi)) {
+			break;
 		}
 	}
+
+	tl_worker = nullptr;
+	tl_pool   = nullptr;
 }
 
 std::shared_ptr<streamfx::util::threadpool::threadpool> streamfx::util::threadpool::threadpool::instance()
@@ -245,7 +946,22 @@ std::shared_ptr<streamfx::util::threadpool::threadpool> streamfx::util::threadpo
 	std::unique_lock<decltype(mtx)> lock(mtx);
 	auto                            instance = winst.lock();
 	if (!instance) {
-		instance = std::shared_ptr<streamfx::util::threadpool::threadpool>(new streamfx::util::threadpool::threadpool());
+		// Placement is meant for dedicated machines, so it is only enabled through the environment.
+		std::string placement;
+#if defined(D_PLATFORM_WINDOWS)
+		char*  env_value     = nullptr;
+		size_t env_value_len = 0;
+		if ((_dupenv_s(&env_value, &env_value_len, "STREAMFX_THREADPOOL_PLACEMENT") == 0) && env_value) {
+			placement = env_value;
+			free(env_value);
+		}
+#else
+		if (const char* env_value = getenv("STREAMFX_THREADPOOL_PLACEMENT"); env_value) {
+			placement = env_value;
+		}
+#endif
+
+		instance = std::shared_ptr<streamfx::util::threadpool::threadpool>(new streamfx::util::threadpool::threadpool(2, std::thread::hardware_concurrency(), queue_mode::work_stealing, placement_options::parse(placement)));
 		winst    = instance;
 	}
 	return instance;
@@ -259,6 +975,7 @@ static auto loader = streamfx::component(
 		loader_instance = streamfx::util::threadpool::threadpool::instance();
 	},
 	[]() { // Finalizer
+		loader_instance->log_telemetry();
 		loader_instance.reset();
 	},
 	{});
@@ -4,6 +4,7 @@
 
 #pragma once
 #include "warning-disable.hpp"
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cinttypes>
@@ -11,17 +12,206 @@
 #include <cstddef>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <new>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "warning-enable.hpp"
 
+#include "util/util-telemetry.hpp"
+#include "util/util-timer.hpp"
+#include "util/util-topology.hpp"
+
 namespace streamfx::util::threadpool {
 	typedef std::shared_ptr<void>            task_data_t;
 	typedef std::function<void(task_data_t)> task_callback_t;
 
+	class task;
+
+	enum class queue_mode {
+		/** All workers share a single queue.
+		 */
+		global,
+
+		/** Each worker has its own queue, and idle workers steal from other queues.
+		 *
+		 * Tasks pushed from a worker thread go into the queue of that worker, which it works through newest first while
+		 * they are still hot in cache. Tasks pushed from any other thread go into a shared injection queue instead, which
+		 * is worked through oldest first, so that none of them can be buried under newer work.
+		 */
+		work_stealing,
+	};
+
+	enum class priority {
+		/** Latency critical work, such as forwarding audio.
+		 *
+		 * Runs on threads with elevated priority, and spawns additional threads as soon as a single task is queued.
+		 */
+		realtime,
+
+		/** Work that the user is actively waiting on.
+		 *
+		 * Runs on threads with normal priority.
+		 */
+		interactive,
+
+		/** Everything else, such as update checks or loading models.
+		 *
+		 * Runs on threads with the lowest possible priority.
+		 */
+		background,
+	};
+	constexpr size_t priority_count = 3;
+
+	/** How workers are placed on the processors of the system.
+	 *
+	 * Realtime and interactive workers prefer performance cores, background workers prefer efficiency cores. Each lane is
+	 * limited to the number of processors it may use, so that workers don't end up fighting over the same cores.
+	 */
+	struct placement_options {
+		/// Pin workers to processors according to the topology of the system.
+		bool enabled = false;
+
+		/// Logical processors which workers never run on, so that they remain free for OBS's own threads.
+		std::vector<size_t> reserved;
+
+		/// Maximum number of workers per NUMA node over all priority classes, or 0 for no limit.
+		size_t per_node = 0;
+
+		/// Pin each worker to a single logical processor, instead of to all usable processors of its NUMA node.
+		bool exclusive = false;
+
+		/** Parse options from text such as "reserve=0-3,8;per_node=4;exclusive".
+		 *
+		 * Any text that is not empty enables placement. Unknown keys are ignored.
+		 */
+		static placement_options parse(std::string_view text);
+	};
+
+	/** Fixed-size callable which never allocates.
+	 *
+	 * Callables that do not fit into the inline storage are rejected at compile time.
+	 */
+	template<size_t _size>
+	class inline_function {
+		alignas(std::max_align_t) unsigned char _storage[_size];
+		void (*_invoke)(void*);
+		void (*_destroy)(void*);
+
+		public:
+		inline_function() : _storage(), _invoke(nullptr), _destroy(nullptr) {}
+		~inline_function()
+		{
+			reset();
+		}
+
+		inline_function(const inline_function&)            = delete;
+		inline_function& operator=(const inline_function&) = delete;
+
+		template<typename _callable>
+		void emplace(_callable&& fn)
+		{
+			typedef std::decay_t<_callable> _type;
+			static_assert(sizeof(_type) <= _size, "Callable is too large for inline storage, capture less or capture by pointer.");
+			static_assert(alignof(_type) <= alignof(std::max_align_t), "Callable is over-aligned for inline storage.");
+
+			reset();
+			new (_storage) _type(std::forward<_callable>(fn));
+			_invoke  = [](void* ptr) { (*reinterpret_cast<_type*>(ptr))(); };
+			_destroy = [](void* ptr) { reinterpret_cast<_type*>(ptr)->~_type(); };
+		}
+
+		void reset()
+		{
+			if (_destroy) {
+				_destroy(_storage);
+			}
+			_invoke  = nullptr;
+			_destroy = nullptr;
+		}
+
+		void operator()()
+		{
+			_invoke(_storage);
+		}
+
+		explicit operator bool() const
+		{
+			return _invoke != nullptr;
+		}
+	};
+
+	/** Pooled unit of work, which is what the queues actually hold.
+	 */
+	struct job {
+		// Link in the queue it is currently in.
+		job* prev;
+		job* next;
+
+		// Link in the free list, by index.
+		std::atomic<uint32_t> free_next;
+		uint32_t              index;
+
+		// Handle for waitable tasks, if any.
+		task* owner;
+
+		// Telemetry, the tag is optional.
+		task_tag* tag;
+		int64_t   queued;
+
+		inline_function<64> function;
+	};
+
+	/** Lock-free pool of job slots.
+	 *
+	 * Slots are allocated in chunks and never freed until the pool is destroyed, so the steady state is free of heap
+	 * allocations. The free list is a tagged index stack to avoid the ABA problem.
+	 */
+	class job_pool {
+		static constexpr size_t chunk_size = 256;
+		static constexpr size_t max_chunks = 4096;
+
+#if __cpp_lib_hardware_interference_size >= 201603
+		alignas(std::hardware_destructive_interference_size)
+#endif
+			std::atomic<uint64_t> _free;
+
+		std::mutex                                _chunks_lock;
+		std::array<std::atomic<job*>, max_chunks> _chunks;
+		std::atomic<size_t>                       _chunk_count;
+
+		public:
+		job_pool();
+		~job_pool();
+
+		job* acquire();
+
+		void release(job* ptr);
+
+		private:
+		job* at(uint32_t index);
+
+		void grow();
+	};
+
+	struct task_queue {
+#if __cpp_lib_hardware_interference_size >= 201603
+		alignas(std::hardware_destructive_interference_size)
+#endif
+			std::mutex lock;
+		job*           head = nullptr;
+		job*           tail = nullptr;
+	};
+
+	struct lane;
+
 	struct worker_info {
 #if __cpp_lib_hardware_interference_size >= 201603
 		alignas(std::hardware_destructive_interference_size)
@@ -36,29 +226,100 @@ namespace streamfx::util::threadpool {
 		std::chrono::high_resolution_clock::time_point last_work_time;
 
 		std::thread thread;
+
+		// Lane this worker belongs to.
+		struct lane* owner;
+
+		// Index of the owned queue, only used with queue_mode::work_stealing.
+		size_t queue;
+
+		// Number of jobs taken so far, used to look at the injection queue first every now and then.
+		size_t acquired;
+
+		// Processors this worker is pinned to, only used with placement.
+		std::vector<size_t> affinity;
+		size_t              node;
 	};
 
-	class task {
-		task_callback_t _callback;
-		task_data_t     _data;
-		std::mutex      _lock;
+	/** A set of workers and queues that serves a single priority class.
+	 */
+	struct lane {
+		priority                  klass;
+		std::pair<size_t, size_t> limits;
+		size_t                    threshold;
 
 #if __cpp_lib_hardware_interference_size >= 201603
 		alignas(std::hardware_destructive_interference_size)
 #endif
-			std::condition_variable _status_changed;
+			std::mutex workers_lock;
+		std::list<std::shared_ptr<worker_info>> workers;
+		std::vector<bool>                       workers_queues;
+#if __cpp_lib_hardware_interference_size >= 201603
+		alignas(std::hardware_destructive_interference_size)
+#endif
+			std::atomic<size_t> worker_count;
+		std::chrono::high_resolution_clock::time_point last_worker_death;
+
+		// Shared by all workers with queue_mode::global, and the injection queue with queue_mode::work_stealing.
+		task_queue                               global;
+		std::vector<std::unique_ptr<task_queue>> queues;
+
 #if __cpp_lib_hardware_interference_size >= 201603
 		alignas(std::hardware_destructive_interference_size)
 #endif
-			std::atomic<bool> _cancelled;
+			std::atomic<size_t> pending;
 #if __cpp_lib_hardware_interference_size >= 201603
 		alignas(std::hardware_destructive_interference_size)
 #endif
-			std::atomic<bool> _completed;
+			std::atomic<size_t> idle;
 #if __cpp_lib_hardware_interference_size >= 201603
 		alignas(std::hardware_destructive_interference_size)
 #endif
-			std::atomic<bool> _failed;
+			std::mutex idle_lock;
+		std::condition_variable idle_cv;
+
+		statistics            stats;
+		std::atomic<uint64_t> spawned;
+		std::atomic<uint64_t> died;
+		std::atomic<uint64_t> migrations;
+
+		// Processors that workers of this lane may run on, only used with placement.
+		std::vector<size_t> cpus;
+	};
+
+	struct lane_snapshot {
+		priority            klass;
+		statistics_snapshot tasks;
+		size_t              workers;
+		uint64_t            spawned;
+		uint64_t            died;
+
+		/// Number of times a worker was found on a different NUMA node than for its previous task.
+		uint64_t migrations;
+	};
+
+	struct tag_snapshot {
+		std::string         name;
+		statistics_snapshot tasks;
+	};
+
+	struct telemetry {
+		std::array<lane_snapshot, priority_count> lanes;
+		std::vector<tag_snapshot>                 tags;
+	};
+
+	class task {
+		task_callback_t _callback;
+		task_data_t     _data;
+		std::mutex      _lock;
+
+		std::condition_variable _status_changed;
+		std::atomic<bool>       _cancelled;
+		std::atomic<bool>       _completed;
+		std::atomic<bool>       _failed;
+
+		std::mutex                         _continuations_lock;
+		std::vector<std::function<void()>> _continuations;
 
 		public:
 		task(task_callback_t callback, task_data_t data);
@@ -86,46 +347,135 @@ namespace streamfx::util::threadpool {
 
 		public:
 		void await_completion();
+
+		public:
+		/** Call a function once the task has completed or was cancelled.
+		 *
+		 * Runs immediately on the calling thread if that already happened, otherwise on the thread that finished or
+		 * cancelled the task. Never blocks, even while the task is running.
+		 */
+		void then(std::function<void()> callback);
+
+		private:
+		void continue_with();
 	};
 
 	class threadpool {
-		std::pair<size_t, size_t> _limits;
-
-#if __cpp_lib_hardware_interference_size >= 201603
-		alignas(std::hardware_destructive_interference_size)
-#endif
-			std::mutex _workers_lock;
-		std::list<std::shared_ptr<worker_info>> _workers;
-#if __cpp_lib_hardware_interference_size >= 201603
-		alignas(std::hardware_destructive_interference_size)
-#endif
-			std::atomic<size_t> _worker_count;
-		std::chrono::high_resolution_clock::time_point _last_worker_death;
+		queue_mode                                                    _mode;
+		std::array<std::unique_ptr<lane>, priority_count>             _lanes;
+		job_pool                                                      _jobs;
+		std::mutex                                                    _tags_lock;
+		std::map<std::string, std::unique_ptr<task_tag>, std::less<>> _tags;
+		std::shared_ptr<timer_wheel>                                  _timers;
 
-#if __cpp_lib_hardware_interference_size >= 201603
-		alignas(std::hardware_destructive_interference_size)
-#endif
-			std::mutex _tasks_lock;
-#if __cpp_lib_hardware_interference_size >= 201603
-		alignas(std::hardware_destructive_interference_size)
-#endif
-			std::condition_variable _tasks_cv;
-		std::list<std::shared_ptr<task>> _tasks;
+		placement_options                               _placement;
+		std::vector<streamfx::util::platform::cpu_info> _topology;
+		std::vector<size_t>                             _topology_nodes;
+		std::mutex                                      _placement_lock;
+		std::map<size_t, size_t>                        _node_workers;
+		std::map<size_t, size_t>                        _cpu_workers;
 
 		public:
 		~threadpool();
 
 		public:
-		threadpool(size_t minimum = 2, size_t maximum = std::thread::hardware_concurrency());
+		/** Create a new thread pool.
+		 *
+		 * @param minimum Minimum number of background workers.
+		 * @param maximum Maximum number of background workers. Realtime and interactive workers are limited to a quarter
+		 *                and half of this respectively, and only exist while there is work for them.
+		 * @param mode    How tasks are distributed between workers.
+		 * @param placement How workers are placed on processors, by default they are not pinned at all.
+		 */
+		threadpool(size_t minimum = 2, size_t maximum = std::thread::hardware_concurrency(), queue_mode mode = queue_mode::work_stealing, placement_options placement = {});
 
 		public:
-		std::shared_ptr<task> push(task_callback_t callback, task_data_t data = nullptr);
+		std::shared_ptr<task> push(task_callback_t callback, task_data_t data = nullptr, priority klass = priority::background, task_tag* tag = nullptr);
+
+		/** Queue a callable without creating a waitable handle.
+		 *
+		 * The callable is stored inline in a pooled job slot, so once the pool has warmed up this does not allocate. Use
+		 * push() instead if you need to wait for or cancel the work.
+		 */
+		template<typename _callable>
+		void dispatch(_callable&& fn, priority klass = priority::background, task_tag* tag = nullptr)
+		{
+			job* ptr   = _jobs.acquire();
+			ptr->owner = nullptr;
+			ptr->tag   = tag;
+			ptr->function.emplace(std::forward<_callable>(fn));
+			submit(ptr, klass);
+		}
 
 		public:
 		void pop(std::shared_ptr<task> task);
 
+		public:
+		/** Run a callback once after the given delay.
+		 *
+		 * The callback runs on a worker of the given priority class, never on the timer thread itself.
+		 */
+		std::shared_ptr<timer> schedule_after(std::chrono::milliseconds delay, timer_callback_t callback, priority klass = priority::background);
+
+		public:
+		/** Run a callback repeatedly at the given interval, until the timer is cancelled.
+		 *
+		 * If a call is still running when the next one is due, that call is skipped.
+		 */
+		std::shared_ptr<timer> schedule_every(std::chrono::milliseconds interval, timer_callback_t callback, priority klass = priority::background);
+
+		public:
+		queue_mode mode() const;
+
+		public:
+		/** Maximum number of workers that can run tasks of the given priority class at the same time.
+		 */
+		size_t concurrency(priority klass) const;
+
+		public:
+		/** Find or create the tag with the given name.
+		 *
+		 * Pass the tag to push() or dispatch() to track the tasks separately in telemetry. Look it up once and keep the
+		 * pointer, as this takes a lock.
+		 */
+		task_tag* tag(std::string_view name);
+
+		public:
+		/** Take a snapshot of all counters, per priority class and per tag.
+		 */
+		telemetry snapshot();
+
+		public:
+		/** Write a summary of snapshot() to the log.
+		 */
+		void log_telemetry();
+
+		private:
+		void submit(job* ptr, priority klass);
+
+		private:
+		void enqueue(lane& lane, task_queue& queue, job* ptr);
+
+		private:
+		job* dequeue(lane& lane, task_queue& queue, bool lifo);
+
+		private:
+		job* acquire(std::shared_ptr<worker_info> wi);
+
+		private:
+		void execute(lane& lane, job* ptr);
+
+		private:
+		void notify(lane& lane);
+
+		private:
+		bool place(lane& lane, worker_info& wi);
+
+		private:
+		void unplace(worker_info& wi);
+
 		private:
-		void spawn(size_t count = 1);
+		void spawn(lane& lane, size_t count = 1);
 
 		private:
 		bool die(std::shared_ptr<worker_info>);
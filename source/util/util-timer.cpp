@@ -0,0 +1,307 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "util-timer.hpp"
+#include "common.hpp"
+#include "util/util-logging.hpp"
+#include "util/util-threadpool.hpp"
+#include "util/util-trace.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include "warning-enable.hpp"
+
+#include "warning-disable.hpp"
+#if defined(D_PLATFORM_WINDOWS)
+#include <Windows.h>
+#elif defined(D_PLATFORM_LINUX)
+#include <pthread.h>
+#endif
+#include "warning-enable.hpp"
+
+#ifdef _DEBUG
+#define ST_PREFIX "<%s> "
+#define D_LOG_ERROR(x, ...) P_LOG_ERROR(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_WARNING(x, ...) P_LOG_WARN(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_INFO(x, ...) P_LOG_INFO(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_DEBUG(x, ...) P_LOG_DEBUG(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#else
+#define ST_PREFIX "<util::timer> "
+#define D_LOG_ERROR(...) P_LOG_ERROR(ST_PREFIX __VA_ARGS__)
+#define D_LOG_WARNING(...) P_LOG_WARN(ST_PREFIX __VA_ARGS__)
+#define D_LOG_INFO(...) P_LOG_INFO(ST_PREFIX __VA_ARGS__)
+#define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
+#endif
+
+streamfx::util::threadpool::timer::timer(std::weak_ptr<timer_wheel> wheel, timer_callback_t callback, priority klass, uint64_t expires, uint64_t interval) : _callback(callback), _klass(klass), _interval(interval), _expires(expires), _prev(nullptr), _next(nullptr), _slot(nullptr), _self(), _wheel(wheel), _cancelled(false), _fired(false), _in_flight(false), _run_lock(), _runner() {}
+
+streamfx::util::threadpool::timer::~timer() {}
+
+void streamfx::util::threadpool::timer::cancel()
+{
+	_cancelled = true;
+
+	// Keep ourselves alive, as the wheel may hold the last reference.
+	auto self = shared_from_this();
+	if (auto wheel = _wheel.lock(); wheel) {
+		std::lock_guard<std::mutex> lg(wheel->_lock);
+		if (_slot) {
+			wheel->remove(this);
+		}
+		_self.reset();
+	}
+
+	// Wait for a running callback, unless we are being called from it.
+	if (_runner.load() != std::this_thread::get_id()) {
+		std::lock_guard<std::mutex> lg(_run_lock);
+	}
+}
+
+bool streamfx::util::threadpool::timer::is_cancelled()
+{
+	return _cancelled;
+}
+
+bool streamfx::util::threadpool::timer::is_pending()
+{
+	return !_cancelled && !_fired;
+}
+
+void streamfx::util::threadpool::timer::run()
+{
+	{
+		std::lock_guard<std::mutex> lg(_run_lock);
+		if (!_cancelled) {
+			_runner = std::this_thread::get_id();
+			try {
+				_callback();
+			} catch (const std::exception& ex) {
+				D_LOG_ERROR("Unhandled exception in Timer: %s.", ex.what());
+			} catch (...) {
+				D_LOG_ERROR("Unhandled exception in Timer.", nullptr);
+			}
+			_runner = std::thread::id();
+		}
+	}
+	_in_flight = false;
+}
+
+streamfx::util::threadpool::timer_wheel::timer_wheel(threadpool* pool) : _pool(pool), _tag(pool->tag("util::timer")), _lock(), _cv(), _slots(), _now(0), _count(0), _epoch(std::chrono::steady_clock::now()), _thread(), _stop(false)
+{
+	for (auto& level : _slots) {
+		level.fill(nullptr);
+	}
+}
+
+streamfx::util::threadpool::timer_wheel::~timer_wheel()
+{
+	stop();
+}
+
+std::shared_ptr<streamfx::util::threadpool::timer> streamfx::util::threadpool::timer_wheel::schedule(std::chrono::milliseconds delay, std::chrono::milliseconds interval, timer_callback_t callback, priority klass)
+{
+	std::lock_guard<std::mutex> lg(_lock);
+	if (_stop) {
+		throw std::runtime_error("Timer wheel has been stopped.");
+	}
+
+	// Catch up first, so that the delay is relative to the actual current time.
+	if (_count == 0) {
+		_now = current_tick();
+	}
+
+	uint64_t ticks   = static_cast<uint64_t>(std::max<int64_t>(delay.count(), 1));
+	uint64_t repeats = static_cast<uint64_t>(std::max<int64_t>(interval.count(), 0));
+
+	auto result   = std::make_shared<timer>(weak_from_this(), callback, klass, _now + ticks, repeats);
+	result->_self = result;
+	insert(result.get());
+
+	// The wheel thread only exists once it is needed.
+	if (!_thread.joinable()) {
+		_thread = std::thread(&streamfx::util::threadpool::timer_wheel::work, this);
+	}
+	_cv.notify_all();
+
+	return result;
+}
+
+void streamfx::util::threadpool::timer_wheel::stop()
+{
+	std::thread thread;
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		_stop = true;
+		_pool = nullptr;
+
+		// Drop all timers, which breaks the self-references that keep periodic timers alive.
+		for (auto& level : _slots) {
+			for (auto& slot : level) {
+				while (timer* ptr = slot) {
+					ptr->_cancelled = true;
+					remove(ptr);
+					ptr->_self.reset();
+				}
+			}
+		}
+
+		thread.swap(_thread);
+		_cv.notify_all();
+	}
+
+	if (thread.joinable()) {
+		if (thread.get_id() == std::this_thread::get_id()) {
+			thread.detach();
+		} else {
+			thread.join();
+		}
+	}
+}
+
+uint64_t streamfx::util::threadpool::timer_wheel::current_tick()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _epoch).count());
+}
+
+void streamfx::util::threadpool::timer_wheel::insert(timer* ptr)
+{
+	uint64_t delta = (ptr->_expires > _now) ? (ptr->_expires - _now) : 0;
+	uint64_t when  = ptr->_expires;
+
+	// Find the lowest level that can represent the delay.
+	size_t level = 0;
+	while ((level < (levels - 1)) && (delta >= (uint64_t(1) << (level_bits * (level + 1))))) {
+		level++;
+	}
+	if (delta >= (uint64_t(1) << (level_bits * levels))) {
+		// Too far away, park it in the furthest slot and re-insert it once we get there.
+		when = _now + (uint64_t(1) << (level_bits * levels)) - 1;
+	}
+
+	timer** slot = &_slots[level][(when >> (level_bits * level)) & level_mask];
+	ptr->_slot   = slot;
+	ptr->_prev   = nullptr;
+	ptr->_next   = *slot;
+	if (*slot) {
+		(*slot)->_prev = ptr;
+	}
+	*slot = ptr;
+	_count++;
+}
+
+void streamfx::util::threadpool::timer_wheel::remove(timer* ptr)
+{
+	if (ptr->_prev) {
+		ptr->_prev->_next = ptr->_next;
+	} else {
+		*ptr->_slot = ptr->_next;
+	}
+	if (ptr->_next) {
+		ptr->_next->_prev = ptr->_prev;
+	}
+	ptr->_prev = nullptr;
+	ptr->_next = nullptr;
+	ptr->_slot = nullptr;
+	_count--;
+}
+
+void streamfx::util::threadpool::timer_wheel::cascade(size_t level)
+{
+	timer** slot = &_slots[level][(_now >> (level_bits * level)) & level_mask];
+	while (timer* ptr = *slot) {
+		remove(ptr);
+		insert(ptr);
+	}
+}
+
+void streamfx::util::threadpool::timer_wheel::advance()
+{
+	_now++;
+
+	// Move timers down from higher levels whenever the level below wraps around.
+	for (size_t level = 1; level < levels; level++) {
+		if ((_now & ((uint64_t(1) << (level_bits * level)) - 1)) != 0) {
+			break;
+		}
+		cascade(level);
+	}
+
+	timer** slot = &_slots[0][_now & level_mask];
+	timer*  ptr  = *slot;
+	while (ptr) {
+		timer* next = ptr->_next;
+		if (ptr->_expires <= _now) {
+			remove(ptr);
+			fire(ptr);
+		}
+		ptr = next;
+	}
+}
+
+void streamfx::util::threadpool::timer_wheel::fire(timer* ptr)
+{
+	std::shared_ptr<timer> self = ptr->_self;
+
+	if (ptr->_interval > 0) {
+		// Periodic timers keep their rate, but skip intervals that were missed entirely.
+		ptr->_expires += ptr->_interval;
+		if (ptr->_expires <= _now) {
+			ptr->_expires = _now + ptr->_interval;
+		}
+		insert(ptr);
+	} else {
+		ptr->_fired = true;
+		ptr->_self.reset();
+	}
+
+	// Never queue a callback twice, a slow callback just misses its next intervals.
+	if (_pool && !ptr->_cancelled && !ptr->_in_flight.exchange(true)) {
+		_pool->dispatch([self]() { self->run(); }, ptr->_klass, _tag);
+	}
+}
+
+uint64_t streamfx::util::threadpool::timer_wheel::next_event()
+{
+	// Anything on the lowest level?
+	for (uint64_t tick = _now + 1, end = _now + level_size; tick <= end; tick++) {
+		if (_slots[0][tick & level_mask]) {
+			return tick;
+		}
+		if ((tick & level_mask) == 0) {
+			// Higher levels cascade here, which may add timers to the lowest level.
+			return tick;
+		}
+	}
+	return _now + level_size;
+}
+
+void streamfx::util::threadpool::timer_wheel::work()
+{
+#if defined(D_PLATFORM_WINDOWS)
+	SetThreadDescription(GetCurrentThread(), L"StreamFX Timer Thread");
+#elif defined(D_PLATFORM_LINUX)
+	pthread_setname_np(pthread_self(), "StreamFX Timer");
+#endif
+	streamfx::util::trace::name_thread("StreamFX Timer Thread");
+
+	std::unique_lock<std::mutex> ul(_lock);
+	while (!_stop) {
+		if (_count == 0) {
+			_cv.wait(ul, [this]() { return _stop || (_count > 0); });
+			continue;
+		}
+
+		// Catch up with real time.
+		for (uint64_t target = current_tick(); (_now < target) && (_count > 0);) {
+			advance();
+		}
+		if (_count == 0) {
+			continue;
+		}
+
+		// Sleep until something may happen, or until the wheel changes.
+		auto wake = _epoch + std::chrono::milliseconds(next_event());
+		_cv.wait_until(ul, wake);
+	}
+}
@@ -0,0 +1,128 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "warning-disable.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "warning-enable.hpp"
+
+namespace streamfx::util::threadpool {
+	class threadpool;
+	class timer_wheel;
+	class task_tag;
+	enum class priority;
+
+	typedef std::function<void()> timer_callback_t;
+
+	/** Handle to a delayed or periodic callback.
+	 *
+	 * A periodic timer keeps running until it is cancelled, even if all handles to it are released.
+	 */
+	class timer : public std::enable_shared_from_this<timer> {
+		friend class timer_wheel;
+
+		timer_callback_t _callback;
+		priority         _klass;
+		uint64_t         _interval;
+		uint64_t         _expires;
+
+		// Intrusive links in the wheel slot this timer is in, guarded by the wheel.
+		timer*                 _prev;
+		timer*                 _next;
+		timer**                _slot;
+		std::shared_ptr<timer> _self;
+
+		std::weak_ptr<timer_wheel> _wheel;
+
+		std::atomic<bool> _cancelled;
+		std::atomic<bool> _fired;
+		std::atomic<bool> _in_flight;
+
+		std::mutex                   _run_lock;
+		std::atomic<std::thread::id> _runner;
+
+		public:
+		timer(std::weak_ptr<timer_wheel> wheel, timer_callback_t callback, priority klass, uint64_t expires, uint64_t interval);
+		~timer();
+
+		/** Stop the timer from firing again. O(1).
+		 *
+		 * If the callback is currently running on another thread, this waits for it to finish, so that anything the
+		 * callback references may safely be destroyed afterwards.
+		 */
+		void cancel();
+
+		bool is_cancelled();
+
+		/** Has the callback not been queued yet? Always true for periodic timers that were not cancelled.
+		 */
+		bool is_pending();
+
+		private:
+		void run();
+	};
+
+	/** Hierarchical timer wheel with a resolution of one millisecond.
+	 *
+	 * Four levels of 64 slots cover about 4.6 hours, longer delays are re-inserted when they reach the top level. The
+	 * wheel thread sleeps until the next slot that holds a timer, and hands expired callbacks to the thread pool instead
+	 * of running them itself.
+	 */
+	class timer_wheel : public std::enable_shared_from_this<timer_wheel> {
+		static constexpr size_t level_bits = 6;
+		static constexpr size_t level_size = size_t(1) << level_bits;
+		static constexpr size_t level_mask = level_size - 1;
+		static constexpr size_t levels     = 4;
+
+		threadpool* _pool;
+		task_tag*   _tag;
+
+		std::mutex                                         _lock;
+		std::condition_variable                            _cv;
+		std::array<std::array<timer*, level_size>, levels> _slots;
+		uint64_t                                           _now;
+		size_t                                             _count;
+		std::chrono::steady_clock::time_point              _epoch;
+		std::thread                                        _thread;
+		bool                                               _stop;
+
+		public:
+		timer_wheel(threadpool* pool);
+		~timer_wheel();
+
+		std::shared_ptr<timer> schedule(std::chrono::milliseconds delay, std::chrono::milliseconds interval, timer_callback_t callback, priority klass);
+
+		/** Stop the wheel thread and drop all timers. Called by the owning pool before it shuts down.
+		 */
+		void stop();
+
+		private:
+		friend class timer;
+
+		uint64_t current_tick();
+
+		void insert(timer* ptr);
+
+		void remove(timer* ptr);
+
+		void cascade(size_t level);
+
+		void advance();
+
+		void fire(timer* ptr);
+
+		uint64_t next_event();
+
+		void work();
+	};
+} // namespace streamfx::util::threadpool
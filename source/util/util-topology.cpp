@@ -0,0 +1,338 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "util-topology.hpp"
+#include "common.hpp"
+#include "util/util-logging.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include "warning-enable.hpp"
+
+#include "warning-disable.hpp"
+#if defined(D_PLATFORM_WINDOWS)
+#include <Windows.h>
+#elif defined(D_PLATFORM_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "warning-enable.hpp"
+
+#ifdef _DEBUG
+#define ST_PREFIX "<%s> "
+#define D_LOG_ERROR(x, ...) P_LOG_ERROR(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_WARNING(x, ...) P_LOG_WARN(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_INFO(x, ...) P_LOG_INFO(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_DEBUG(x, ...) P_LOG_DEBUG(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#else
+#define ST_PREFIX "<util::topology> "
+#define D_LOG_ERROR(...) P_LOG_ERROR(ST_PREFIX __VA_ARGS__)
+#define D_LOG_WARNING(...) P_LOG_WARN(ST_PREFIX __VA_ARGS__)
+#define D_LOG_INFO(...) P_LOG_INFO(ST_PREFIX __VA_ARGS__)
+#define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
+#endif
+
+std::vector<size_t> streamfx::util::platform::parse_cpu_list(std::string_view text)
+{
+	std::vector<size_t> result;
+
+	auto parse_number = [](std::string_view value, size_t& number) {
+		while (!value.empty() && (value.front() == ' ')) {
+			value.remove_prefix(1);
+		}
+		while (!value.empty() && ((value.back() == ' ') || (value.back() == '\n') || (value.back() == '\r'))) {
+			value.remove_suffix(1);
+		}
+		auto res = std::from_chars(value.data(), value.data() + value.size(), number);
+		return (res.ec == std::errc()) && (res.ptr == value.data() + value.size());
+	};
+
+	while (!text.empty()) {
+		size_t           comma = text.find(',');
+		std::string_view range = text.substr(0, comma);
+		text                   = (comma == std::string_view::npos) ? std::string_view() : text.substr(comma + 1);
+
+		size_t first, last;
+		if (size_t dash = range.find('-'); dash != std::string_view::npos) {
+			if (!parse_number(range.substr(0, dash), first) || !parse_number(range.substr(dash + 1), last)) {
+				continue;
+			}
+		} else {
+			if (!parse_number(range, first)) {
+				continue;
+			}
+			last = first;
+		}
+
+		for (size_t cpu = first; cpu <= last; cpu++) {
+			result.push_back(cpu);
+		}
+	}
+
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+#if defined(D_PLATFORM_LINUX)
+static bool read_sysfs(std::filesystem::path const& path, std::string& value)
+{
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	std::getline(file, value);
+	return true;
+}
+
+static size_t read_sysfs_number(std::filesystem::path const& path, size_t fallback)
+{
+	std::string value;
+	if (!read_sysfs(path, value)) {
+		return fallback;
+	}
+	auto cpus = streamfx::util::platform::parse_cpu_list(value);
+	return cpus.empty() ? fallback : cpus.front();
+}
+
+std::vector<streamfx::util::platform::cpu_info> streamfx::util::platform::cpu_topology()
+{
+	const std::filesystem::path cpu_path  = "/sys/devices/system/cpu";
+	const std::filesystem::path node_path = "/sys/devices/system/node";
+
+	std::vector<cpu_info> result;
+
+	std::string online;
+	if (!read_sysfs(cpu_path / "online", online)) {
+		// No sysfs, so assume a flat topology.
+		for (size_t idx = 0, edx = std::max<size_t>(std::thread::hardware_concurrency(), 1); idx < edx; idx++) {
+			result.push_back({idx, idx, 0, 0, core_type::unknown});
+		}
+		return result;
+	}
+
+	// NUMA nodes list their processors, rather than the other way around.
+	std::map<size_t, size_t> nodes;
+	std::error_code          ec;
+	for (auto& entry : std::filesystem::directory_iterator(node_path, ec)) {
+		auto name = entry.path().filename().string();
+		if ((name.rfind("node", 0) != 0) || (name.size() <= 4)) {
+			continue;
+		}
+
+		size_t node;
+		if (auto res = std::from_chars(name.data() + 4, name.data() + name.size(), node); res.ec != std::errc()) {
+			continue;
+		}
+
+		std::string list;
+		if (read_sysfs(entry.path() / "cpulist", list)) {
+			for (auto cpu : parse_cpu_list(list)) {
+				nodes[cpu] = node;
+			}
+		}
+	}
+
+	// Hybrid Intel processors expose one PMU per core type.
+	std::set<size_t> performance, efficiency;
+	if (std::string list; read_sysfs("/sys/devices/cpu_core/cpus", list)) {
+		for (auto cpu : parse_cpu_list(list)) {
+			performance.insert(cpu);
+		}
+	}
+	if (std::string list; read_sysfs("/sys/devices/cpu_atom/cpus", list)) {
+		for (auto cpu : parse_cpu_list(list)) {
+			efficiency.insert(cpu);
+		}
+	}
+
+	// Other architectures report a relative capacity per processor instead.
+	std::map<size_t, size_t> capacities;
+	size_t                   max_capacity = 0;
+
+	std::map<std::pair<size_t, size_t>, size_t> cores;
+	for (auto cpu : parse_cpu_list(online)) {
+		auto path = cpu_path / ("cpu" + std::to_string(cpu));
+
+		cpu_info info;
+		info.id      = cpu;
+		info.package = read_sysfs_number(path / "topology" / "physical_package_id", 0);
+		info.node    = nodes.count(cpu) ? nodes[cpu] : 0;
+		info.type    = core_type::unknown;
+
+		// Core ids are only unique within a package.
+		auto key = std::pair<size_t, size_t>{info.package, read_sysfs_number(path / "topology" / "core_id", cpu)};
+		if (auto itr = cores.find(key); itr != cores.end()) {
+			info.core = itr->second;
+		} else {
+			info.core = cores.size();
+			cores.emplace(key, info.core);
+		}
+
+		if (performance.count(cpu)) {
+			info.type = core_type::performance;
+		} else if (efficiency.count(cpu)) {
+			info.type = core_type::efficiency;
+		} else if (size_t capacity = read_sysfs_number(path / "cpu_capacity", 0); capacity > 0) {
+			capacities[cpu] = capacity;
+			max_capacity    = std::max(max_capacity, capacity);
+		}
+
+		result.push_back(info);
+	}
+
+	// Only a system with differing capacities is hybrid.
+	if (!capacities.empty() && std::any_of(capacities.begin(), capacities.end(), [max_capacity](auto& kv) { return kv.second != max_capacity; })) {
+		for (auto& info : result) {
+			if (auto itr = capacities.find(info.id); itr != capacities.end()) {
+				info.type = (itr->second == max_capacity) ? core_type::performance : core_type::efficiency;
+			}
+		}
+	}
+
+	return result;
+}
+
+bool streamfx::util::platform::set_thread_affinity(std::vector<size_t> const& cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (auto cpu : cpus) {
+		if (cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &set);
+		}
+	}
+	if (CPU_COUNT(&set) == 0) {
+		return false;
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+size_t streamfx::util::platform::current_cpu()
+{
+	int cpu = sched_getcpu();
+	return (cpu < 0) ? 0 : static_cast<size_t>(cpu);
+}
+#elif defined(D_PLATFORM_WINDOWS)
+std::vector<streamfx::util::platform::cpu_info> streamfx::util::platform::cpu_topology()
+{
+	std::vector<cpu_info> result;
+
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+	std::vector<uint8_t> buffer(length);
+	if ((length == 0) || !GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length)) {
+		for (size_t idx = 0, edx = std::max<size_t>(std::thread::hardware_concurrency(), 1); idx < edx; idx++) {
+			result.push_back({idx, idx, 0, 0, core_type::unknown});
+		}
+		return result;
+	}
+
+	auto for_each_cpu = [](GROUP_AFFINITY const& affinity, auto callback) {
+		for (size_t bit = 0; bit < (sizeof(KAFFINITY) * 8); bit++) {
+			if (affinity.Mask & (KAFFINITY(1) << bit)) {
+				callback(static_cast<size_t>(affinity.Group) * 64 + bit);
+			}
+		}
+	};
+
+	std::map<size_t, cpu_info> cpus;
+	std::map<size_t, BYTE>     classes;
+	BYTE                       max_class = 0;
+	size_t                     cores     = 0;
+	size_t                     packages  = 0;
+
+	for (size_t offset = 0; offset < length;) {
+		auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data() + offset);
+		switch (info->Relationship) {
+		case RelationProcessorCore:
+			for (WORD idx = 0; idx < info->Processor.GroupCount; idx++) {
+				for_each_cpu(info->Processor.GroupMask[idx], [&](size_t cpu) {
+					cpus[cpu].id   = cpu;
+					cpus[cpu].core = cores;
+					classes[cpu]   = info->Processor.EfficiencyClass;
+				});
+			}
+			max_class = std::max(max_class, info->Processor.EfficiencyClass);
+			cores++;
+			break;
+		case RelationProcessorPackage:
+			for (WORD idx = 0; idx < info->Processor.GroupCount; idx++) {
+				for_each_cpu(info->Processor.GroupMask[idx], [&](size_t cpu) { cpus[cpu].package = packages; });
+			}
+			packages++;
+			break;
+		case RelationNumaNode:
+			for_each_cpu(info->NumaNode.GroupMask, [&](size_t cpu) { cpus[cpu].node = info->NumaNode.NodeNumber; });
+			break;
+		default:
+			break;
+		}
+		offset += info->Size;
+	}
+
+	for (auto& kv : cpus) {
+		cpu_info info = kv.second;
+		if (max_class == 0) {
+			// All cores are the same.
+			info.type = core_type::unknown;
+		} else {
+			// A higher efficiency class means higher performance.
+			info.type = (classes[kv.first] == max_class) ? core_type::performance : core_type::efficiency;
+		}
+		result.push_back(info);
+	}
+
+	return result;
+}
+
+bool streamfx::util::platform::set_thread_affinity(std::vector<size_t> const& cpus)
+{
+	if (cpus.empty()) {
+		return false;
+	}
+
+	GROUP_AFFINITY affinity = {};
+	affinity.Group          = static_cast<WORD>(cpus.front() / 64);
+	for (auto cpu : cpus) {
+		if ((cpu / 64) == affinity.Group) {
+			affinity.Mask |= KAFFINITY(1) << (cpu % 64);
+		}
+	}
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+}
+
+size_t streamfx::util::platform::current_cpu()
+{
+	PROCESSOR_NUMBER number;
+	GetCurrentProcessorNumberEx(&number);
+	return static_cast<size_t>(number.Group) * 64 + number.Number;
+}
+#else
+std::vector<streamfx::util::platform::cpu_info> streamfx::util::platform::cpu_topology()
+{
+	std::vector<cpu_info> result;
+	for (size_t idx = 0, edx = std::max<size_t>(std::thread::hardware_concurrency(), 1); idx < edx; idx++) {
+		result.push_back({idx, idx, 0, 0, core_type::unknown});
+	}
+	return result;
+}
+
+bool streamfx::util::platform::set_thread_affinity(std::vector<size_t> const&)
+{
+	return false;
+}
+
+size_t streamfx::util::platform::current_cpu()
+{
+	return 0;
+}
+#endif
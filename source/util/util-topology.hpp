@@ -0,0 +1,52 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "warning-disable.hpp"
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace streamfx::util::platform {
+	enum class core_type {
+		/// Not a hybrid system, or the type could not be determined.
+		unknown,
+		performance,
+		efficiency,
+	};
+
+	struct cpu_info {
+		/// Logical processor number, as used for affinity. On Windows this is group * 64 + index.
+		size_t id;
+
+		/// Physical core, unique across packages. Logical processors that share a core are SMT siblings.
+		size_t core;
+
+		size_t    package;
+		size_t    node;
+		core_type type;
+	};
+
+	/** Read the topology of all online logical processors.
+	 *
+	 * On Linux this comes from /sys/devices/system/cpu and /sys/devices/system/node, on Windows from
+	 * GetLogicalProcessorInformationEx. Anything that can't be determined is reported as a single package and node.
+	 */
+	std::vector<cpu_info> cpu_topology();
+
+	/** Parse a list of processors in the format used by the Linux kernel, such as "0-3,8,10-11".
+	 */
+	std::vector<size_t> parse_cpu_list(std::string_view text);
+
+	/** Restrict the calling thread to the given logical processors.
+	 *
+	 * On Windows all processors must be in the same processor group, processors in other groups are ignored.
+	 */
+	bool set_thread_affinity(std::vector<size_t> const& cpus);
+
+	/** Logical processor the calling thread is currently running on.
+	 */
+	size_t current_cpu();
+} // namespace streamfx::util::platform
@@ -0,0 +1,399 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#include "util-trace.hpp"
+#include "common.hpp"
+#include "plugin.hpp"
+#include "util/util-logging.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "warning-enable.hpp"
+
+#ifdef _DEBUG
+#define ST_PREFIX "<%s> "
+#define D_LOG_ERROR(x, ...) P_LOG_ERROR(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_WARNING(x, ...) P_LOG_WARN(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_INFO(x, ...) P_LOG_INFO(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_DEBUG(x, ...) P_LOG_DEBUG(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#else
+#define ST_PREFIX "<util::trace> "
+#define D_LOG_ERROR(...) P_LOG_ERROR(ST_PREFIX __VA_ARGS__)
+#define D_LOG_WARNING(...) P_LOG_WARN(ST_PREFIX __VA_ARGS__)
+#define D_LOG_INFO(...) P_LOG_INFO(ST_PREFIX __VA_ARGS__)
+#define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
+#endif
+
+std::atomic<bool> streamfx::util::trace::detail::recording{false};
+
+namespace {
+	/// Events kept per thread, about 600KiB worth.
+	constexpr size_t ring_size = 8192;
+
+	constexpr size_t name_words = 5;
+
+	/// Buffers of exited threads that are kept around, as the thread pool regularly replaces its workers.
+	constexpr size_t finished_limit = 32;
+
+	enum class phase : uint8_t {
+		begin,
+		end,
+		complete,
+	};
+
+	/** A single event.
+	 *
+	 * Every field is atomic so that a trace can be written while the owning thread keeps recording. The sequence is odd
+	 * while the event is being written, and tells the reader which lap of the ring the event belongs to.
+	 */
+	struct event {
+		std::atomic<uint64_t>                         sequence{0};
+		std::atomic<const char*>                      category{nullptr};
+		std::atomic<int64_t>                          start{0};
+		std::atomic<int64_t>                          duration{0};
+		std::atomic<uint8_t>                          kind{0};
+		std::array<std::atomic<uint64_t>, name_words> name{};
+	};
+
+	struct buffer {
+		std::unique_ptr<event[]> events;
+		std::atomic<uint64_t>    head;
+		uint64_t                 id;
+
+		// Protected by the registry lock.
+		std::string name;
+		bool        finished;
+
+		buffer(uint64_t id) : events(new event[ring_size]), head(0), id(id), name(), finished(false) {}
+	};
+
+	struct registry {
+		std::mutex                           lock;
+		std::vector<std::shared_ptr<buffer>> buffers;
+		uint64_t                             next_id = 1;
+	};
+
+	registry& get_registry()
+	{
+		static registry instance;
+		return instance;
+	}
+
+	/// Buffer of the calling thread, registered on first use and kept for a while after the thread exits.
+	struct thread_state {
+		std::shared_ptr<buffer> ring;
+		std::string             name;
+
+		~thread_state()
+		{
+			if (ring) {
+				auto&                       reg = get_registry();
+				std::lock_guard<std::mutex> lg(reg.lock);
+				ring->finished = true;
+
+				// Forget the oldest exited threads once there are too many.
+				size_t finished = static_cast<size_t>(std::count_if(reg.buffers.begin(), reg.buffers.end(), [](auto const& buf) { return buf->finished; }));
+				for (auto itr = reg.buffers.begin(); (finished > finished_limit) && (itr != reg.buffers.end());) {
+					if ((*itr)->finished) {
+						itr = reg.buffers.erase(itr);
+						finished--;
+					} else {
+						itr++;
+					}
+				}
+			}
+		}
+
+		buffer& get()
+		{
+			if (!ring) {
+				auto&                       reg = get_registry();
+				std::lock_guard<std::mutex> lg(reg.lock);
+				ring       = std::make_shared<buffer>(reg.next_id++);
+				ring->name = name;
+				reg.buffers.push_back(ring);
+			}
+			return *ring;
+		}
+	};
+
+	thread_local thread_state local;
+
+	void record(phase kind, const char* category, std::string_view name, int64_t start, int64_t duration)
+	{
+		auto&    buf = local.get();
+		uint64_t idx = buf.head.load(std::memory_order_relaxed);
+		auto&    ev  = buf.events[idx % ring_size];
+
+		// Mark as being written, based on the lap so that the reader can tell stale events apart.
+		uint64_t lap = idx / ring_size;
+		ev.sequence.store(lap * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		ev.kind.store(static_cast<uint8_t>(kind), std::memory_order_relaxed);
+		ev.category.store(category, std::memory_order_relaxed);
+		ev.start.store(start, std::memory_order_relaxed);
+		ev.duration.store(duration, std::memory_order_relaxed);
+
+		std::array<uint64_t, name_words> words{};
+		std::memcpy(words.data(), name.data(), std::min(name.size(), sizeof(words) - 1));
+		for (size_t word = 0; word < name_words; word++) {
+			ev.name[word].store(words[word], std::memory_order_relaxed);
+		}
+
+		ev.sequence.store(lap * 2 + 2, std::memory_order_release);
+		buf.head.store(idx + 1, std::memory_order_release);
+	}
+
+	struct event_copy {
+		phase       kind;
+		const char* category;
+		int64_t     start;
+		int64_t     duration;
+		char        name[name_words * sizeof(uint64_t)];
+	};
+
+	/// Copy all events that are still complete in a buffer, oldest first.
+	std::vector<event_copy> copy_events(buffer const& buf)
+	{
+		std::vector<event_copy> result;
+
+		uint64_t head  = buf.head.load(std::memory_order_acquire);
+		uint64_t first = (head > ring_size) ? (head - ring_size) : 0;
+		result.reserve(static_cast<size_t>(head - first));
+		for (uint64_t idx = first; idx < head; idx++) {
+			auto&    ev       = buf.events[idx % ring_size];
+			uint64_t expected = (idx / ring_size) * 2 + 2;
+			if (ev.sequence.load(std::memory_order_acquire) != expected) {
+				continue;
+			}
+
+			event_copy copy;
+			copy.kind     = static_cast<phase>(ev.kind.load(std::memory_order_relaxed));
+			copy.category = ev.category.load(std::memory_order_relaxed);
+			copy.start    = ev.start.load(std::memory_order_relaxed);
+			copy.duration = ev.duration.load(std::memory_order_relaxed);
+			std::array<uint64_t, name_words> words;
+			for (size_t word = 0; word < name_words; word++) {
+				words[word] = ev.name[word].load(std::memory_order_relaxed);
+			}
+			std::memcpy(copy.name, words.data(), sizeof(copy.name));
+			copy.name[sizeof(copy.name) - 1] = '\0';
+
+			// Discard the event if the thread started overwriting it while it was copied.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (ev.sequence.load(std::memory_order_relaxed) != expected) {
+				continue;
+			}
+			result.push_back(copy);
+		}
+
+		return result;
+	}
+
+	void write_string(std::ostream& stream, std::string_view text)
+	{
+		stream << '"';
+		for (char chr : text) {
+			switch (chr) {
+			case '"':
+				stream << "\\\"";
+				break;
+			case '\\':
+				stream << "\\\\";
+				break;
+			default:
+				if (static_cast<unsigned char>(chr) < 0x20) {
+					char code[8];
+					snprintf(code, sizeof(code), "\\u%04X", static_cast<unsigned>(chr));
+					stream << code;
+				} else {
+					stream << chr;
+				}
+			}
+		}
+		stream << '"';
+	}
+
+	void write_time(std::ostream& stream, int64_t ns)
+	{
+		// Trace Event timestamps are in microseconds, but may have a fractional part.
+		char text[32];
+		snprintf(text, sizeof(text), "%lld.%03lld", static_cast<long long>(ns / 1000), static_cast<long long>(std::abs(ns % 1000)));
+		stream << text;
+	}
+} // namespace
+
+int64_t streamfx::util::trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void streamfx::util::trace::start()
+{
+	detail::recording.store(true);
+}
+
+void streamfx::util::trace::stop()
+{
+	detail::recording.store(false);
+}
+
+void streamfx::util::trace::clear()
+{
+	auto&                       reg = get_registry();
+	std::lock_guard<std::mutex> lg(reg.lock);
+
+	// Threads that are still alive keep writing into their buffer, so they are only dropped once finished.
+	reg.buffers.erase(std::remove_if(reg.buffers.begin(), reg.buffers.end(), [](auto const& buf) { return buf->finished; }), reg.buffers.end());
+	for (auto& buf : reg.buffers) {
+		for (size_t idx = 0; idx < ring_size; idx++) {
+			buf->events[idx].sequence.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+void streamfx::util::trace::name_thread(std::string_view name)
+{
+	local.name = name;
+	if (local.ring) {
+		auto&                       reg = get_registry();
+		std::lock_guard<std::mutex> lg(reg.lock);
+		local.ring->name = name;
+	}
+}
+
+void streamfx::util::trace::begin(const char* category, std::string_view name)
+{
+	if (is_recording()) {
+		record(phase::begin, category, name, now(), 0);
+	}
+}
+
+void streamfx::util::trace::end(const char* category)
+{
+	if (is_recording()) {
+		record(phase::end, category, {}, now(), 0);
+	}
+}
+
+void streamfx::util::trace::complete(const char* category, std::string_view name, int64_t start, int64_t end)
+{
+	if (is_recording()) {
+		record(phase::complete, category, name, start, end - start);
+	}
+}
+
+void streamfx::util::trace::write_chrome(std::filesystem::path const& path)
+{
+	struct thread_events {
+		uint64_t                id;
+		std::string             name;
+		std::vector<event_copy> events;
+	};
+	std::vector<thread_events> threads;
+
+	{
+		auto&                       reg = get_registry();
+		std::lock_guard<std::mutex> lg(reg.lock);
+		for (auto& buf : reg.buffers) {
+			threads.push_back({buf->id, buf->name, copy_events(*buf)});
+		}
+	}
+
+	std::ofstream stream(path, std::ios::out | std::ios::trunc);
+	if (!stream) {
+		throw std::runtime_error("Failed to open trace file for writing.");
+	}
+
+	stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	stream << "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"StreamFX\"}}";
+	for (auto const& thread : threads) {
+		if (!thread.name.empty()) {
+			stream << ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.id << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+			write_string(stream, thread.name);
+			stream << "}}";
+		}
+
+		for (auto const& ev : thread.events) {
+			stream << ",\n{\"ph\":\"";
+			switch (ev.kind) {
+			case phase::begin:
+				stream << "B";
+				break;
+			case phase::end:
+				stream << "E";
+				break;
+			case phase::complete:
+				stream << "X";
+				break;
+			}
+			stream << "\",\"pid\":1,\"tid\":" << thread.id << ",\"cat\":";
+			write_string(stream, ev.category ? ev.category : "");
+			if (ev.kind != phase::end) {
+				stream << ",\"name\":";
+				write_string(stream, ev.name);
+			}
+			stream << ",\"ts\":";
+			write_time(stream, ev.start);
+			if (ev.kind == phase::complete) {
+				stream << ",\"dur\":";
+				write_time(stream, ev.duration);
+			}
+			stream << "}";
+		}
+	}
+	stream << "\n]}\n";
+
+	if (!stream) {
+		throw std::runtime_error("Failed to write trace file.");
+	}
+}
+
+static std::string loader_path;
+
+static auto loader = streamfx::component(
+	"core::trace",
+	[]() { // Initializer
+		// Meant for investigating problems, so it is only enabled through the environment.
+#if defined(D_PLATFORM_WINDOWS)
+		char*  env_value     = nullptr;
+		size_t env_value_len = 0;
+		if ((_dupenv_s(&env_value, &env_value_len, "STREAMFX_TRACE") == 0) && env_value) {
+			loader_path = env_value;
+			free(env_value);
+		}
+#else
+		if (const char* env_value = getenv("STREAMFX_TRACE"); env_value) {
+			loader_path = env_value;
+		}
+#endif
+
+		if (!loader_path.empty()) {
+			D_LOG_INFO("Recording trace to '%s'.", loader_path.c_str());
+			streamfx::util::trace::start();
+		}
+	},
+	[]() { // Finalizer
+		if (!loader_path.empty()) {
+			streamfx::util::trace::stop();
+			try {
+				streamfx::util::trace::write_chrome(std::filesystem::path(loader_path));
+			} catch (const std::exception& ex) {
+				D_LOG_ERROR("Failed to write trace to '%s': %s", loader_path.c_str(), ex.what());
+			}
+		}
+	},
+	{});
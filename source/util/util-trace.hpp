@@ -0,0 +1,80 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+#pragma once
+#include "warning-disable.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include "warning-enable.hpp"
+
+/** Recording of what each thread did when, for viewing in chrome://tracing or ui.perfetto.dev.
+ *
+ * Each thread records into its own ring buffer which holds the most recent events, so recording can stay enabled for a
+ * long time and a trace can be written right after something went wrong. Recording an event is a few relaxed atomic
+ * stores into memory only that thread writes to, and when recording is disabled it is a single relaxed load.
+ *
+ * Categories must be string literals, names are copied and truncated to 39 characters.
+ */
+namespace streamfx::util::trace {
+	namespace detail {
+		extern std::atomic<bool> recording;
+	} // namespace detail
+
+	inline bool is_recording()
+	{
+		return detail::recording.load(std::memory_order_relaxed);
+	}
+
+	/// Current time in nanoseconds on the clock used by all events.
+	int64_t now();
+
+	void start();
+
+	void stop();
+
+	/// Discard all recorded events.
+	void clear();
+
+	/// Name the calling thread in written traces.
+	void name_thread(std::string_view name);
+
+	/// Mark the start of a nested region on the calling thread. Must be followed by end() on the same thread.
+	void begin(const char* category, std::string_view name);
+
+	void end(const char* category);
+
+	/// Record a region that already finished, with times from now().
+	void complete(const char* category, std::string_view name, int64_t start, int64_t end);
+
+	/** Write all recorded events in the Chrome Trace Event format.
+	 *
+	 * Recording does not need to be stopped for this, events recorded while writing may or may not be included.
+	 */
+	void write_chrome(std::filesystem::path const& path);
+
+	/** Record the lifetime of this object as a region.
+	 *
+	 * The name is not copied until the region ends, so it must outlive the scope.
+	 */
+	class scope {
+		const char*      _category;
+		std::string_view _name;
+		int64_t          _start;
+
+		public:
+		inline scope(const char* category, std::string_view name) : _category(category), _name(name), _start(is_recording() ? now() : 0) {}
+
+		inline ~scope()
+		{
+			if (_start != 0) {
+				complete(_category, _name, _start, now());
+			}
+		}
+
+		scope(scope const&)            = delete;
+		scope& operator=(scope const&) = delete;
+	};
+} // namespace streamfx::util::trace
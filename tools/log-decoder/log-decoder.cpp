@@ -0,0 +1,74 @@
+// AUTOGENERATED COPYRIGHT HEADER START
+// Copyright (C) 2023 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+// AUTOGENERATED COPYRIGHT HEADER END
+
+// Turns a binary log written with STREAMFX_LOG_BINARY back into text.
+
+#include "util/util-logging-binary.hpp"
+
+#include "warning-disable.hpp"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include "warning-enable.hpp"
+
+static const char* level_name(uint8_t level)
+{
+	switch (level) {
+	case 0:
+		return "debug";
+	case 1:
+		return "info";
+	case 2:
+		return "warning";
+	case 3:
+		return "error";
+	default:
+		return "unknown";
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <binary log> [text log]\n", argv[0]);
+		return 1;
+	}
+
+	FILE* output = stdout;
+	if (argc >= 3) {
+		output = fopen(argv[2], "wb");
+		if (!output) {
+			fprintf(stderr, "Failed to open '%s' for writing.\n", argv[2]);
+			return 1;
+		}
+	}
+
+	try {
+		streamfx::util::logging::binary::reader          log{std::filesystem::path(argv[1])};
+		streamfx::util::logging::binary::reader::message msg;
+		while (log.next(msg)) {
+			auto    time    = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(msg.time)));
+			auto    seconds = std::chrono::system_clock::to_time_t(time);
+			int64_t millis  = (msg.time / 1000000) % 1000;
+
+			char stamp[32] = "";
+			if (auto local = std::localtime(&seconds); local) {
+				std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", local);
+			}
+			fprintf(output, "%s.%03lld [%s] [StreamFX] %s\n", stamp, static_cast<long long>(millis), level_name(msg.level), msg.text.c_str());
+		}
+	} catch (std::exception const& ex) {
+		fprintf(stderr, "Failed to decode '%s': %s\n", argv[1], ex.what());
+		if (output != stdout) {
+			fclose(output);
+		}
+		return 1;
+	}
+
+	if (output != stdout) {
+		fclose(output);
+	}
+	return 0;
+}